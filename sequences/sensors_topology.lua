@@ -0,0 +1,5 @@
+-- The devices for "sensors.i2c". See "setTopology" for the fields.
+return {
+  { name='temp_left',  address=0x48, mux=0x70, channel=0 },
+  { name='temp_right', address=0x48, mux=0x70, channel=1 }
+}
@@ -0,0 +1,34 @@
+#include "arena.h"
+
+
+void arena_init(ARENA_T *ptArena, void *pvStart, void *pvEnd)
+{
+	ptArena->pucStart = (unsigned char*)pvStart;
+	ptArena->pucEnd = (unsigned char*)pvEnd;
+}
+
+
+
+/* Check if "sizData" bytes at "pvData" are completely inside the arena.
+ * Returns 1 if this is the case and 0 otherwise.
+ */
+int arena_contains(const ARENA_T *ptArena, const void *pvData, size_t sizData)
+{
+	const unsigned char *pucData;
+	int iResult;
+
+
+	iResult = 0;
+
+	/* Compare the size with the space to the end to avoid an overflow. */
+	pucData = (const unsigned char*)pvData;
+	if( pucData>=ptArena->pucStart && pucData<=ptArena->pucEnd )
+	{
+		if( sizData<=(size_t)(ptArena->pucEnd - pucData) )
+		{
+			iResult = 1;
+		}
+	}
+
+	return iResult;
+}
@@ -0,0 +1,21 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+
+/* An arena is a memory region. All buffers from the host are checked
+ * against the arenas before they are used.
+ */
+typedef struct ARENA_STRUCT
+{
+	unsigned char *pucStart;
+	unsigned char *pucEnd;
+} ARENA_T;
+
+
+void arena_init(ARENA_T *ptArena, void *pvStart, void *pvEnd);
+int arena_contains(const ARENA_T *ptArena, const void *pvData, size_t sizData);
+
+
+#endif  /* __ARENA_H__ */
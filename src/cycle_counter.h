@@ -0,0 +1,78 @@
+
+#ifndef __CYCLE_COUNTER_H__
+#define __CYCLE_COUNTER_H__
+
+
+/* The cycle counter of the ARMv7-R performance monitor unit counts the CPU
+ * clocks. The Cortex-R7 in the netX4000 runs at 600MHz.
+ */
+#define CYCLE_COUNTER_CLOCKS_PER_US 600U
+
+
+#ifndef CFG_HOST_SIM
+#       define CFG_HOST_SIM 0
+#endif
+
+#if CFG_HOST_SIM!=0
+/* The host build scales the monotonic clock to the clocks of the netX. */
+#include <time.h>
+
+static inline void cycle_counter_init(void)
+{
+}
+
+
+static inline unsigned long cycle_counter_get(void)
+{
+	struct timespec tNow;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (unsigned long)tNow.tv_sec * 1000000U * CYCLE_COUNTER_CLOCKS_PER_US + ((unsigned long)tNow.tv_nsec * CYCLE_COUNTER_CLOCKS_PER_US) / 1000U;
+}
+#else
+static inline void cycle_counter_init(void)
+{
+	unsigned long ulValue;
+
+
+	/* Enable the counters in PMCR. */
+	__asm__ __volatile__ ("mrc p15, 0, %0, c9, c12, 0" : "=r" (ulValue));
+	ulValue |= 1U;
+	__asm__ __volatile__ ("mcr p15, 0, %0, c9, c12, 0" : : "r" (ulValue));
+
+	/* Enable the cycle counter in PMCNTENSET. */
+	ulValue = 1U << 31U;
+	__asm__ __volatile__ ("mcr p15, 0, %0, c9, c12, 1" : : "r" (ulValue));
+}
+
+
+static inline unsigned long cycle_counter_get(void)
+{
+	unsigned long ulValue;
+
+
+	__asm__ __volatile__ ("mrc p15, 0, %0, c9, c13, 0" : "=r" (ulValue));
+	return ulValue;
+}
+#endif
+
+
+/* Busy wait for the number of microseconds. The counter wraps after about
+ * 7 seconds, so this is only for short delays.
+ */
+static inline void cycle_counter_delay_us(unsigned long ulDelayUs)
+{
+	unsigned long ulStart;
+	unsigned long ulDuration;
+
+
+	ulStart = cycle_counter_get();
+	ulDuration = ulDelayUs * CYCLE_COUNTER_CLOCKS_PER_US;
+	while( (cycle_counter_get()-ulStart)<ulDuration )
+	{
+	}
+}
+
+
+#endif  /* __CYCLE_COUNTER_H__ */
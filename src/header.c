@@ -27,12 +27,14 @@ extern unsigned long load_address[];
 unsigned long start(unsigned long ulParameter);
 extern unsigned long parameter_start_address[];
 extern unsigned long parameter_end_address[];
+extern unsigned long buffer_start_address[];
+extern unsigned long buffer_end_address[];
 
 
 const VERSION_HEADER_T tVersionHeader =
 {
 	.acMagic = { 'm', 'o', 'o', 'h' },
-	.ulVersion = 0x00010001,
+	.ulVersion = 0x00010002,
 
 	.pulLoadAddress = load_address,
 	.pfnExecutionAddress = start,
@@ -42,6 +44,9 @@ const VERSION_HEADER_T tVersionHeader =
 	.ulVersionMajor = VERSION_MAJOR,
 	.ulVersionMinor = VERSION_MINOR,
 	.ulVersionMicro = VERSION_MICRO,
-	.acVersionVcs = VERSION_VCS
+	.acVersionVcs = VERSION_VCS,
+
+	.pulBufferStart = buffer_start_address,
+	.pulBufferEnd = buffer_end_address
 };
 
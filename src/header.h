@@ -39,6 +39,10 @@ typedef struct VERSION_HEADER_STRUCT
 	unsigned long ulVersionMinor;
 	unsigned long ulVersionMicro;
 	const char    acVersionVcs[16];
+
+	/* Since version 1.2: the free RAM between .bss and the stack. */
+	unsigned long *pulBufferStart;
+	unsigned long *pulBufferEnd;
 } VERSION_HEADER_T;
 
 extern const VERSION_HEADER_T tVersionHeader __attribute__ ((section (".header")));
@@ -0,0 +1,407 @@
+#include "i2c_sim.h"
+
+#include <string.h>
+
+#include "i2c_core_hsoc_v2.h"
+
+
+static I2C_SIM_UNIT_T atSimUnits[I2C_SIM_UNITS];
+
+
+/*-----------------------------------*/
+
+
+static void fifo_clear(I2C_SIM_FIFO_T *ptFifo)
+{
+	ptFifo->uiReadIndex = 0;
+	ptFifo->uiLevel = 0;
+}
+
+
+
+static void fifo_put(I2C_SIM_FIFO_T *ptFifo, unsigned char ucData)
+{
+	/* Like the hardware, a full FIFO drops the data. */
+	if( ptFifo->uiLevel<I2C_SIM_FIFO_DEPTH )
+	{
+		ptFifo->aucData[(ptFifo->uiReadIndex + ptFifo->uiLevel) % I2C_SIM_FIFO_DEPTH] = ucData;
+		++ptFifo->uiLevel;
+	}
+}
+
+
+
+static unsigned char fifo_get(I2C_SIM_FIFO_T *ptFifo)
+{
+	unsigned char ucData;
+
+
+	ucData = 0;
+	if( ptFifo->uiLevel!=0 )
+	{
+		ucData = ptFifo->aucData[ptFifo->uiReadIndex];
+		ptFifo->uiReadIndex = (ptFifo->uiReadIndex + 1U) % I2C_SIM_FIFO_DEPTH;
+		--ptFifo->uiLevel;
+	}
+
+	return ucData;
+}
+
+
+/*-----------------------------------*/
+
+
+static void unit_reset(I2C_SIM_UNIT_T *ptUnit)
+{
+	fifo_clear(&(ptUnit->tMasterFifo));
+	fifo_clear(&(ptUnit->tSlaveFifo));
+	ptUnit->ulCommand = I2CCMD_IDLE;
+	ptUnit->ulNwr = 0;
+	ptUnit->ulRemaining = 0;
+	ptUnit->iTarget = -1;
+	ptUnit->iLastAck = 0;
+	ptUnit->iSlaveRequest = 0;
+	ptUnit->ulSlaveNwr = 0;
+}
+
+
+
+/* Find the unit which acknowledges the address of the master. */
+static int find_slave(I2C_SIM_UNIT_T *ptMaster)
+{
+	unsigned long ulAddress;
+	unsigned long ulSlaveAddress;
+	unsigned long ulScr;
+	unsigned int uiCnt;
+	int iTarget;
+
+
+	ulAddress   = ptMaster->tRegisters.ulI2c_mcr;
+	ulAddress  &= HOSTMSK(i2c_mcr_sadr);
+	ulAddress >>= HOSTSRT(i2c_mcr_sadr);
+
+	iTarget = -1;
+	for(uiCnt=0; uiCnt<I2C_SIM_UNITS; ++uiCnt)
+	{
+		ulScr = atSimUnits[uiCnt].tRegisters.ulI2c_scr;
+		ulSlaveAddress   = ulScr & HOSTMSK(i2c_scr_sid);
+		ulSlaveAddress >>= HOSTSRT(i2c_scr_sid);
+		if( atSimUnits+uiCnt!=ptMaster && (ulScr&HOSTMSK(i2c_scr_ac_start))!=0 && ulSlaveAddress==ulAddress )
+		{
+			iTarget = (int)uiCnt;
+			break;
+		}
+	}
+
+	return iTarget;
+}
+
+
+
+/* Move the running command of a master one step forward. */
+static void master_step(I2C_SIM_UNIT_T *ptMaster)
+{
+	I2C_SIM_UNIT_T *ptSlave;
+	int iTarget;
+
+
+	ptSlave = NULL;
+	if( ptMaster->iTarget>=0 )
+	{
+		ptSlave = atSimUnits + ptMaster->iTarget;
+	}
+
+	switch( ptMaster->ulCommand )
+	{
+	case I2CCMD_S_AC:
+		iTarget = find_slave(ptMaster);
+		if( iTarget<0 )
+		{
+			/* Nobody acknowledged the address. */
+			ptMaster->iTarget = -1;
+			ptMaster->iLastAck = 0;
+			ptMaster->ulCommand = I2CCMD_IDLE;
+		}
+		else if( atSimUnits[iTarget].iSlaveRequest==0 )
+		{
+			/* Stretch the clock until the slave handled its last request. */
+			ptSlave = atSimUnits + iTarget;
+			ptSlave->iSlaveRequest = 1;
+			ptSlave->ulSlaveNwr = ptMaster->ulNwr;
+			ptMaster->iTarget = iTarget;
+			ptMaster->iLastAck = 1;
+			ptMaster->ulCommand = I2CCMD_IDLE;
+		}
+		break;
+
+	case I2CCMD_CT:
+	case I2CCMD_CTC:
+		if( ptSlave==NULL )
+		{
+			ptMaster->iLastAck = 0;
+			ptMaster->ulCommand = I2CCMD_IDLE;
+		}
+		else if( ptSlave->iSlaveRequest==0 )
+		{
+			if( ptMaster->ulNwr==0 )
+			{
+				/* Write one byte to the slave. */
+				if( ptMaster->tMasterFifo.uiLevel!=0 && ptSlave->tSlaveFifo.uiLevel<I2C_SIM_FIFO_DEPTH )
+				{
+					fifo_put(&(ptSlave->tSlaveFifo), fifo_get(&(ptMaster->tMasterFifo)));
+					--ptMaster->ulRemaining;
+				}
+			}
+			else
+			{
+				/* Read one byte from the slave. */
+				if( ptSlave->tSlaveFifo.uiLevel!=0 && ptMaster->tMasterFifo.uiLevel<I2C_SIM_FIFO_DEPTH )
+				{
+					fifo_put(&(ptMaster->tMasterFifo), fifo_get(&(ptSlave->tSlaveFifo)));
+					--ptMaster->ulRemaining;
+				}
+			}
+
+			if( ptMaster->ulRemaining==0 )
+			{
+				ptMaster->iLastAck = 1;
+				ptMaster->ulCommand = I2CCMD_IDLE;
+			}
+		}
+		break;
+
+	case I2CCMD_STOP:
+		ptMaster->iTarget = -1;
+		ptMaster->ulCommand = I2CCMD_IDLE;
+		break;
+
+	default:
+		/* The other commands are not used by the driver. */
+		ptMaster->ulCommand = I2CCMD_IDLE;
+		break;
+	}
+}
+
+
+
+static void bus_step(void)
+{
+	unsigned int uiCnt;
+
+
+	for(uiCnt=0; uiCnt<I2C_SIM_UNITS; ++uiCnt)
+	{
+		if( atSimUnits[uiCnt].ulCommand!=I2CCMD_IDLE )
+		{
+			master_step(atSimUnits + uiCnt);
+		}
+	}
+}
+
+
+
+static void start_command(I2C_SIM_UNIT_T *ptUnit, unsigned long ulValue)
+{
+	unsigned long ulTsize;
+
+
+	ulTsize   = ulValue & HOSTMSK(i2c_cmd_tsize);
+	ulTsize >>= HOSTSRT(i2c_cmd_tsize);
+
+	ptUnit->ulCommand   = ulValue & HOSTMSK(i2c_cmd_cmd);
+	ptUnit->ulCommand >>= HOSTSRT(i2c_cmd_cmd);
+	ptUnit->ulNwr = (ulValue >> HOSTSRT(i2c_cmd_nwr)) & 1U;
+	ptUnit->ulRemaining = ulTsize + 1U;
+}
+
+
+
+/* Find the unit of a register. */
+static I2C_SIM_UNIT_T *find_unit(volatile uint32_t *pulRegister)
+{
+	I2C_SIM_UNIT_T *ptUnit;
+	const volatile unsigned char *pucRegister;
+	const volatile unsigned char *pucStart;
+	unsigned int uiCnt;
+
+
+	ptUnit = NULL;
+	pucRegister = (const volatile unsigned char*)pulRegister;
+	for(uiCnt=0; uiCnt<I2C_SIM_UNITS; ++uiCnt)
+	{
+		pucStart = (const volatile unsigned char*)&(atSimUnits[uiCnt].tRegisters);
+		if( pucRegister>=pucStart && pucRegister<pucStart+sizeof(HOSTADEF(I2C)) )
+		{
+			ptUnit = atSimUnits + uiCnt;
+			break;
+		}
+	}
+
+	return ptUnit;
+}
+
+
+/*-----------------------------------*/
+
+
+void i2c_sim_init(void)
+{
+	unsigned int uiCnt;
+
+
+	memset(atSimUnits, 0, sizeof(atSimUnits));
+	for(uiCnt=0; uiCnt<I2C_SIM_UNITS; ++uiCnt)
+	{
+		unit_reset(atSimUnits + uiCnt);
+	}
+}
+
+
+
+HOSTADEF(I2C) *i2c_sim_get_unit(unsigned int uiUnit)
+{
+	HOSTADEF(I2C) *ptRegisters;
+
+
+	ptRegisters = NULL;
+	if( uiUnit<I2C_SIM_UNITS )
+	{
+		ptRegisters = &(atSimUnits[uiUnit].tRegisters);
+	}
+
+	return ptRegisters;
+}
+
+
+
+uint32_t i2c_sim_read(volatile uint32_t *pulRegister)
+{
+	I2C_SIM_UNIT_T *ptUnit;
+	HOSTADEF(I2C) *ptRegs;
+	uint32_t ulValue;
+
+
+	ulValue = 0;
+	ptUnit = find_unit(pulRegister);
+	if( ptUnit!=NULL )
+	{
+		ptRegs = &(ptUnit->tRegisters);
+		if( pulRegister==&(ptRegs->ulI2c_cmd) )
+		{
+			bus_step();
+			ulValue  = ptRegs->ulI2c_cmd & ~HOSTMSK(i2c_cmd_cmd);
+			ulValue |= (uint32_t)(ptUnit->ulCommand << HOSTSRT(i2c_cmd_cmd));
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_sr) )
+		{
+			bus_step();
+			ulValue  = (ptUnit->tMasterFifo.uiLevel << HOSTSRT(i2c_sr_mfifo_level)) & HOSTMSK(i2c_sr_mfifo_level);
+			ulValue |= (ptUnit->tSlaveFifo.uiLevel << HOSTSRT(i2c_sr_sfifo_level)) & HOSTMSK(i2c_sr_sfifo_level);
+			if( ptUnit->tMasterFifo.uiLevel>=I2C_SIM_FIFO_DEPTH )
+			{
+				ulValue |= HOSTMSK(i2c_sr_mfifo_full);
+			}
+			if( ptUnit->iLastAck!=0 )
+			{
+				ulValue |= HOSTMSK(i2c_sr_last_ac);
+			}
+			if( ptUnit->ulSlaveNwr!=0 )
+			{
+				ulValue |= HOSTMSK(i2c_sr_nwr);
+			}
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_mdr) )
+		{
+			ulValue = fifo_get(&(ptUnit->tMasterFifo));
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_sdr) )
+		{
+			ulValue = fifo_get(&(ptUnit->tSlaveFifo));
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_irqsr) )
+		{
+			if( ptUnit->iSlaveRequest!=0 )
+			{
+				ulValue |= HOSTMSK(i2c_irqsr_sreq);
+			}
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_pio) )
+		{
+			/* Nobody holds the lines. */
+			ulValue  = *pulRegister;
+			ulValue |= HOSTMSK(i2c_pio_scl_in_ro) | HOSTMSK(i2c_pio_sda_in_ro);
+		}
+		else
+		{
+			ulValue = *pulRegister;
+		}
+	}
+
+	return ulValue;
+}
+
+
+
+void i2c_sim_write(volatile uint32_t *pulRegister, uint32_t ulValue)
+{
+	I2C_SIM_UNIT_T *ptUnit;
+	HOSTADEF(I2C) *ptRegs;
+
+
+	ptUnit = find_unit(pulRegister);
+	if( ptUnit!=NULL )
+	{
+		ptRegs = &(ptUnit->tRegisters);
+		if( pulRegister==&(ptRegs->ulI2c_cmd) )
+		{
+			*pulRegister = ulValue;
+			start_command(ptUnit, ulValue);
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_mcr) )
+		{
+			*pulRegister = ulValue;
+			if( (ulValue&HOSTMSK(i2c_mcr_rst_i2c))!=0 )
+			{
+				unit_reset(ptUnit);
+			}
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_mdr) )
+		{
+			fifo_put(&(ptUnit->tMasterFifo), (unsigned char)ulValue);
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_sdr) )
+		{
+			fifo_put(&(ptUnit->tSlaveFifo), (unsigned char)ulValue);
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_mfifo_cr) )
+		{
+			if( (ulValue&HOSTMSK(i2c_mfifo_cr_mfifo_clr))!=0 )
+			{
+				fifo_clear(&(ptUnit->tMasterFifo));
+			}
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_sfifo_cr) )
+		{
+			if( (ulValue&HOSTMSK(i2c_sfifo_cr_sfifo_clr))!=0 )
+			{
+				fifo_clear(&(ptUnit->tSlaveFifo));
+			}
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_irqsr) )
+		{
+			/* Write 1 to clear. */
+			if( (ulValue&HOSTMSK(i2c_irqsr_sreq))!=0 )
+			{
+				ptUnit->iSlaveRequest = 0;
+			}
+		}
+		else if( pulRegister==&(ptRegs->ulI2c_sr) )
+		{
+			/* The status bits are write 1 to clear. The timeout is not simulated. */
+		}
+		else
+		{
+			*pulRegister = ulValue;
+		}
+	}
+}
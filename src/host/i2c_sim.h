@@ -0,0 +1,53 @@
+#ifndef __I2C_SIM_H__
+#define __I2C_SIM_H__
+
+#include <stdint.h>
+
+#include "netx_io_areas.h"
+
+
+/* This simulates I2C units of the hsoc v2 family on one bus for the host
+ * build. The driver accesses the registers of a unit with i2c_sim_read and
+ * i2c_sim_write, which emulate the FIFOs, the commands and the slave
+ * requests.
+ *
+ * The bus moves one byte each time a unit polls its status or command
+ * register. A master stalls like on a clock stretch if the slave FIFO is
+ * full or empty, or if the slave did not handle its last request yet. So
+ * the slave must be serviced while the master waits, just like on the netX.
+ * Timing is not simulated.
+ */
+#define I2C_SIM_UNITS 2U
+#define I2C_SIM_FIFO_DEPTH 16U
+
+
+typedef struct I2C_SIM_FIFO_STRUCT
+{
+	unsigned char aucData[I2C_SIM_FIFO_DEPTH];
+	unsigned int uiReadIndex;
+	unsigned int uiLevel;
+} I2C_SIM_FIFO_T;
+
+
+typedef struct I2C_SIM_UNIT_STRUCT
+{
+	HOSTADEF(I2C) tRegisters;       /* The driver gets a pointer to this. */
+	I2C_SIM_FIFO_T tMasterFifo;
+	I2C_SIM_FIFO_T tSlaveFifo;
+	unsigned long ulCommand;        /* The running master command or I2CCMD_IDLE. */
+	unsigned long ulNwr;            /* The direction of the running master command. */
+	unsigned long ulRemaining;      /* The data bytes left in the running master command. */
+	int iTarget;                    /* The index of the addressed slave or -1. */
+	int iLastAck;
+	int iSlaveRequest;              /* The slave was addressed and did not acknowledge the request yet. */
+	unsigned long ulSlaveNwr;       /* The direction of the last access to the slave. */
+} I2C_SIM_UNIT_T;
+
+
+void i2c_sim_init(void);
+HOSTADEF(I2C) *i2c_sim_get_unit(unsigned int uiUnit);
+uint32_t i2c_sim_read(volatile uint32_t *pulRegister);
+void i2c_sim_write(volatile uint32_t *pulRegister, uint32_t ulValue);
+
+
+#endif  /* __I2C_SIM_H__ */
@@ -0,0 +1,95 @@
+#include <stdio.h>
+
+#include "i2c_benchmark.h"
+#include "i2c_core_hsoc_v2.h"
+#include "i2c_sim.h"
+
+
+/* Run the loopback benchmark of the netX on the host. The master and the
+ * slave are 2 simulated units on one bus. The transfer sizes are chosen
+ * around the FIFO depth. The result is 0 if all data was read back.
+ */
+#define SLAVE_ADDRESS 0x42U
+#define TRANSFERS 8U
+#define TRANSFER_SIZE_MAX 255U
+
+
+static const unsigned int auiTransferSizes[] =
+{
+	1U,
+	15U,
+	16U,
+	17U,
+	64U,
+	TRANSFER_SIZE_MAX
+};
+
+
+int main(void)
+{
+	int iResult;
+	I2C_HANDLE_T tMaster;
+	I2C_HANDLE_T tSlave;
+	unsigned char aucWorkBuffer[3U*TRANSFER_SIZE_MAX + 1U];
+	I2C_BENCHMARK_RESULT_T atResults[I2CSPEED_3400 + 1];
+	unsigned long ulResults;
+	unsigned long ulCnt;
+	unsigned int sizTransfer;
+	unsigned int uiSize;
+
+
+	iResult = 0;
+	for(uiSize=0; uiSize<sizeof(auiTransferSizes)/sizeof(auiTransferSizes[0]); ++uiSize)
+	{
+		sizTransfer = auiTransferSizes[uiSize];
+
+		i2c_sim_init();
+		i2c_core_hsoc_v2_init_unit(&tMaster, i2c_sim_get_unit(0), 0);
+		i2c_core_hsoc_v2_init_unit(&tSlave, i2c_sim_get_unit(1), 0);
+		tMaster.tI2CFn.fnSetDeviceSpecificSpeed(&tMaster, I2CSPEED_400);
+
+		if( i2c_benchmark_run(&tMaster, &tSlave, SLAVE_ADDRESS, 0xffU, sizTransfer, TRANSFERS, aucWorkBuffer, atResults, &ulResults, 0)!=0 )
+		{
+			printf("%3u bytes: the benchmark failed.\n", sizTransfer);
+			iResult = -1;
+		}
+		else
+		{
+			for(ulCnt=0; ulCnt<ulResults; ++ulCnt)
+			{
+				printf("%3u bytes, speed %u: %u bytes read back, %u errors\n", sizTransfer, (unsigned int)atResults[ulCnt].ulSpeed, (unsigned int)atResults[ulCnt].ulBytes, (unsigned int)atResults[ulCnt].ulErrors);
+				if( atResults[ulCnt].ulErrors!=0 || atResults[ulCnt].ulBytes!=TRANSFERS*sizTransfer )
+				{
+					iResult = -1;
+				}
+			}
+			if( i2c_core_hsoc_v2_get_device_specific_speed(&tMaster)!=I2CSPEED_400 )
+			{
+				printf("%3u bytes: the speed was not restored.\n", sizTransfer);
+				iResult = -1;
+			}
+		}
+	}
+
+	/* Without transfers there is no minimum. */
+	i2c_sim_init();
+	i2c_core_hsoc_v2_init_unit(&tMaster, i2c_sim_get_unit(0), 0);
+	i2c_core_hsoc_v2_init_unit(&tSlave, i2c_sim_get_unit(1), 0);
+	if( i2c_benchmark_run(&tMaster, &tSlave, SLAVE_ADDRESS, 1U<<I2CSPEED_100, 1U, 0U, aucWorkBuffer, atResults, &ulResults, 0)!=0 ||
+	    ulResults!=1U || atResults[0].ulWriteMinUs!=0U || atResults[0].ulReadMinUs!=0U )
+	{
+		printf("No transfers: invalid result.\n");
+		iResult = -1;
+	}
+
+	if( iResult==0 )
+	{
+		printf("OK\n");
+	}
+	else
+	{
+		printf("ERROR\n");
+	}
+
+	return (iResult==0) ? 0 : 1;
+}
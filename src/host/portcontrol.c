@@ -0,0 +1,15 @@
+#include "portcontrol.h"
+
+
+/* This replaces src/portcontrol.c in the host build. The simulated units
+ * have no pins, so there is nothing to configure.
+ */
+void portcontrol_apply(const unsigned short *pusIndex, const unsigned short *pusConfiguration, unsigned int sizConfiguration)
+{
+}
+
+
+
+void portcontrol_apply_mmio(const unsigned char *pucMmioIndex, const unsigned short *pusConfiguration, unsigned int sizConfiguration)
+{
+}
@@ -0,0 +1,28 @@
+#include "systime.h"
+
+#include <time.h>
+
+
+unsigned long systime_get_ms(void)
+{
+	struct timespec tNow;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (unsigned long)tNow.tv_sec * 1000U + (unsigned long)tNow.tv_nsec / 1000000U;
+}
+
+
+
+void systime_handle_start_ms(TIMER_HANDLE_T *ptHandle, unsigned long ulDuration)
+{
+	ptHandle->ulStart = systime_get_ms();
+	ptHandle->ulDuration = ulDuration;
+}
+
+
+
+int systime_handle_is_elapsed(TIMER_HANDLE_T *ptHandle)
+{
+	return ((systime_get_ms() - ptHandle->ulStart)>ptHandle->ulDuration) ? 1 : 0;
+}
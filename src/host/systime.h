@@ -0,0 +1,20 @@
+#ifndef __SYSTIME_H__
+#define __SYSTIME_H__
+
+
+/* This replaces the systime module of the platform library in the host
+ * build. It has only the functions which the driver uses.
+ */
+typedef struct TIMER_HANDLE_STRUCT
+{
+	unsigned long ulStart;
+	unsigned long ulDuration;
+} TIMER_HANDLE_T;
+
+
+unsigned long systime_get_ms(void);
+void systime_handle_start_ms(TIMER_HANDLE_T *ptHandle, unsigned long ulDuration);
+int systime_handle_is_elapsed(TIMER_HANDLE_T *ptHandle);
+
+
+#endif  /* __SYSTIME_H__ */
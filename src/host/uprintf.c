@@ -0,0 +1,15 @@
+#include "uprintf.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+
+void uprintf(const char *pcFmt, ...)
+{
+	va_list ptArgument;
+
+
+	va_start(ptArgument, pcFmt);
+	vprintf(pcFmt, ptArgument);
+	va_end(ptArgument);
+}
@@ -0,0 +1,11 @@
+#ifndef __UPRINTF_H__
+#define __UPRINTF_H__
+
+
+/* This replaces the uprintf module of the platform library in the host
+ * build. The messages go to stdout.
+ */
+void uprintf(const char *pcFmt, ...);
+
+
+#endif  /* __UPRINTF_H__ */
@@ -0,0 +1,154 @@
+#include "i2c_benchmark.h"
+
+#include <string.h>
+
+#include "cycle_counter.h"
+#include "i2c_dispatch.h"
+#include "i2c_regfile.h"
+#include "uprintf.h"
+
+
+static void benchmark_update(unsigned long ulCycles, uint32_t *pulTotalUs, uint32_t *pulMinUs, uint32_t *pulMaxUs)
+{
+	unsigned long ulUs;
+
+
+	ulUs = ulCycles / CYCLE_COUNTER_CLOCKS_PER_US;
+	*pulTotalUs += ulUs;
+	if( ulUs<*pulMinUs )
+	{
+		*pulMinUs = ulUs;
+	}
+	if( ulUs>*pulMaxUs )
+	{
+		*pulMaxUs = ulUs;
+	}
+}
+
+
+
+int i2c_benchmark_run(I2C_HANDLE_T *ptHandle, I2C_HANDLE_T *ptSlaveHandle, unsigned int uiAddress, unsigned long ulSpeedMask, unsigned int sizTransfer, unsigned long ulTransfers, unsigned char *pucWorkBuffer, I2C_BENCHMARK_RESULT_T *ptResults, unsigned long *pulResults, unsigned long ulVerbose)
+{
+	int iResult;
+	I2C_REGFILE_T tRegFile;
+	I2C_BENCHMARK_RESULT_T *ptResult;
+	unsigned char *pucRegisters;
+	unsigned char *pucTx;
+	unsigned char *pucRx;
+	unsigned int uiSpeed;
+	unsigned long ulSpeedBefore;
+	unsigned long ulTransfer;
+	unsigned long ulStart;
+	unsigned int uiCnt;
+
+
+	*pulResults = 0;
+
+	/* Split the work buffer. The TX buffer has the register pointer in
+	 * the first byte.
+	 */
+	pucRegisters = pucWorkBuffer;
+	pucTx = pucRegisters + sizTransfer;
+	pucRx = pucTx + sizTransfer + 1U;
+
+	i2c_regfile_init(&tRegFile, pucRegisters, sizTransfer);
+	iResult = i2c_core_hsoc_v2_slave_enable(ptSlaveHandle, uiAddress, &tRegFile);
+	if( iResult!=0 )
+	{
+		uprintf("Failed to enable the slave.\n");
+	}
+	else
+	{
+		ulSpeedBefore = i2c_core_hsoc_v2_get_device_specific_speed(ptHandle);
+
+		/* Service the slave while the master waits. */
+		ptHandle->fnIdle = i2c_core_hsoc_v2_slave_service;
+		ptHandle->pvIdleUser = ptSlaveHandle;
+
+		ptResult = ptResults;
+		for(uiSpeed=I2CSPEED_50; uiSpeed<=I2CSPEED_3400; ++uiSpeed)
+		{
+			if( (ulSpeedMask&(1U<<uiSpeed))==0 )
+			{
+				continue;
+			}
+
+			I2C_SET_DEVICE_SPECIFIC_SPEED(ptHandle, uiSpeed);
+
+			ptResult->ulSpeed = uiSpeed;
+			ptResult->ulBytes = 0;
+			ptResult->ulWriteTotalUs = 0;
+			ptResult->ulWriteMinUs = 0xffffffffU;
+			ptResult->ulWriteMaxUs = 0;
+			ptResult->ulReadTotalUs = 0;
+			ptResult->ulReadMinUs = 0xffffffffU;
+			ptResult->ulReadMaxUs = 0;
+			ptResult->ulErrors = 0;
+
+			for(ulTransfer=0; ulTransfer<ulTransfers; ++ulTransfer)
+			{
+				/* Write a new pattern for each transfer. */
+				pucTx[0] = 0;
+				for(uiCnt=0; uiCnt<sizTransfer; ++uiCnt)
+				{
+					pucTx[uiCnt+1U] = (unsigned char)(uiCnt + ulTransfer);
+				}
+
+				ulStart = cycle_counter_get();
+				iResult = I2C_SEND(ptHandle, (int)uiAddress|I2C_START_COND|I2C_STOP_COND, 0, sizTransfer+1U, pucTx);
+				benchmark_update(cycle_counter_get()-ulStart, &(ptResult->ulWriteTotalUs), &(ptResult->ulWriteMinUs), &(ptResult->ulWriteMaxUs));
+				if( iResult!=0 )
+				{
+					++ptResult->ulErrors;
+					continue;
+				}
+
+				/* Set the register pointer and read the data back. */
+				memset(pucRx, 0, sizTransfer);
+				ulStart = cycle_counter_get();
+				iResult = I2C_SEND(ptHandle, (int)uiAddress|I2C_START_COND, 0, 1, pucTx);
+				if( iResult==0 )
+				{
+					iResult = I2C_RECV(ptHandle, (int)uiAddress|I2C_START_COND|I2C_STOP_COND, 0, sizTransfer, pucRx);
+				}
+				benchmark_update(cycle_counter_get()-ulStart, &(ptResult->ulReadTotalUs), &(ptResult->ulReadMinUs), &(ptResult->ulReadMaxUs));
+				if( iResult!=0 || memcmp(pucTx+1, pucRx, sizTransfer)!=0 )
+				{
+					++ptResult->ulErrors;
+					continue;
+				}
+
+				ptResult->ulBytes += sizTransfer;
+			}
+
+			/* There is no minimum without a measurement. */
+			if( ptResult->ulWriteMinUs==0xffffffffU )
+			{
+				ptResult->ulWriteMinUs = 0;
+			}
+			if( ptResult->ulReadMinUs==0xffffffffU )
+			{
+				ptResult->ulReadMinUs = 0;
+			}
+
+			if( ulVerbose!=0U )
+			{
+				uprintf("Speed %d: %d bytes, write %d us, read %d us, %d errors\n", uiSpeed, ptResult->ulBytes, ptResult->ulWriteTotalUs, ptResult->ulReadTotalUs, ptResult->ulErrors);
+			}
+
+			++ptResult;
+			++(*pulResults);
+		}
+
+		ptHandle->fnIdle = NULL;
+		ptHandle->pvIdleUser = NULL;
+		i2c_core_hsoc_v2_slave_disable(ptSlaveHandle);
+
+		/* Restore the speed from before the benchmark. */
+		I2C_SET_DEVICE_SPECIFIC_SPEED(ptHandle, ulSpeedBefore);
+
+		iResult = 0;
+	}
+
+	return iResult;
+}
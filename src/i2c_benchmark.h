@@ -0,0 +1,18 @@
+#ifndef __I2C_BENCHMARK_H__
+#define __I2C_BENCHMARK_H__
+
+#include "i2c_interface.h"
+#include "interface.h"
+
+
+/* Measure the throughput between 2 cores which are wired back to back.
+ * The slave serves a register file and is serviced while the master waits
+ * for the hardware. There is one result for each bit in "ulSpeedMask". The
+ * work buffer must have 3*sizTransfer+1 bytes.
+ * This has no hardware dependencies beyond the driver, so the host build
+ * runs it with simulated units.
+ */
+int i2c_benchmark_run(I2C_HANDLE_T *ptHandle, I2C_HANDLE_T *ptSlaveHandle, unsigned int uiAddress, unsigned long ulSpeedMask, unsigned int sizTransfer, unsigned long ulTransfers, unsigned char *pucWorkBuffer, I2C_BENCHMARK_RESULT_T *ptResults, unsigned long *pulResults, unsigned long ulVerbose);
+
+
+#endif  /* __I2C_BENCHMARK_H__ */
@@ -0,0 +1,20 @@
+#include "i2c_capture.h"
+
+
+/* Create an empty capture ring in the buffer. The result is NULL if the
+ * buffer is too small for the header and at least one record.
+ */
+I2C_CAPTURE_T *i2c_capture_init(void *pvBuffer, size_t sizBuffer)
+{
+	I2C_CAPTURE_T *ptCapture;
+
+
+	ptCapture = (I2C_CAPTURE_T*)i2c_ring_init(pvBuffer, sizBuffer, sizeof(I2C_CAPTURE_T), sizeof(I2C_CAPTURE_RECORD_T), 1);
+	if( ptCapture!=NULL )
+	{
+		ptCapture->ulRecordsTotal = 0;
+		ptCapture->ulClocksPerUs = CYCLE_COUNTER_CLOCKS_PER_US;
+	}
+
+	return ptCapture;
+}
@@ -0,0 +1,72 @@
+#ifndef __I2C_CAPTURE_H__
+#define __I2C_CAPTURE_H__
+
+#include <stddef.h>
+
+#include "cycle_counter.h"
+#include "i2c_ring.h"
+
+
+/* These are the events in the capture ring. */
+typedef enum I2C_CAPTURE_EVENT_ENUM
+{
+	I2C_CAPTURE_EVENT_Start = 0,         /* (Repeated) START condition, the data is the address byte with the R/W bit. */
+	I2C_CAPTURE_EVENT_AddressAck = 1,    /* The slave acknowledged the address. */
+	I2C_CAPTURE_EVENT_AddressNak = 2,    /* The slave did not acknowledge the address. */
+	I2C_CAPTURE_EVENT_DataWrite = 3,     /* The master sent the data byte. */
+	I2C_CAPTURE_EVENT_DataRead = 4,      /* The master received the data byte. */
+	I2C_CAPTURE_EVENT_DataNak = 5,       /* The slave did not acknowledge the last data byte. */
+	I2C_CAPTURE_EVENT_Stop = 6,          /* STOP condition. */
+	I2C_CAPTURE_EVENT_Timeout = 7        /* A command timed out and the bus was recovered. */
+} I2C_CAPTURE_EVENT_T;
+
+
+/* One event in the capture ring. The timestamp is the value of the cycle
+ * counter when the CPU handled the event. For data bytes this is the time
+ * when the byte was moved to or from the FIFO, not the time on the bus.
+ */
+typedef struct I2C_CAPTURE_RECORD_STRUCT
+{
+	unsigned long ulTimestamp;
+	unsigned char ucEvent;
+	unsigned char ucData;
+	unsigned short usReserved;
+} I2C_CAPTURE_RECORD_T;
+
+
+/* The capture ring starts with this header. It is followed by "ulMaxRecords"
+ * records. If the ring is full, the oldest record is overwritten. The oldest
+ * record is at index 0 as long as "ulRecordsTotal" is not larger than
+ * "ulMaxRecords". Then it is at "ulWriteIndex". The read index of the ring
+ * is not used.
+ */
+typedef struct I2C_CAPTURE_STRUCT
+{
+	I2C_RING_T tRing;
+	unsigned long ulRecordsTotal;
+	unsigned long ulClocksPerUs;    /* The resolution of the timestamps. */
+	I2C_CAPTURE_RECORD_T atRecords[];
+} I2C_CAPTURE_T;
+
+
+I2C_CAPTURE_T *i2c_capture_init(void *pvBuffer, size_t sizBuffer);
+
+
+static inline void i2c_capture_add(I2C_CAPTURE_T *ptCapture, unsigned int uiEvent, unsigned int uiData)
+{
+	I2C_CAPTURE_RECORD_T *ptRecord;
+	unsigned long ulWriteIndex;
+
+
+	ulWriteIndex = ptCapture->tRing.ulWriteIndex;
+	ptRecord = ptCapture->atRecords + ulWriteIndex;
+	ptRecord->ulTimestamp = cycle_counter_get();
+	ptRecord->ucEvent = (unsigned char)uiEvent;
+	ptRecord->ucData = (unsigned char)uiData;
+
+	ptCapture->tRing.ulWriteIndex = i2c_ring_next_index(&(ptCapture->tRing), ulWriteIndex);
+	++ptCapture->ulRecordsTotal;
+}
+
+
+#endif  /* __I2C_CAPTURE_H__ */
@@ -1,36 +1,53 @@
 #include "i2c_core_hsoc_v2.h"
 
+#include <stdint.h>
 #include <string.h>
 
+#include "cycle_counter.h"
+#include "i2c_capture.h"
 #include "netx_io_areas.h"
 #include "portcontrol.h"
 #include "systime.h"
+#include "tcm.h"
 #include "uprintf.h"
 
 
-typedef enum
+/* The host build runs the driver against simulated units. */
+#ifndef CFG_HOST_SIM
+#       define CFG_HOST_SIM 0
+#endif
+
+#if CFG_HOST_SIM!=0
+#       include "i2c_sim.h"
+#endif
+
+
+/*-----------------------------------*/
+
+
+/* All register accesses of the driver go through these functions. On the
+ * netX they are plain volatile accesses. The host build passes them to the
+ * simulation, as a read of a FIFO register has a side effect.
+ */
+static inline uint32_t i2c_reg_read(volatile uint32_t *pulRegister)
 {
-	I2CCMD_START    = 0,    /* Generate (r)START-condition. */
-	I2CCMD_S_AC     = 1,    /* Acknowledge-polling: generate up to acpollmax+1 START-sequences (until acknowledged by slave). */
-	I2CCMD_S_AC_T   = 2,    /* Run S_AC, then transfer tsize+1 bytes from/to master FIFO. Not to be continued. */
-	I2CCMD_S_AC_TC  = 3,    /* Run S_AC, then transfer tsize+1 bytes from/to master FIFO. To be continued. */
-	I2CCMD_CT       = 4,    /* Continued transfer not to be continued. */
-	I2CCMD_CTC      = 5,    /* Continued transfer to be continued. */
-	I2CCMD_STOP     = 6,    /* Generate STOP-condition. */
-	I2CCMD_IDLE     = 7     /* Nothing to do, last command finished, break current command. */
-} I2CCMD_T;
-
-typedef enum
+#if CFG_HOST_SIM!=0
+	return i2c_sim_read(pulRegister);
+#else
+	return *pulRegister;
+#endif
+}
+
+
+static inline void i2c_reg_write(volatile uint32_t *pulRegister, uint32_t ulValue)
 {
-	I2CSPEED_50     = 0,    /* Fast/Standard-mode, 50kbit/s */
-	I2CSPEED_100    = 1,    /* Fast/Standard-mode, 100kbit/s */
-	I2CSPEED_200    = 2,    /* Fast/Standard-mode, 200kbit/s */
-	I2CSPEED_400    = 3,    /* Fast/Standard-mode, 400kbit/s */
-	I2CSPEED_800    = 4,    /* Fast/Standard-mode, 800kbit/s */
-	I2CSPEED_1200   = 5,    /* Fast/Standard-mode, 1.2Mbit/s */
-	I2CSPEED_1700   = 6,    /* High-speed-mode, 1.7Mbit/s */
-	I2CSPEED_3400   = 7     /* High-speed-mode, 3.4Mbit/s */
-} I2CSPEED_T;
+#if CFG_HOST_SIM!=0
+	i2c_sim_write(pulRegister, ulValue);
+#else
+	*pulRegister = ulValue;
+#endif
+}
+
 
 /*-----------------------------------*/
 
@@ -59,10 +76,205 @@ static const unsigned char aucMmioFunctions_netx4000_I2C2[2] =
 /*-----------------------------------*/
 
 
-static int i2c_wait_for_command_done(const I2C_HANDLE_T *ptHandle)
+/* Add an event to the capture ring of the handle. This is just one compare
+ * if the capture is disabled.
+ */
+static inline void i2c_capture(I2C_HANDLE_T *ptHandle, I2C_CAPTURE_EVENT_T tEvent, unsigned int uiData)
+{
+	if( ptHandle->ptCapture!=NULL )
+	{
+		i2c_capture_add(ptHandle->ptCapture, tEvent, uiData);
+	}
+}
+
+
+
+/* This is the bus speed in kbit/s for all I2CSPEED_T values. */
+static const unsigned short ausSpeedKbps[8] =
+{
+	50,     /* I2CSPEED_50 */
+	100,    /* I2CSPEED_100 */
+	200,    /* I2CSPEED_200 */
+	400,    /* I2CSPEED_400 */
+	800,    /* I2CSPEED_800 */
+	1200,   /* I2CSPEED_1200 */
+	1700,   /* I2CSPEED_1700 */
+	3400    /* I2CSPEED_3400 */
+};
+
+
+/* Start the timeout for a command which transfers "uiBytes" bytes including
+ * the address bytes of all ACK polls. The timeout is derived from the current
+ * bus speed plus the clock stretch allowance of the handle. One more
+ * millisecond is added as the timer has a resolution of 1ms.
+ */
+static void TCM_CODE i2c_timeout_start(I2C_HANDLE_T *ptHandle, TIMER_HANDLE_T *ptTimer, unsigned int uiBytes)
+{
+	unsigned long ulValue;
+	unsigned long ulBits;
+	unsigned long ulTimeoutMs;
+
+
+	ulValue   = i2c_reg_read(&ptHandle->ptI2cUnit->ulI2c_mcr);
+	ulValue  &= HOSTMSK(i2c_mcr_mode);
+	ulValue >>= HOSTSRT(i2c_mcr_mode);
+
+	/* Every byte has 8 data bits and the ACK. Add 2 bits for START and STOP. */
+	ulBits = ((unsigned long)uiBytes * 9U) + 2U;
+	/* Round up to complete milliseconds. */
+	ulTimeoutMs  = (ulBits + ausSpeedKbps[ulValue] - 1U) / ausSpeedKbps[ulValue];
+	ulTimeoutMs += ptHandle->ulClockStretchMs + 1U;
+
+	systime_handle_start_ms(ptTimer, ulTimeoutMs);
+}
+
+
+
+/* Forget the selected channels of all multiplexers. After a failed transfer
+ * or a recovery of the bus, it is not known which writes reached a
+ * multiplexer.
+ */
+void TCM_CODE i2c_core_hsoc_v2_mux_cache_clear(I2C_HANDLE_T *ptHandle)
+{
+	unsigned int uiCnt;
+
+
+	for(uiCnt=0; uiCnt<I2C_MUX_CACHE_SIZE; ++uiCnt)
+	{
+		ptHandle->atMuxCache[uiCnt].ucAddress = 0xffU;
+		ptHandle->atMuxCache[uiCnt].ucChannels = 0U;
+	}
+}
+
+
+
+/* Free a stuck bus.
+ * A slave which missed some clocks might still hold SDA low. Clock out SCL
+ * pulses in PIO mode until SDA is released, generate a STOP condition and
+ * reset the core. The reset clears all registers, so the configuration of
+ * the core is saved first and restored at the end. This keeps the speed,
+ * the slave address and the FIFO, IRQ and DMA settings.
+ */
+static int TCM_CODE i2c_core_hsoc_v2_recover(I2C_HANDLE_T *ptHandle)
+{
+	unsigned long ulMcr;
+	unsigned long ulScr;
+	unsigned long ulMfifoCr;
+	unsigned long ulSfifoCr;
+	unsigned long ulIrqMsk;
+	unsigned long ulDmaCr;
+	unsigned long ulValue;
+	unsigned long ulHalfPeriodUs;
+	unsigned int uiPulses;
+	int iResult;
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	ptI2cUnit = ptHandle->ptI2cUnit;
+
+	/* Save the configuration. */
+	ulMcr  = i2c_reg_read(&ptI2cUnit->ulI2c_mcr);
+	ulMcr &= ~(HOSTMSK(i2c_mcr_rst_i2c) | HOSTMSK(i2c_mcr_pio_mode));
+	ulScr  = i2c_reg_read(&ptI2cUnit->ulI2c_scr);
+	ulMfifoCr  = i2c_reg_read(&ptI2cUnit->ulI2c_mfifo_cr);
+	ulMfifoCr &= ~HOSTMSK(i2c_mfifo_cr_mfifo_clr);
+	ulSfifoCr  = i2c_reg_read(&ptI2cUnit->ulI2c_sfifo_cr);
+	ulSfifoCr &= ~HOSTMSK(i2c_sfifo_cr_sfifo_clr);
+	ulIrqMsk = i2c_reg_read(&ptI2cUnit->ulI2c_irqmsk);
+	ulDmaCr = i2c_reg_read(&ptI2cUnit->ulI2c_dmacr);
+
+	/* Toggle SCL with the current bus speed. */
+	ulValue   = ulMcr & HOSTMSK(i2c_mcr_mode);
+	ulValue >>= HOSTSRT(i2c_mcr_mode);
+	ulHalfPeriodUs = (500U + ausSpeedKbps[ulValue] - 1U) / ausSpeedKbps[ulValue];
+
+	/* Switch to PIO mode with both lines released. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_pio, 0);
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulMcr | HOSTMSK(i2c_mcr_pio_mode));
+	cycle_counter_delay_us(ulHalfPeriodUs);
+
+	/* Clock out up to 9 pulses until the slave releases SDA. */
+	for(uiPulses=0; uiPulses<9; ++uiPulses)
+	{
+		if( (i2c_reg_read(&ptI2cUnit->ulI2c_pio)&HOSTMSK(i2c_pio_sda_in_ro))!=0 )
+		{
+			break;
+		}
+		i2c_reg_write(&ptI2cUnit->ulI2c_pio, HOSTMSK(i2c_pio_scl_oe));
+		cycle_counter_delay_us(ulHalfPeriodUs);
+		i2c_reg_write(&ptI2cUnit->ulI2c_pio, 0);
+		cycle_counter_delay_us(ulHalfPeriodUs);
+	}
+
+	/* Generate a STOP condition: SDA goes high while SCL is high. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_pio, HOSTMSK(i2c_pio_scl_oe));
+	cycle_counter_delay_us(ulHalfPeriodUs);
+	i2c_reg_write(&ptI2cUnit->ulI2c_pio, HOSTMSK(i2c_pio_scl_oe) | HOSTMSK(i2c_pio_sda_oe));
+	cycle_counter_delay_us(ulHalfPeriodUs);
+	i2c_reg_write(&ptI2cUnit->ulI2c_pio, HOSTMSK(i2c_pio_sda_oe));
+	cycle_counter_delay_us(ulHalfPeriodUs);
+	i2c_reg_write(&ptI2cUnit->ulI2c_pio, 0);
+	cycle_counter_delay_us(ulHalfPeriodUs);
+
+	/* Are both lines free now? */
+	ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_pio);
+	ulValue &= HOSTMSK(i2c_pio_sda_in_ro) | HOSTMSK(i2c_pio_scl_in_ro);
+	if( ulValue==(HOSTMSK(i2c_pio_sda_in_ro) | HOSTMSK(i2c_pio_scl_in_ro)) )
+	{
+		iResult = 0;
+	}
+	else
+	{
+		iResult = -1;
+	}
+
+	/* Reset the unit. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, HOSTMSK(i2c_mcr_rst_i2c));
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, 0);
+
+	/* Clear the master FIFO. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_mfifo_cr, HOSTMSK(i2c_mfifo_cr_mfifo_clr));
+	i2c_reg_write(&ptI2cUnit->ulI2c_mfifo_cr, 0);
+
+	/* Clear the timeout state. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_sr, HOSTMSK(i2c_sr_timeout));
+
+	/* Restore the configuration. The master control register is the last
+	 * one, as it enables the unit again.
+	 */
+	i2c_reg_write(&ptI2cUnit->ulI2c_scr, ulScr);
+	i2c_reg_write(&ptI2cUnit->ulI2c_mfifo_cr, ulMfifoCr);
+	i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, ulSfifoCr);
+	i2c_reg_write(&ptI2cUnit->ulI2c_irqmsk, ulIrqMsk);
+	i2c_reg_write(&ptI2cUnit->ulI2c_dmacr, ulDmaCr);
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulMcr);
+
+	i2c_core_hsoc_v2_mux_cache_clear(ptHandle);
+
+	if( iResult!=0 )
+	{
+		uprintf("Failed to free the bus.\n");
+	}
+
+	return iResult;
+}
+
+
+
+static int TCM_CODE i2c_timeout_handle(I2C_HANDLE_T *ptHandle)
+{
+	uprintf("The I2C command timed out. Recovering the bus.\n");
+	i2c_capture(ptHandle, I2C_CAPTURE_EVENT_Timeout, 0);
+	i2c_core_hsoc_v2_recover(ptHandle);
+
+	return I2C_RESULT_Timeout;
+}
+
+
+
+static int TCM_CODE i2c_wait_for_command_done(I2C_HANDLE_T *ptHandle, TIMER_HANDLE_T *ptTimer)
 {
 	unsigned long ulValue;
-	TIMER_HANDLE_T tTimerHandle;
 	int iResult;
 	HOSTADEF(I2C) * ptI2cUnit;
 
@@ -71,107 +283,177 @@ static int i2c_wait_for_command_done(const I2C_HANDLE_T *ptHandle)
 	ptI2cUnit = ptHandle->ptI2cUnit;
 
 	/* Wait until the command is finished. */
-	systime_handle_start_ms(&tTimerHandle, 1000);
 	do
 	{
-		if( systime_handle_is_elapsed(&tTimerHandle)!=0 )
+		ulValue   = i2c_reg_read(&ptI2cUnit->ulI2c_cmd);
+		ulValue  &= HOSTMSK(i2c_cmd_cmd);
+		ulValue >>= HOSTSRT(i2c_cmd_cmd);
+		if( ulValue==I2CCMD_IDLE )
 		{
-			iResult = -1;
 			break;
 		}
 
-		ulValue   = ptI2cUnit->ulI2c_cmd;
-		ulValue  &= HOSTMSK(i2c_cmd_cmd);
-		ulValue >>= HOSTSRT(i2c_cmd_cmd);
-	} while( ulValue!=I2CCMD_IDLE );
+		if( ptHandle->fnIdle!=NULL )
+		{
+			ptHandle->fnIdle(ptHandle->pvIdleUser);
+		}
+
+		if( systime_handle_is_elapsed(ptTimer)!=0 )
+		{
+			iResult = i2c_timeout_handle(ptHandle);
+			break;
+		}
+	} while( 1 );
 
 	return iResult;
 }
 
 
 
-static int i2c_core_hsoc_v2_send(const I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, const unsigned char *pucData)
+static int TCM_CODE i2c_core_hsoc_v2_stop(I2C_HANDLE_T *ptHandle)
+{
+	unsigned long ulValue;
+	int iResult;
+	TIMER_HANDLE_T tTimer;
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	ptI2cUnit = ptHandle->ptI2cUnit;
+
+	/* Execute stop condition. */
+	i2c_capture(ptHandle, I2C_CAPTURE_EVENT_Stop, 0);
+	i2c_timeout_start(ptHandle, &tTimer, 1);
+	ulValue  = 1 << HOSTSRT(i2c_cmd_nwr);
+	ulValue |= I2CCMD_STOP << HOSTSRT(i2c_cmd_cmd);
+	ulValue |= 0 << HOSTSRT(i2c_cmd_tsize);
+	ulValue |= 0 << HOSTSRT(i2c_cmd_acpollmax);
+	i2c_reg_write(&ptI2cUnit->ulI2c_cmd, ulValue);
+
+	iResult = i2c_wait_for_command_done(ptHandle, &tTimer);
+	if( iResult!=0 )
+	{
+		uprintf("Failed to execute the stop command.\n");
+	}
+
+	return iResult;
+}
+
+
+
+static int TCM_CODE i2c_core_hsoc_v2_start(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned long ulNwr)
 {
 	unsigned long ulAddress;
 	unsigned long ulValue;
-	const unsigned char *pucBufferCnt;
-	const unsigned char *pucBufferEnd;
-	unsigned int uiChunkTransaction;
 	int iResult;
+	TIMER_HANDLE_T tTimer;
 	HOSTADEF(I2C) * ptI2cUnit;
 
 
-	iResult = 0;
 	ptI2cUnit = ptHandle->ptI2cUnit;
 
 	/* Limit ACK poll to valid range. */
-	if( uiAckPoll>(HOSTMSK(i2c_cmd_acpollmax)>>HOSTSRT(i2c_cmd_acpollmax)) )
+	if( uiAckPoll>I2C_CORE_HSOC_V2_ACKPOLL_MAX )
 	{
-		uiAckPoll = HOSTMSK(i2c_cmd_acpollmax) >> HOSTSRT(i2c_cmd_acpollmax);
+		uiAckPoll = I2C_CORE_HSOC_V2_ACKPOLL_MAX;
 	}
 
-	/* Check parameters. */
-	/* This core can not send start conditions without data. */
-	if( (iCond&I2C_START_COND)!=0 && uiDataLength==0 )
+	/* Get the first data byte and make a proper ID. */
+	ulAddress   = (unsigned long)(iCond & 0x7f);
+	ulAddress <<= HOSTSRT(i2c_mcr_sadr);
+	ulAddress  &= HOSTMSK(i2c_mcr_sadr);
+
+	/* First byte of the command is the ID. */
+	ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_mcr);
+	ulValue &= ~HOSTMSK(i2c_mcr_sadr);
+	ulValue |= ulAddress;
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulValue);
+
+	/* Execute start condition. Each ACK poll is one more address byte. */
+	i2c_capture(ptHandle, I2C_CAPTURE_EVENT_Start, (unsigned int)(((iCond & 0x7f) << 1U) | ulNwr));
+	i2c_timeout_start(ptHandle, &tTimer, uiAckPoll + 1U);
+	ulValue  = ulNwr << HOSTSRT(i2c_cmd_nwr);
+	ulValue |= I2CCMD_S_AC << HOSTSRT(i2c_cmd_cmd);
+	ulValue |= uiAckPoll << HOSTSRT(i2c_cmd_acpollmax);
+	i2c_reg_write(&ptI2cUnit->ulI2c_cmd, ulValue);
+
+	iResult = i2c_wait_for_command_done(ptHandle, &tTimer);
+	if( iResult!=0 )
 	{
-		iResult = -1;
+		uprintf("Failed to execute the start command.\n");
 	}
-
-	/* handle start condition separately */
-	if( iResult==0 && (iCond&I2C_START_COND)!=0 )
+	else
 	{
-		/* Get the first data byte and make a proper ID. */
-		ulAddress   = (unsigned long)(iCond & 0x7f);
-		ulAddress <<= HOSTSRT(i2c_mcr_sadr);
-		ulAddress  &= HOSTMSK(i2c_mcr_sadr);
-
-		/* First byte of the command is the ID. */
-		ulValue  = ptI2cUnit->ulI2c_mcr;
-		ulValue &= ~HOSTMSK(i2c_mcr_sadr);
-		ulValue |= ulAddress;
-		ptI2cUnit->ulI2c_mcr = ulValue;
-
-		/* Execute start condition in write mode. */
-		ulValue  = 0 << HOSTSRT(i2c_cmd_nwr);
-		ulValue |= I2CCMD_S_AC << HOSTSRT(i2c_cmd_cmd);
-		ulValue |= uiAckPoll << HOSTSRT(i2c_cmd_acpollmax);
-		ptI2cUnit->ulI2c_cmd = ulValue;
-
-		iResult = i2c_wait_for_command_done(ptHandle);
-		if( iResult!=0 )
+		/* Was the start condition acknowledged? */
+		ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
+		ulValue &= HOSTMSK(i2c_sr_last_ac);
+		if( ulValue==0 )
 		{
-			uprintf("Failed to execute the start command.\n");
+			/* No ACK received. Release the bus, so that the command can be repeated. */
+			uprintf("No ACK received.\n");
+			i2c_capture(ptHandle, I2C_CAPTURE_EVENT_AddressNak, 0);
+			i2c_core_hsoc_v2_stop(ptHandle);
+			iResult = I2C_RESULT_NakAddress;
 		}
 		else
 		{
-			/* Was the start condition acknowledged? */
-			ulValue  = ptI2cUnit->ulI2c_sr;
-			ulValue &= HOSTMSK(i2c_sr_last_ac);
-			if( ulValue==0 )
-			{
-				/* No ACK received. */
-				uprintf("No ACK received.\n");
-				iResult = -1;
-			}
+			i2c_capture(ptHandle, I2C_CAPTURE_EVENT_AddressAck, 0);
 		}
 	}
 
-	if( iResult==0 && uiDataLength!=0 )
-	{
-		/* Send data. */
-		pucBufferCnt = pucData;
+	return iResult;
+}
+
 
-		ptI2cUnit->ulI2c_mdr = *(pucBufferCnt++);
 
+/* Send the data phase of a write transfer. The data is either taken from
+ * the buffer "pucData" or, if this is NULL, from the callback "fnGetByte".
+ */
+static int TCM_CODE i2c_core_hsoc_v2_send_data(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiDataLength, const unsigned char *pucData, PFN_I2C_GET_BYTE_T fnGetByte, void *pvUser)
+{
+	unsigned long ulValue;
+	unsigned int uiChunkTransaction;
+	unsigned char ucData;
+	int iResult;
+	TIMER_HANDLE_T tTimer;
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	iResult = 0;
+	ptI2cUnit = ptHandle->ptI2cUnit;
+
+	while( uiDataLength!=0 )
+	{
 		uiChunkTransaction = uiDataLength;
-		if( uiChunkTransaction>((HOSTMSK(i2c_cmd_tsize)>>HOSTSRT(i2c_cmd_tsize))+1U) )
+		if( uiChunkTransaction>I2C_CORE_HSOC_V2_TRANSFER_SIZE_MAX )
+		{
+			uiChunkTransaction = I2C_CORE_HSOC_V2_TRANSFER_SIZE_MAX;
+		}
+		uiDataLength -= uiChunkTransaction;
+
+		/* Put the first byte in the FIFO before the transfer starts. */
+		if( pucData!=NULL )
+		{
+			ucData = *(pucData++);
+		}
+		else
 		{
-			uiChunkTransaction = (HOSTMSK(i2c_cmd_tsize)>>HOSTSRT(i2c_cmd_tsize)) + 1U;
+			ucData = fnGetByte(pvUser);
 		}
+		i2c_reg_write(&ptI2cUnit->ulI2c_mdr, ucData);
+		i2c_capture(ptHandle, I2C_CAPTURE_EVENT_DataWrite, ucData);
+		ptHandle->ulBytesTransferred += uiChunkTransaction;
 
 		/* Execute transfer. */
+		i2c_timeout_start(ptHandle, &tTimer, uiChunkTransaction);
+		--uiChunkTransaction;
 		ulValue  = 0 << HOSTSRT(i2c_cmd_nwr);
-		if( (iCond&I2C_CONTINUE)==0 )
+		/* Is this the last transfer for this data block? */
+		if( uiDataLength!=0 )
+		{
+			/* No -> there will be more transfers. */
+			ulValue |= I2CCMD_CTC << HOSTSRT(i2c_cmd_cmd);
+		}
+		else if( (iCond&I2C_CONTINUE)==0 )
 		{
 			/* Do not continue this operation. */
 			ulValue |= I2CCMD_CT << HOSTSRT(i2c_cmd_cmd);
@@ -181,127 +463,156 @@ static int i2c_core_hsoc_v2_send(const I2C_HANDLE_T *ptHandle, int iCond, unsign
 			/* Continue this operation with another write command. */
 			ulValue |= I2CCMD_CTC << HOSTSRT(i2c_cmd_cmd);
 		}
-		ulValue |= (uiChunkTransaction-1U) << HOSTSRT(i2c_cmd_tsize);
+		ulValue |= uiChunkTransaction << HOSTSRT(i2c_cmd_tsize);
 		ulValue |= 0 << HOSTSRT(i2c_cmd_acpollmax);
-		ptI2cUnit->ulI2c_cmd = ulValue;
+		i2c_reg_write(&ptI2cUnit->ulI2c_cmd, ulValue);
 
-		/* Receive the transaction data. */
-		pucBufferEnd = pucData + uiChunkTransaction;
-		while( pucBufferCnt<pucBufferEnd )
+		/* Refill the FIFO with the rest of the chunk. */
+		while( uiChunkTransaction!=0 )
 		{
-			ulValue  = ptI2cUnit->ulI2c_sr;
+			ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
 			ulValue &= HOSTMSK(i2c_sr_mfifo_full);
 			if( ulValue==0 )
 			{
-				ptI2cUnit->ulI2c_mdr = *(pucBufferCnt++);
+				if( pucData!=NULL )
+				{
+					ucData = *(pucData++);
+				}
+				else
+				{
+					ucData = fnGetByte(pvUser);
+				}
+				i2c_reg_write(&ptI2cUnit->ulI2c_mdr, ucData);
+				i2c_capture(ptHandle, I2C_CAPTURE_EVENT_DataWrite, ucData);
+				--uiChunkTransaction;
+			}
+			else
+			{
+				if( ptHandle->fnIdle!=NULL )
+				{
+					ptHandle->fnIdle(ptHandle->pvIdleUser);
+				}
+				if( systime_handle_is_elapsed(&tTimer)!=0 )
+				{
+					/* The FIFO does not drain. */
+					ptHandle->ulBytesTransferred -= uiChunkTransaction;
+					iResult = i2c_timeout_handle(ptHandle);
+					break;
+				}
 			}
 		}
+		if( iResult!=0 )
+		{
+			break;
+		}
 
-		uiDataLength -= uiChunkTransaction;
-
-		iResult = i2c_wait_for_command_done(ptHandle);
+		iResult = i2c_wait_for_command_done(ptHandle, &tTimer);
 		if( iResult!=0 )
 		{
-			uprintf("Failed to execute the start command.\n");
+			uprintf("Failed to execute the transfer command.\n");
+			break;
 		}
-		else
+
+		/* Was the data acknowledged? */
+		ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
+		ulValue &= HOSTMSK(i2c_sr_last_ac);
+		if( ulValue==0 )
 		{
-			/* Was the start condition acknowledged? */
-			ulValue  = ptI2cUnit->ulI2c_sr;
-			ulValue &= HOSTMSK(i2c_sr_last_ac);
-			if( ulValue==0 )
-			{
-				/* No ACK received. */
-				uprintf("No ACK received.\n");
-				iResult = -1;
-			}
+			/* No ACK received. Bytes still in the FIFO were not sent. */
+			uprintf("No ACK received.\n");
+			ulValue   = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
+			ulValue  &= HOSTMSK(i2c_sr_mfifo_level);
+			ulValue >>= HOSTSRT(i2c_sr_mfifo_level);
+			ptHandle->ulBytesTransferred -= ulValue;
+			i2c_capture(ptHandle, I2C_CAPTURE_EVENT_DataNak, 0);
+			iResult = I2C_RESULT_NakData;
+			break;
 		}
 	}
 
+	return iResult;
+}
+
+
+
+static int TCM_CODE i2c_core_hsoc_v2_send_generic(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, const unsigned char *pucData, PFN_I2C_GET_BYTE_T fnGetByte, void *pvUser)
+{
+	int iResult;
+
+
+	iResult = 0;
+
+	ptHandle->ulBytesTransferred = 0;
+
+	/* Check parameters. */
+	/* This core can not send start conditions without data. */
+	if( (iCond&I2C_START_COND)!=0 && uiDataLength==0 )
+	{
+		iResult = I2C_RESULT_InvalidParameter;
+	}
+
+	/* handle start condition separately */
+	if( iResult==0 && (iCond&I2C_START_COND)!=0 )
+	{
+		iResult = i2c_core_hsoc_v2_start(ptHandle, iCond, uiAckPoll, 0);
+	}
+
+	if( iResult==0 && uiDataLength!=0 )
+	{
+		iResult = i2c_core_hsoc_v2_send_data(ptHandle, iCond, uiDataLength, pucData, fnGetByte, pvUser);
+	}
+
 	/* Send a stop condition? */
 	if( iResult==0 && (iCond&I2C_STOP_COND)!=0 )
 	{
-		/* Execute stop condition. */
-		ulValue  = 1 << HOSTSRT(i2c_cmd_nwr);
-		ulValue |= I2CCMD_STOP << HOSTSRT(i2c_cmd_cmd);
-		ulValue |= 0 << HOSTSRT(i2c_cmd_tsize);
-		ulValue |= 0 << HOSTSRT(i2c_cmd_acpollmax);
-		ptI2cUnit->ulI2c_cmd = ulValue;
-
-		iResult = i2c_wait_for_command_done(ptHandle);
-		if( iResult!=0 )
-		{
-			uprintf("Failed to execute the start command.\n");
-		}
+		iResult = i2c_core_hsoc_v2_stop(ptHandle);
 	}
 
 	return iResult;
 }
 
 
-static int i2c_core_hsoc_v2_recv(const I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, unsigned char *pucData)
+
+int TCM_CODE TCM_SHORT_CALL i2c_core_hsoc_v2_send(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, const unsigned char *pucData)
+{
+	return i2c_core_hsoc_v2_send_generic(ptHandle, iCond, uiAckPoll, uiDataLength, pucData, NULL, NULL);
+}
+
+
+
+int TCM_CODE TCM_SHORT_CALL i2c_core_hsoc_v2_send_stream(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, PFN_I2C_GET_BYTE_T fnGetByte, void *pvUser)
+{
+	return i2c_core_hsoc_v2_send_generic(ptHandle, iCond, uiAckPoll, uiDataLength, NULL, fnGetByte, pvUser);
+}
+
+
+
+int TCM_CODE TCM_SHORT_CALL i2c_core_hsoc_v2_recv(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, unsigned char *pucData)
 {
 	int iResult;
-	unsigned long ulAddress;
 	unsigned long ulValue;
 	unsigned long ulChunkTransaction;
 	unsigned long ulChunkFifo;
+	TIMER_HANDLE_T tTimer;
 	HOSTADEF(I2C) * ptI2cUnit;
 
 
 	iResult = 0;
 	ptI2cUnit = ptHandle->ptI2cUnit;
 
-	/* Limit ACK poll to valid range. */
-	if( uiAckPoll>(HOSTMSK(i2c_cmd_acpollmax)>>HOSTSRT(i2c_cmd_acpollmax)) )
-	{
-		uiAckPoll = HOSTMSK(i2c_cmd_acpollmax) >> HOSTSRT(i2c_cmd_acpollmax);
-	}
+	ptHandle->ulBytesTransferred = 0;
 
 	/* Check parameters. */
 	/* This core can not send a start condition without data. */
 	if( (iCond&I2C_START_COND)!=0 && uiDataLength==0 )
 	{
-		iResult = -1;
+		iResult = I2C_RESULT_InvalidParameter;
 	}
 	else
 	{
 		if( (iCond&I2C_START_COND)!=0 )
 		{
-			/* Get the first data byte and make a proper ID. */
-			ulAddress   = (unsigned long)(iCond & 0x7f);
-			ulAddress <<= HOSTSRT(i2c_mcr_sadr);
-			ulAddress  &= HOSTMSK(i2c_mcr_sadr);
-
-			/* First byte of the command is the ID. */
-			ulValue  = ptI2cUnit->ulI2c_mcr;
-			ulValue &= ~HOSTMSK(i2c_mcr_sadr);
-			ulValue |= ulAddress;
-			ptI2cUnit->ulI2c_mcr = ulValue;
-
-			/* Execute start condition in write mode. */
-			ulValue  = 1 << HOSTSRT(i2c_cmd_nwr);
-			ulValue |= I2CCMD_S_AC << HOSTSRT(i2c_cmd_cmd);
-			ulValue |= uiAckPoll << HOSTSRT(i2c_cmd_acpollmax);
-			ptI2cUnit->ulI2c_cmd = ulValue;
-
-			iResult = i2c_wait_for_command_done(ptHandle);
-			if( iResult!=0 )
-			{
-				uprintf("Failed to execute the start command.\n");
-			}
-			else
-			{
-				/* Was the start condition acknowledged? */
-				ulValue  = ptI2cUnit->ulI2c_sr;
-				ulValue &= HOSTMSK(i2c_sr_last_ac);
-				if( ulValue==0 )
-				{
-					/* No ACK received. */
-					uprintf("No ACK received 1.\n");
-					iResult = -1;
-				}
-			}
+			iResult = i2c_core_hsoc_v2_start(ptHandle, iCond, uiAckPoll, 1);
 		}
 
 		if( iResult==0 && uiDataLength!=0 )
@@ -309,13 +620,14 @@ static int i2c_core_hsoc_v2_recv(const I2C_HANDLE_T *ptHandle, int iCond, unsign
 			while( uiDataLength!=0 )
 			{
 				ulChunkTransaction = uiDataLength;
-				if( ulChunkTransaction>((HOSTMSK(i2c_cmd_tsize)>>HOSTSRT(i2c_cmd_tsize))+1U) )
+				if( ulChunkTransaction>I2C_CORE_HSOC_V2_TRANSFER_SIZE_MAX )
 				{
-					ulChunkTransaction = (HOSTMSK(i2c_cmd_tsize)>>HOSTSRT(i2c_cmd_tsize)) + 1U;
+					ulChunkTransaction = I2C_CORE_HSOC_V2_TRANSFER_SIZE_MAX;
 				}
 				uiDataLength -= ulChunkTransaction;
 
 				/* Execute transfer. */
+				i2c_timeout_start(ptHandle, &tTimer, ulChunkTransaction);
 				ulValue  = 1 << HOSTSRT(i2c_cmd_nwr);
 				/* Is this the last transfer for this data block? */
 				if( uiDataLength!=0 )
@@ -338,12 +650,12 @@ static int i2c_core_hsoc_v2_recv(const I2C_HANDLE_T *ptHandle, int iCond, unsign
 				}
 				ulValue |= (ulChunkTransaction-1U) << HOSTSRT(i2c_cmd_tsize);
 				ulValue |= 0 << HOSTSRT(i2c_cmd_acpollmax);
-				ptI2cUnit->ulI2c_cmd = ulValue;
+				i2c_reg_write(&ptI2cUnit->ulI2c_cmd, ulValue);
 
 				/* Loop over all requested bytes. */
 				do
 				{
-					ulChunkFifo   = ptI2cUnit->ulI2c_sr;
+					ulChunkFifo   = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
 					ulChunkFifo  &= HOSTMSK(i2c_sr_mfifo_level);
 					ulChunkFifo >>= HOSTSRT(i2c_sr_mfifo_level);
 
@@ -352,20 +664,42 @@ static int i2c_core_hsoc_v2_recv(const I2C_HANDLE_T *ptHandle, int iCond, unsign
 					{
 						ulChunkFifo = ulChunkTransaction;
 					}
+					else if( ulChunkFifo==0 )
+					{
+						if( ptHandle->fnIdle!=NULL )
+						{
+							ptHandle->fnIdle(ptHandle->pvIdleUser);
+						}
+						if( systime_handle_is_elapsed(&tTimer)!=0 )
+						{
+							/* No data arrives. */
+							iResult = i2c_timeout_handle(ptHandle);
+							break;
+						}
+					}
 					ulChunkTransaction -= ulChunkFifo;
 
+					ptHandle->ulBytesTransferred += ulChunkFifo;
 					while( ulChunkFifo!=0 )
 					{
-						ulValue = ptI2cUnit->ulI2c_mdr;
-						*(pucData++) = (unsigned char)ulValue;
+						ulValue = i2c_reg_read(&ptI2cUnit->ulI2c_mdr);
+						if( pucData!=NULL )
+						{
+							*(pucData++) = (unsigned char)ulValue;
+						}
+						i2c_capture(ptHandle, I2C_CAPTURE_EVENT_DataRead, (unsigned int)ulValue);
 						--ulChunkFifo;
 					}
 				} while( ulChunkTransaction!=0 );
+				if( iResult!=0 )
+				{
+					break;
+				}
 
-				iResult = i2c_wait_for_command_done(ptHandle);
+				iResult = i2c_wait_for_command_done(ptHandle, &tTimer);
 				if( iResult!=0 )
 				{
-					uprintf("Failed to execute the start command.\n");
+					uprintf("Failed to execute the transfer command.\n");
 					break;
 				}
 			}
@@ -374,18 +708,69 @@ static int i2c_core_hsoc_v2_recv(const I2C_HANDLE_T *ptHandle, int iCond, unsign
 		/* Send a stop condition? */
 		if( iResult==0 && (iCond&I2C_STOP_COND)!=0 )
 		{
-			/* Execute stop condition. */
-			ulValue  = 1 << HOSTSRT(i2c_cmd_nwr);
-			ulValue |= I2CCMD_STOP << HOSTSRT(i2c_cmd_cmd);
-			ulValue |= 0 << HOSTSRT(i2c_cmd_tsize);
-			ulValue |= 0 << HOSTSRT(i2c_cmd_acpollmax);
-			ptI2cUnit->ulI2c_cmd = ulValue;
-
-			iResult = i2c_wait_for_command_done(ptHandle);
-			if( iResult!=0 )
-			{
-				uprintf("Failed to execute the start command.\n");
-			}
+			iResult = i2c_core_hsoc_v2_stop(ptHandle);
+		}
+	}
+
+	return iResult;
+}
+
+
+
+int i2c_core_hsoc_v2_probe(I2C_HANDLE_T *ptHandle, unsigned int uiAddress, unsigned int uiAckPoll)
+{
+	unsigned long ulAddress;
+	unsigned long ulValue;
+	int iResult;
+	TIMER_HANDLE_T tTimer;
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	ptI2cUnit = ptHandle->ptI2cUnit;
+
+	/* Limit ACK poll to valid range. */
+	if( uiAckPoll>I2C_CORE_HSOC_V2_ACKPOLL_MAX )
+	{
+		uiAckPoll = I2C_CORE_HSOC_V2_ACKPOLL_MAX;
+	}
+
+	ulAddress   = (unsigned long)(uiAddress & 0x7fU);
+	ulAddress <<= HOSTSRT(i2c_mcr_sadr);
+	ulAddress  &= HOSTMSK(i2c_mcr_sadr);
+
+	ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_mcr);
+	ulValue &= ~HOSTMSK(i2c_mcr_sadr);
+	ulValue |= ulAddress;
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulValue);
+
+	/* Generate the start condition and the address in write mode. */
+	i2c_capture(ptHandle, I2C_CAPTURE_EVENT_Start, (uiAddress & 0x7fU) << 1U);
+	i2c_timeout_start(ptHandle, &tTimer, uiAckPoll + 1U);
+	ulValue  = 0 << HOSTSRT(i2c_cmd_nwr);
+	ulValue |= I2CCMD_S_AC << HOSTSRT(i2c_cmd_cmd);
+	ulValue |= uiAckPoll << HOSTSRT(i2c_cmd_acpollmax);
+	i2c_reg_write(&ptI2cUnit->ulI2c_cmd, ulValue);
+
+	iResult = i2c_wait_for_command_done(ptHandle, &tTimer);
+	if( iResult==0 )
+	{
+		/* Was the address acknowledged? */
+		ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
+		ulValue &= HOSTMSK(i2c_sr_last_ac);
+		if( ulValue==0 )
+		{
+			i2c_capture(ptHandle, I2C_CAPTURE_EVENT_AddressNak, 0);
+			iResult = I2C_RESULT_NakAddress;
+		}
+		else
+		{
+			i2c_capture(ptHandle, I2C_CAPTURE_EVENT_AddressAck, 0);
+		}
+
+		/* Release the bus in both cases. */
+		if( i2c_core_hsoc_v2_stop(ptHandle)!=0 )
+		{
+			iResult = I2C_RESULT_Timeout;
 		}
 	}
 
@@ -394,7 +779,7 @@ static int i2c_core_hsoc_v2_recv(const I2C_HANDLE_T *ptHandle, int iCond, unsign
 
 
 
-static int i2c_core_hsoc_v2_set_device_specific_speed(const I2C_HANDLE_T *ptHandle, unsigned long ulDeviceSpecificValue)
+int i2c_core_hsoc_v2_set_device_specific_speed(I2C_HANDLE_T *ptHandle, unsigned long ulDeviceSpecificValue)
 {
 	int iResult;
 	unsigned long ulValue;
@@ -403,16 +788,16 @@ static int i2c_core_hsoc_v2_set_device_specific_speed(const I2C_HANDLE_T *ptHand
 
 	ptI2cUnit = ptHandle->ptI2cUnit;
 
-	if( ulDeviceSpecificValue>(HOSTMSK(i2c_mcr_mode)>>HOSTSRT(i2c_mcr_mode)) )
+	if( ulDeviceSpecificValue>I2C_CORE_HSOC_V2_MODE_MAX )
 	{
 		iResult = -1;
 	}
 	else
 	{
-		ulValue  = ptI2cUnit->ulI2c_mcr;
+		ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_mcr);
 		ulValue &= ~HOSTMSK(i2c_mcr_mode);
 		ulValue |= ulDeviceSpecificValue << HOSTSRT(i2c_mcr_mode);
-		ptI2cUnit->ulI2c_mcr = ulValue;
+		i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulValue);
 
 		iResult = 0;
 	}
@@ -422,6 +807,20 @@ static int i2c_core_hsoc_v2_set_device_specific_speed(const I2C_HANDLE_T *ptHand
 
 
 
+unsigned long i2c_core_hsoc_v2_get_device_specific_speed(I2C_HANDLE_T *ptHandle)
+{
+	unsigned long ulValue;
+
+
+	ulValue   = i2c_reg_read(&ptHandle->ptI2cUnit->ulI2c_mcr);
+	ulValue  &= HOSTMSK(i2c_mcr_mode);
+	ulValue >>= HOSTSRT(i2c_mcr_mode);
+
+	return ulValue;
+}
+
+
+
 static void mmio_apply(const unsigned char *pucMmioIndex, const unsigned char *pucMmioFunction, unsigned int sizPins)
 {
 	HOSTDEF(ptAsicCtrlArea);
@@ -449,11 +848,77 @@ static void mmio_apply(const unsigned char *pucMmioIndex, const unsigned char *p
 static const I2C_FUNCTIONS_T i2c_core_functions =
 {
 	.fnSend                     = i2c_core_hsoc_v2_send,
+	.fnSendStream               = i2c_core_hsoc_v2_send_stream,
 	.fnRecv                     = i2c_core_hsoc_v2_recv,
+	.fnProbe                    = i2c_core_hsoc_v2_probe,
 	.fnSetDeviceSpecificSpeed   = i2c_core_hsoc_v2_set_device_specific_speed
 };
 
 
+/* Reset the unit and set up the handle for it. This does not touch the
+ * pins, so the host build can use it with a simulated unit.
+ */
+void i2c_core_hsoc_v2_init_unit(I2C_HANDLE_T *ptHandle, HOSTADEF(I2C) *ptI2cUnit, unsigned long ulClockStretchMs)
+{
+	unsigned long ulValue;
+
+
+	/* Reset the unit. */
+	ulValue = HOSTMSK(i2c_mcr_rst_i2c);
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulValue);
+
+	/* Disable the unit. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, 0);
+	/* Disable slave mode. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_scr, 0);
+
+	/* Clear the master FIFO. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_mfifo_cr, HOSTMSK(i2c_mfifo_cr_mfifo_clr));
+	i2c_reg_write(&ptI2cUnit->ulI2c_mfifo_cr, 0);
+	/* Clear the slave FIFO. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, HOSTMSK(i2c_sfifo_cr_sfifo_clr));
+	i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, 0);
+
+	/* Do not use IRQs. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_irqmsk, 0);
+	ulValue  = HOSTMSK(i2c_irqsr_sreq);
+	ulValue |= HOSTMSK(i2c_irqsr_sfifo_req);
+	ulValue |= HOSTMSK(i2c_irqsr_mfifo_req);
+	ulValue |= HOSTMSK(i2c_irqsr_bus_busy);
+	ulValue |= HOSTMSK(i2c_irqsr_fifo_err);
+	ulValue |= HOSTMSK(i2c_irqsr_cmd_err);
+	ulValue |= HOSTMSK(i2c_irqsr_cmd_ok);
+	i2c_reg_write(&ptI2cUnit->ulI2c_irqsr, ulValue);
+
+	/* Do not use DMAs. */
+	i2c_reg_write(&ptI2cUnit->ulI2c_dmacr, 0);
+
+	/* Clear the timeout state. */
+	ulValue  = HOSTMSK(i2c_sr_timeout);
+	i2c_reg_write(&ptI2cUnit->ulI2c_sr, ulValue);
+
+	/* Enable I2C core, and set the speed to 100KHz. */
+	ulValue  = HOSTMSK(i2c_mcr_en_timeout);
+	ulValue |= I2CSPEED_100 << HOSTSRT(i2c_mcr_mode);
+	ulValue |= HOSTMSK(i2c_mcr_en_i2c);
+	i2c_reg_write(&ptI2cUnit->ulI2c_mcr, ulValue);
+
+	memcpy(&(ptHandle->tI2CFn), &i2c_core_functions, sizeof(I2C_FUNCTIONS_T));
+	ptHandle->ptI2cUnit = ptI2cUnit;
+	ptHandle->ulClockStretchMs = ulClockStretchMs;
+	ptHandle->ulBytesTransferred = 0;
+	ptHandle->fnIdle = NULL;
+	ptHandle->pvIdleUser = NULL;
+	ptHandle->ptSlaveRegFile = NULL;
+	ptHandle->ulSlaveNwr = 0;
+	ptHandle->ptCapture = NULL;
+
+	/* The channels of the multiplexers are not known yet. */
+	i2c_core_hsoc_v2_mux_cache_clear(ptHandle);
+}
+
+
+
 int i2c_core_hsoc_v2_init(I2C_SETUP_T *ptI2CSetup, I2C_HANDLE_T *ptHandle)
 {
 	HOSTDEF(ptRAPI2C0Area);
@@ -465,7 +930,6 @@ int i2c_core_hsoc_v2_init(I2C_SETUP_T *ptI2CSetup, I2C_HANDLE_T *ptHandle)
 	HOSTDEF(ptI2c0Area);
 	HOSTDEF(ptI2c1Area);
 	HOSTDEF(ptI2c2Area);
-	unsigned long ulValue;
 	HOSTADEF(I2C) * ptI2cUnit;
 	const unsigned char *pucMmioFunctions;
 	int iResult;
@@ -534,56 +998,153 @@ int i2c_core_hsoc_v2_init(I2C_SETUP_T *ptI2CSetup, I2C_HANDLE_T *ptHandle)
 			mmio_apply(ptI2CSetup->aucMmioIndex, pucMmioFunctions, 2);
 		}
 
-		/* Reset the unit. */
-		ulValue = HOSTMSK(i2c_mcr_rst_i2c);
-		ptI2cUnit->ulI2c_mcr = ulValue;
+		i2c_core_hsoc_v2_init_unit(ptHandle, ptI2cUnit, ptI2CSetup->ulClockStretchMs);
 
-		/* Disable the unit. */
-		ptI2cUnit->ulI2c_mcr = 0;
-		/* Disable slave mode. */
-		ptI2cUnit->ulI2c_scr = 0;
+		iResult = 0;
+	}
+
+	/* return the pointer to the functions */
+	return iResult;
+}
+
+
+
+/* Enable the slave mode with the address "uiAddress". All accesses are
+ * served from the register file. The slave FIFO must be serviced with
+ * i2c_core_hsoc_v2_slave_service, which is usually called as the idle
+ * function of a master handle.
+ */
+int i2c_core_hsoc_v2_slave_enable(I2C_HANDLE_T *ptHandle, unsigned int uiAddress, I2C_REGFILE_T *ptRegFile)
+{
+	unsigned long ulValue;
+	int iResult;
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	if( uiAddress>0x7fU || ptRegFile==NULL )
+	{
+		iResult = -1;
+	}
+	else
+	{
+		ptI2cUnit = ptHandle->ptI2cUnit;
+
+		ptHandle->ptSlaveRegFile = ptRegFile;
+		ptHandle->ulSlaveNwr = 0;
 
-		/* Clear the master FIFO. */
-		ptI2cUnit->ulI2c_mfifo_cr = HOSTMSK(i2c_mfifo_cr_mfifo_clr);
-		ptI2cUnit->ulI2c_mfifo_cr = 0;
 		/* Clear the slave FIFO. */
-		ptI2cUnit->ulI2c_sfifo_cr = HOSTMSK(i2c_sfifo_cr_sfifo_clr);
-		ptI2cUnit->ulI2c_sfifo_cr = 0;
+		i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, HOSTMSK(i2c_sfifo_cr_sfifo_clr));
+		i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, 0);
 
-		/* Do not use IRQs. */
-		ptI2cUnit->ulI2c_irqmsk = 0;
+		/* Clear a pending slave request. */
 		ulValue  = HOSTMSK(i2c_irqsr_sreq);
 		ulValue |= HOSTMSK(i2c_irqsr_sfifo_req);
-		ulValue |= HOSTMSK(i2c_irqsr_mfifo_req);
-		ulValue |= HOSTMSK(i2c_irqsr_bus_busy);
-		ulValue |= HOSTMSK(i2c_irqsr_fifo_err);
-		ulValue |= HOSTMSK(i2c_irqsr_cmd_err);
-		ulValue |= HOSTMSK(i2c_irqsr_cmd_ok);
-		ptI2cUnit->ulI2c_irqsr = ulValue;
+		i2c_reg_write(&ptI2cUnit->ulI2c_irqsr, ulValue);
 
-		/* Do not use DMAs. */
-		ptI2cUnit->ulI2c_dmacr = 0;
+		/* Acknowledge all accesses to the address and received data
+		 * as long as the FIFO is not full.
+		 */
+		ulValue  = (uiAddress << HOSTSRT(i2c_scr_sid)) & HOSTMSK(i2c_scr_sid);
+		ulValue |= HOSTMSK(i2c_scr_ac_srx);
+		ulValue |= HOSTMSK(i2c_scr_ac_start);
+		i2c_reg_write(&ptI2cUnit->ulI2c_scr, ulValue);
 
-		/* Clear the timeout state. */
-		ulValue  = HOSTMSK(i2c_sr_timeout);
-		ptI2cUnit->ulI2c_sr = ulValue;
+		iResult = 0;
+	}
 
-		/* Enable I2C core, and set the speed to 100KHz. */
-		ulValue  = HOSTMSK(i2c_mcr_en_timeout);
-		ulValue |= I2CSPEED_100 << HOSTSRT(i2c_mcr_mode);
-		ulValue |= HOSTMSK(i2c_mcr_en_i2c);
-		ptI2cUnit->ulI2c_mcr = ulValue;
+	return iResult;
+}
 
-		memcpy(&(ptHandle->tI2CFn), &i2c_core_functions, sizeof(I2C_FUNCTIONS_T));
-		ptHandle->ptI2cUnit = ptI2cUnit;
 
-		iResult = 0;
+
+void i2c_core_hsoc_v2_slave_disable(I2C_HANDLE_T *ptHandle)
+{
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	ptI2cUnit = ptHandle->ptI2cUnit;
+
+	i2c_reg_write(&ptI2cUnit->ulI2c_scr, 0);
+	i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, HOSTMSK(i2c_sfifo_cr_sfifo_clr));
+	i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, 0);
+
+	ptHandle->ptSlaveRegFile = NULL;
+}
+
+
+
+void i2c_core_hsoc_v2_slave_service(void *pvHandle)
+{
+	I2C_HANDLE_T *ptHandle;
+	I2C_REGFILE_T *ptRegFile;
+	unsigned long ulValue;
+	unsigned long ulLevel;
+	HOSTADEF(I2C) * ptI2cUnit;
+
+
+	ptHandle = (I2C_HANDLE_T*)pvHandle;
+	ptRegFile = ptHandle->ptSlaveRegFile;
+	ptI2cUnit = ptHandle->ptI2cUnit;
+
+	ulLevel   = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
+	ulLevel  &= HOSTMSK(i2c_sr_sfifo_level);
+	ulLevel >>= HOSTSRT(i2c_sr_sfifo_level);
+
+	/* Was the slave addressed? */
+	ulValue = i2c_reg_read(&ptI2cUnit->ulI2c_irqsr);
+	if( (ulValue&HOSTMSK(i2c_irqsr_sreq))!=0 )
+	{
+		if( ptHandle->ulSlaveNwr!=0 )
+		{
+			/* The last access was a read. The master did not fetch the
+			 * rest of the FIFO.
+			 */
+			i2c_regfile_unread(ptRegFile, ulLevel);
+			i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, HOSTMSK(i2c_sfifo_cr_sfifo_clr));
+			i2c_reg_write(&ptI2cUnit->ulI2c_sfifo_cr, 0);
+			ulLevel = 0;
+		}
+		else
+		{
+			/* Get the rest of the last write access first. */
+			while( ulLevel!=0 )
+			{
+				i2c_regfile_write(ptRegFile, (unsigned char)(i2c_reg_read(&ptI2cUnit->ulI2c_sdr)));
+				--ulLevel;
+			}
+		}
+
+		ulValue  = i2c_reg_read(&ptI2cUnit->ulI2c_sr);
+		ulValue &= HOSTMSK(i2c_sr_nwr);
+		ptHandle->ulSlaveNwr = ulValue;
+		if( ulValue==0 )
+		{
+			i2c_regfile_start_write(ptRegFile);
+		}
+
+		i2c_reg_write(&ptI2cUnit->ulI2c_irqsr, HOSTMSK(i2c_irqsr_sreq));
 	}
 
-	/* return the pointer to the functions */
-	return iResult;
+	if( ptHandle->ulSlaveNwr==0 )
+	{
+		/* The master writes. Move all received bytes to the register file. */
+		while( ulLevel!=0 )
+		{
+			i2c_regfile_write(ptRegFile, (unsigned char)(i2c_reg_read(&ptI2cUnit->ulI2c_sdr)));
+			--ulLevel;
+		}
+	}
+	else
+	{
+		/* The master reads. Keep the FIFO filled. */
+		while( ulLevel<I2C_CORE_HSOC_V2_FIFO_DEPTH )
+		{
+			i2c_reg_write(&ptI2cUnit->ulI2c_sdr, i2c_regfile_read(ptRegFile));
+			++ulLevel;
+		}
+	}
+	i2c_reg_write(&ptI2cUnit->ulI2c_irqsr, HOSTMSK(i2c_irqsr_sfifo_req));
 }
 
 
 /*-----------------------------------*/
-
@@ -1,4 +1,6 @@
 #include "i2c_interface.h"
+#include "i2c_regfile.h"
+#include "tcm.h"
 
 
 #ifndef __I2C_CORE_HSOC_V2_H__
@@ -20,6 +22,47 @@ typedef enum I2C_SETUP_CORE_ENUM
 
 
 
+/* These are the commands of the i2c_cmd register. */
+typedef enum I2CCMD_ENUM
+{
+	I2CCMD_START    = 0,    /* Generate (r)START-condition. */
+	I2CCMD_S_AC     = 1,    /* Acknowledge-polling: generate up to acpollmax+1 START-sequences (until acknowledged by slave). */
+	I2CCMD_S_AC_T   = 2,    /* Run S_AC, then transfer tsize+1 bytes from/to master FIFO. Not to be continued. */
+	I2CCMD_S_AC_TC  = 3,    /* Run S_AC, then transfer tsize+1 bytes from/to master FIFO. To be continued. */
+	I2CCMD_CT       = 4,    /* Continued transfer not to be continued. */
+	I2CCMD_CTC      = 5,    /* Continued transfer to be continued. */
+	I2CCMD_STOP     = 6,    /* Generate STOP-condition. */
+	I2CCMD_IDLE     = 7     /* Nothing to do, last command finished, break current command. */
+} I2CCMD_T;
+
+
+
+/* The master and slave FIFOs have 16 entries. */
+#define I2C_CORE_HSOC_V2_FIFO_DEPTH 16U
+
+/* These are the limits of the register fields. They are constants, so the
+ * compiler folds them into the compare.
+ */
+#define I2C_CORE_HSOC_V2_ACKPOLL_MAX (HOSTMSK(i2c_cmd_acpollmax) >> HOSTSRT(i2c_cmd_acpollmax))
+#define I2C_CORE_HSOC_V2_TRANSFER_SIZE_MAX ((HOSTMSK(i2c_cmd_tsize) >> HOSTSRT(i2c_cmd_tsize)) + 1U)
+#define I2C_CORE_HSOC_V2_MODE_MAX (HOSTMSK(i2c_mcr_mode) >> HOSTSRT(i2c_mcr_mode))
+
+
+
+typedef enum I2CSPEED_ENUM
+{
+	I2CSPEED_50     = 0,    /* Fast/Standard-mode, 50kbit/s */
+	I2CSPEED_100    = 1,    /* Fast/Standard-mode, 100kbit/s */
+	I2CSPEED_200    = 2,    /* Fast/Standard-mode, 200kbit/s */
+	I2CSPEED_400    = 3,    /* Fast/Standard-mode, 400kbit/s */
+	I2CSPEED_800    = 4,    /* Fast/Standard-mode, 800kbit/s */
+	I2CSPEED_1200   = 5,    /* Fast/Standard-mode, 1.2Mbit/s */
+	I2CSPEED_1700   = 6,    /* High-speed-mode, 1.7Mbit/s */
+	I2CSPEED_3400   = 7     /* High-speed-mode, 3.4Mbit/s */
+} I2CSPEED_T;
+
+
+
 /* This enum defines the order of the pins in the aucMmioIndex and
  * ausPortControl arrays of the I2C_SETUP_T structure.
  */
@@ -36,10 +79,25 @@ typedef struct I2C_SETUP_STRUCT
 	I2C_SETUP_CORE_T tI2CCore;
 	unsigned char aucMmioIndex[2];
 	unsigned short ausPortControl[2];
+	unsigned long ulClockStretchMs;
 } I2C_SETUP_T;
 
 
+void i2c_core_hsoc_v2_init_unit(I2C_HANDLE_T *ptHandle, HOSTADEF(I2C) *ptI2cUnit, unsigned long ulClockStretchMs);
 int i2c_core_hsoc_v2_init(I2C_SETUP_T *ptI2CSetup, I2C_HANDLE_T *ptHandle);
+/* The sequence interpreter in the ITCM calls these directly with
+ * CFG_DIRECT_DISPATCH=1.
+ */
+int TCM_SHORT_CALL i2c_core_hsoc_v2_send(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, const unsigned char *pucData);
+int TCM_SHORT_CALL i2c_core_hsoc_v2_send_stream(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, PFN_I2C_GET_BYTE_T fnGetByte, void *pvUser);
+int TCM_SHORT_CALL i2c_core_hsoc_v2_recv(I2C_HANDLE_T *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, unsigned char *pucData);
+int i2c_core_hsoc_v2_probe(I2C_HANDLE_T *ptHandle, unsigned int uiAddress, unsigned int uiAckPoll);
+int i2c_core_hsoc_v2_set_device_specific_speed(I2C_HANDLE_T *ptHandle, unsigned long ulDeviceSpecificValue);
+unsigned long i2c_core_hsoc_v2_get_device_specific_speed(I2C_HANDLE_T *ptHandle);
+void i2c_core_hsoc_v2_mux_cache_clear(I2C_HANDLE_T *ptHandle);
+int i2c_core_hsoc_v2_slave_enable(I2C_HANDLE_T *ptHandle, unsigned int uiAddress, I2C_REGFILE_T *ptRegFile);
+void i2c_core_hsoc_v2_slave_disable(I2C_HANDLE_T *ptHandle);
+void i2c_core_hsoc_v2_slave_service(void *pvHandle);
 
 #endif  /* __I2C_CORE_HSOC_V2_H__ */
 
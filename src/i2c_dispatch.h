@@ -0,0 +1,33 @@
+#ifndef __I2C_DISPATCH_H__
+#define __I2C_DISPATCH_H__
+
+#include "i2c_core_hsoc_v2.h"
+
+
+/* The sequence interpreter calls the driver through these macros. A build
+ * with CFG_DIRECT_DISPATCH=1 calls the functions of the hsoc v2 core
+ * directly. This saves the load of the function pointer from the handle and
+ * the indirect branch for every transfer. It is possible because the
+ * netX4000 has only this core family. The default build uses the function
+ * pointers in the handle like before.
+ */
+#ifndef CFG_DIRECT_DISPATCH
+#       define CFG_DIRECT_DISPATCH 0
+#endif
+
+#if CFG_DIRECT_DISPATCH!=0
+#       define I2C_SEND(ptHandle, iCond, uiAckPoll, uiDataLength, pucData) i2c_core_hsoc_v2_send(ptHandle, iCond, uiAckPoll, uiDataLength, pucData)
+#       define I2C_SEND_STREAM(ptHandle, iCond, uiAckPoll, uiDataLength, fnGetByte, pvUser) i2c_core_hsoc_v2_send_stream(ptHandle, iCond, uiAckPoll, uiDataLength, fnGetByte, pvUser)
+#       define I2C_RECV(ptHandle, iCond, uiAckPoll, uiDataLength, pucData) i2c_core_hsoc_v2_recv(ptHandle, iCond, uiAckPoll, uiDataLength, pucData)
+#       define I2C_PROBE(ptHandle, uiAddress, uiAckPoll) i2c_core_hsoc_v2_probe(ptHandle, uiAddress, uiAckPoll)
+#       define I2C_SET_DEVICE_SPECIFIC_SPEED(ptHandle, ulDeviceSpecificValue) i2c_core_hsoc_v2_set_device_specific_speed(ptHandle, ulDeviceSpecificValue)
+#else
+#       define I2C_SEND(ptHandle, iCond, uiAckPoll, uiDataLength, pucData) (ptHandle)->tI2CFn.fnSend(ptHandle, iCond, uiAckPoll, uiDataLength, pucData)
+#       define I2C_SEND_STREAM(ptHandle, iCond, uiAckPoll, uiDataLength, fnGetByte, pvUser) (ptHandle)->tI2CFn.fnSendStream(ptHandle, iCond, uiAckPoll, uiDataLength, fnGetByte, pvUser)
+#       define I2C_RECV(ptHandle, iCond, uiAckPoll, uiDataLength, pucData) (ptHandle)->tI2CFn.fnRecv(ptHandle, iCond, uiAckPoll, uiDataLength, pucData)
+#       define I2C_PROBE(ptHandle, uiAddress, uiAckPoll) (ptHandle)->tI2CFn.fnProbe(ptHandle, uiAddress, uiAckPoll)
+#       define I2C_SET_DEVICE_SPECIFIC_SPEED(ptHandle, ulDeviceSpecificValue) (ptHandle)->tI2CFn.fnSetDeviceSpecificSpeed(ptHandle, ulDeviceSpecificValue)
+#endif
+
+
+#endif  /* __I2C_DISPATCH_H__ */
@@ -15,17 +15,54 @@ typedef enum
 
 
 
+/* All driver functions return one of these values. */
+typedef enum I2C_RESULT_ENUM
+{
+	I2C_RESULT_Ok = 0,
+	I2C_RESULT_InvalidParameter = 1,
+	I2C_RESULT_NakAddress = 2,
+	I2C_RESULT_NakData = 3,
+	I2C_RESULT_Timeout = 4
+} I2C_RESULT_T;
+
+
+
 struct I2C_HANDLE_STRUCT;
+struct I2C_REGFILE_STRUCT;
+struct I2C_CAPTURE_STRUCT;
 
-typedef int (*PFN_I2C_SEND_T)(const struct I2C_HANDLE_STRUCT *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, const unsigned char *pucData);
-typedef int (*PFN_I2C_RECV_T)(const struct I2C_HANDLE_STRUCT *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, unsigned char *pucData);
+typedef int (*PFN_I2C_SEND_T)(struct I2C_HANDLE_STRUCT *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, const unsigned char *pucData);
+/* Get the next byte of a data stream which is sent with fnSendStream. */
+typedef unsigned char (*PFN_I2C_GET_BYTE_T)(void *pvUser);
+typedef int (*PFN_I2C_SEND_STREAM_T)(struct I2C_HANDLE_STRUCT *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, PFN_I2C_GET_BYTE_T fnGetByte, void *pvUser);
+/* Receive data. The data is dropped if pucData is NULL. */
+typedef int (*PFN_I2C_RECV_T)(struct I2C_HANDLE_STRUCT *ptHandle, int iCond, unsigned int uiAckPoll, unsigned int uiDataLength, unsigned char *pucData);
+/* Probe for a device with a START condition and the address. The result is I2C_RESULT_Ok if the device acknowledged the address and I2C_RESULT_NakAddress if not. */
+typedef int (*PFN_I2C_PROBE_T)(struct I2C_HANDLE_STRUCT *ptHandle, unsigned int uiAddress, unsigned int uiAckPoll);
 /* TODO: Add a function to convert a clock speed in kHz to a device specific value. */
-typedef int (*PFN_I2C_SET_DEVICE_SPECIFIC_SPEED_T)(const struct I2C_HANDLE_STRUCT *ptHandle, unsigned long ulDeviceSpecificValue);
+typedef int (*PFN_I2C_SET_DEVICE_SPECIFIC_SPEED_T)(struct I2C_HANDLE_STRUCT *ptHandle, unsigned long ulDeviceSpecificValue);
+
+/* The number of multiplexers in the channel cache of a handle. */
+#define I2C_MUX_CACHE_SIZE 4
+
+/* The last channel selection which was written to a multiplexer. An unused
+ * entry has the address 0xff.
+ */
+typedef struct I2C_MUX_CACHE_STRUCT
+{
+	unsigned char ucAddress;
+	unsigned char ucChannels;
+} I2C_MUX_CACHE_T;
+
+/* This function is called while the driver waits for the hardware. */
+typedef void (*PFN_I2C_IDLE_T)(void *pvUser);
 
 typedef struct I2C_FUNCTIONS_STRUCT
 {
 	PFN_I2C_SEND_T fnSend;
+	PFN_I2C_SEND_STREAM_T fnSendStream;
 	PFN_I2C_RECV_T fnRecv;
+	PFN_I2C_PROBE_T fnProbe;
 	PFN_I2C_SET_DEVICE_SPECIFIC_SPEED_T fnSetDeviceSpecificSpeed;
 } I2C_FUNCTIONS_T;
 
@@ -33,6 +70,14 @@ typedef struct I2C_HANDLE_STRUCT
 {
 	I2C_FUNCTIONS_T tI2CFn;
 	HOSTADEF(I2C) * ptI2cUnit;
+	unsigned long ulClockStretchMs;    /* Allowance for clock stretching in the timeout of each command. */
+	unsigned long ulBytesTransferred;  /* Number of data bytes transferred by the last send or receive call. */
+	PFN_I2C_IDLE_T fnIdle;             /* Optional, set to NULL if not used. */
+	void *pvIdleUser;
+	struct I2C_REGFILE_STRUCT *ptSlaveRegFile;  /* The register file in slave mode or NULL. */
+	unsigned long ulSlaveNwr;          /* The direction of the current slave access. */
+	struct I2C_CAPTURE_STRUCT *ptCapture;  /* Log all bus events to this ring or NULL. */
+	I2C_MUX_CACHE_T atMuxCache[I2C_MUX_CACHE_SIZE];  /* The selected channels of the multiplexers on the bus. */
 } I2C_HANDLE_T;
 
 #endif  /* __I2C_INTERFACE_H__ */
@@ -0,0 +1,72 @@
+#include "i2c_regfile.h"
+
+
+void i2c_regfile_init(I2C_REGFILE_T *ptRegFile, unsigned char *pucData, unsigned int sizData)
+{
+	ptRegFile->pucData = pucData;
+	ptRegFile->sizData = sizData;
+	ptRegFile->uiPointer = 0;
+	ptRegFile->iPointerPending = 0;
+}
+
+
+
+/* A new write access started. The next byte is the register pointer. */
+void i2c_regfile_start_write(I2C_REGFILE_T *ptRegFile)
+{
+	ptRegFile->iPointerPending = 1;
+}
+
+
+
+void i2c_regfile_write(I2C_REGFILE_T *ptRegFile, unsigned char ucData)
+{
+	if( ptRegFile->iPointerPending!=0 )
+	{
+		ptRegFile->uiPointer = ucData;
+		ptRegFile->iPointerPending = 0;
+	}
+	else
+	{
+		ptRegFile->pucData[ptRegFile->uiPointer] = ucData;
+		++ptRegFile->uiPointer;
+	}
+
+	if( ptRegFile->uiPointer>=ptRegFile->sizData )
+	{
+		ptRegFile->uiPointer = 0;
+	}
+}
+
+
+
+unsigned char i2c_regfile_read(I2C_REGFILE_T *ptRegFile)
+{
+	unsigned char ucData;
+
+
+	ucData = ptRegFile->pucData[ptRegFile->uiPointer];
+	++ptRegFile->uiPointer;
+	if( ptRegFile->uiPointer>=ptRegFile->sizData )
+	{
+		ptRegFile->uiPointer = 0;
+	}
+
+	return ucData;
+}
+
+
+
+/* Move the register pointer back by "sizData" bytes. This is necessary if
+ * data was read in advance to fill a FIFO, but the master stopped the
+ * transfer before it fetched the data.
+ */
+void i2c_regfile_unread(I2C_REGFILE_T *ptRegFile, unsigned int sizData)
+{
+	sizData %= ptRegFile->sizData;
+	if( sizData>ptRegFile->uiPointer )
+	{
+		ptRegFile->uiPointer += ptRegFile->sizData;
+	}
+	ptRegFile->uiPointer -= sizData;
+}
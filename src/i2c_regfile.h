@@ -0,0 +1,33 @@
+
+#ifndef __I2C_REGFILE_H__
+#define __I2C_REGFILE_H__
+
+
+/* This is a memory backed register file for the slave mode. It behaves like
+ * a simple I2C memory with an 8 bit register pointer:
+ *
+ *   The first byte of a write access sets the register pointer. All
+ *   following bytes are written to the register file.
+ *   A read access returns the data from the current register pointer.
+ *
+ * The register pointer increments after each byte and wraps at the end of
+ * the register file. The routines do not access any hardware, so they can
+ * also be built for the host.
+ */
+typedef struct I2C_REGFILE_STRUCT
+{
+	unsigned char *pucData;
+	unsigned int sizData;
+	unsigned int uiPointer;
+	int iPointerPending;
+} I2C_REGFILE_T;
+
+
+void i2c_regfile_init(I2C_REGFILE_T *ptRegFile, unsigned char *pucData, unsigned int sizData);
+void i2c_regfile_start_write(I2C_REGFILE_T *ptRegFile);
+void i2c_regfile_write(I2C_REGFILE_T *ptRegFile, unsigned char ucData);
+unsigned char i2c_regfile_read(I2C_REGFILE_T *ptRegFile);
+void i2c_regfile_unread(I2C_REGFILE_T *ptRegFile, unsigned int sizData);
+
+
+#endif  /* __I2C_REGFILE_H__ */
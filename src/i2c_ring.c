@@ -0,0 +1,25 @@
+#include "i2c_ring.h"
+
+
+/* Create an empty ring in a buffer of "sizBuffer" bytes. The ring is the
+ * first member of a header with "sizHeader" bytes.
+ * The result is NULL if the buffer is too small for the header and
+ * "ulRecordsMin" records.
+ */
+I2C_RING_T *i2c_ring_init(void *pvBuffer, size_t sizBuffer, size_t sizHeader, size_t sizRecord, unsigned long ulRecordsMin)
+{
+	I2C_RING_T *ptRing;
+
+
+	ptRing = NULL;
+	if( pvBuffer!=NULL && sizBuffer>=sizHeader && ((sizBuffer - sizHeader) / sizRecord)>=ulRecordsMin )
+	{
+		ptRing = (I2C_RING_T*)pvBuffer;
+		ptRing->ulMaxRecords = (sizBuffer - sizHeader) / sizRecord;
+		ptRing->sizRecord = sizRecord;
+		ptRing->ulWriteIndex = 0;
+		ptRing->ulReadIndex = 0;
+	}
+
+	return ptRing;
+}
@@ -0,0 +1,46 @@
+#ifndef __I2C_RING_H__
+#define __I2C_RING_H__
+
+#include <stddef.h>
+
+
+/* A ring of records with a fixed size. It is the first member of the header
+ * of the capture ring and the sampler ring, so the host reads both in the
+ * same way.
+ * The records follow the complete header of the ring.
+ * The netX writes at "ulWriteIndex". A ring which the host drains while the
+ * netX is running also has a read index, which is written by the host. It
+ * is empty if both indices are equal. A ring which overwrites its oldest
+ * records does not use the read index.
+ */
+typedef struct I2C_RING_STRUCT
+{
+	unsigned long ulMaxRecords;
+	unsigned long sizRecord;
+	volatile unsigned long ulWriteIndex;
+	volatile unsigned long ulReadIndex;
+} I2C_RING_T;
+
+
+I2C_RING_T *i2c_ring_init(void *pvBuffer, size_t sizBuffer, size_t sizHeader, size_t sizRecord, unsigned long ulRecordsMin);
+
+
+static inline unsigned long i2c_ring_next_index(const I2C_RING_T *ptRing, unsigned long ulIndex)
+{
+	++ulIndex;
+	if( ulIndex>=ptRing->ulMaxRecords )
+	{
+		ulIndex = 0;
+	}
+
+	return ulIndex;
+}
+
+
+static inline void *i2c_ring_get_record(I2C_RING_T *ptRing, size_t sizHeader, unsigned long ulIndex)
+{
+	return (void*)((unsigned char*)ptRing + sizHeader + ulIndex*ptRing->sizRecord);
+}
+
+
+#endif  /* __I2C_RING_H__ */
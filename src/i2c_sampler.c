@@ -0,0 +1,62 @@
+#include "i2c_sampler.h"
+
+
+/* Create an empty sampler ring in the buffer for samples with up to
+ * "sizSample" bytes. The result is NULL if the buffer is too small for the
+ * header and at least 2 records.
+ */
+I2C_SAMPLER_T *i2c_sampler_init(void *pvBuffer, size_t sizBuffer, size_t sizSample)
+{
+	I2C_SAMPLER_T *ptSampler;
+	size_t sizRecord;
+
+
+	/* Keep all records 32 bit aligned. */
+	sizRecord = sizeof(I2C_SAMPLER_RECORD_T) + ((sizSample + 3U) & ~3U);
+	ptSampler = (I2C_SAMPLER_T*)i2c_ring_init(pvBuffer, sizBuffer, sizeof(I2C_SAMPLER_T), sizRecord, 2);
+	if( ptSampler!=NULL )
+	{
+		ptSampler->ulStopRequest = 0;
+		ptSampler->ulSamples = 0;
+		ptSampler->ulOverflows = 0;
+		ptSampler->ulErrors = 0;
+	}
+
+	return ptSampler;
+}
+
+
+
+/* Get the record at the write index. The result is NULL if the ring is full.
+ * The sample is counted as an overflow then.
+ */
+I2C_SAMPLER_RECORD_T *i2c_sampler_get_free(I2C_SAMPLER_T *ptSampler)
+{
+	I2C_SAMPLER_RECORD_T *ptRecord;
+	unsigned long ulWriteIndex;
+	unsigned long ulNextIndex;
+
+
+	ptRecord = NULL;
+
+	ulWriteIndex = ptSampler->tRing.ulWriteIndex;
+	ulNextIndex = i2c_ring_next_index(&(ptSampler->tRing), ulWriteIndex);
+	if( ulNextIndex==ptSampler->tRing.ulReadIndex )
+	{
+		++ptSampler->ulOverflows;
+	}
+	else
+	{
+		ptRecord = (I2C_SAMPLER_RECORD_T*)i2c_ring_get_record(&(ptSampler->tRing), sizeof(I2C_SAMPLER_T), ulWriteIndex);
+	}
+
+	return ptRecord;
+}
+
+
+
+/* Pass the record from i2c_sampler_get_free to the host. */
+void i2c_sampler_commit(I2C_SAMPLER_T *ptSampler)
+{
+	ptSampler->tRing.ulWriteIndex = i2c_ring_next_index(&(ptSampler->tRing), ptSampler->tRing.ulWriteIndex);
+}
@@ -0,0 +1,46 @@
+#ifndef __I2C_SAMPLER_H__
+#define __I2C_SAMPLER_H__
+
+#include <stddef.h>
+
+#include "i2c_ring.h"
+
+
+/* One sample in the sampler ring. The timestamp is the system time in ms
+ * when the sequence was started. The data has "usDataSize" bytes and is
+ * padded to a multiple of 4 bytes.
+ */
+typedef struct I2C_SAMPLER_RECORD_STRUCT
+{
+	unsigned long ulTimestampMs;
+	unsigned short usErrorClass;    /* One of I2C_SEQ_ERROR_T. */
+	unsigned short usDataSize;
+	unsigned char aucData[];
+} I2C_SAMPLER_RECORD_T;
+
+
+/* The sampler ring starts with this header. It is followed by "ulMaxRecords"
+ * records with "sizRecord" bytes each. The netX writes at "ulWriteIndex" and
+ * the host reads at "ulReadIndex" while the sampler is running. One record
+ * always stays free, so a full ring has "ulMaxRecords"-1 samples. A new
+ * sample is dropped if the ring is full.
+ * The host stops the sampler by writing a non-zero value to
+ * "ulStopRequest".
+ */
+typedef struct I2C_SAMPLER_STRUCT
+{
+	I2C_RING_T tRing;
+	volatile unsigned long ulStopRequest;
+	volatile unsigned long ulSamples;      /* The number of sequence runs. */
+	volatile unsigned long ulOverflows;    /* The number of dropped samples. */
+	volatile unsigned long ulErrors;       /* The number of failed sequence runs. */
+	unsigned char aucRecords[];
+} I2C_SAMPLER_T;
+
+
+I2C_SAMPLER_T *i2c_sampler_init(void *pvBuffer, size_t sizBuffer, size_t sizSample);
+I2C_SAMPLER_RECORD_T *i2c_sampler_get_free(I2C_SAMPLER_T *ptSampler);
+void i2c_sampler_commit(I2C_SAMPLER_T *ptSampler);
+
+
+#endif  /* __I2C_SAMPLER_H__ */
@@ -9,7 +9,13 @@ typedef enum I2C_CMD_ENUM
 {
 	I2C_CMD_Open = 0,
 	I2C_CMD_RunSequence = 1,
-	I2C_CMD_Close = 2
+	I2C_CMD_Close = 2,
+	I2C_CMD_Scan = 3,
+	I2C_CMD_Benchmark = 4,
+	I2C_CMD_Capture = 5,
+	I2C_CMD_Checksum = 6,
+	I2C_CMD_GetCapabilities = 7,
+	I2C_CMD_Sample = 8
 } I2C_CMD_T;
 
 
@@ -18,11 +24,106 @@ typedef enum I2C_SEQ_COMMAND_ENUM
 {
 	I2C_SEQ_COMMAND_Read = 0,
 	I2C_SEQ_COMMAND_Write = 1,
-	I2C_SEQ_COMMAND_Delay = 2
+	I2C_SEQ_COMMAND_Delay = 2,
+	I2C_SEQ_COMMAND_WriteRle = 3,
+	I2C_SEQ_COMMAND_AckPollPolicy = 4,
+	I2C_SEQ_COMMAND_WriteMulti = 5,
+	I2C_SEQ_COMMAND_Smbus = 6,
+	I2C_SEQ_COMMAND_Rmw = 7,
+	I2C_SEQ_COMMAND_ReadExt = 8,
+	I2C_SEQ_COMMAND_WriteExt = 9,
+	I2C_SEQ_COMMAND_ReadDelta = 10,
+	I2C_SEQ_COMMAND_ReadTo = 11,
+	I2C_SEQ_COMMAND_MuxSelect = 12
 } I2C_SEQ_COMMAND_T;
 
 
 
+/* The destination of the data of a ReadTo command. */
+typedef enum I2C_READ_DESTINATION_ENUM
+{
+	I2C_READ_DESTINATION_Append = 0,    /* Append the data to the received data like a Read command. */
+	I2C_READ_DESTINATION_Discard = 1,   /* Drop the data. */
+	I2C_READ_DESTINATION_Slot = 2       /* Write the data to an offset in the slot area. */
+} I2C_READ_DESTINATION_T;
+
+
+
+/* One entry of the offset table. There is one entry for each command
+ * which was executed. It points to the data of the command in the received
+ * data. Commands without data have a size of 0.
+ */
+typedef struct I2C_RESULT_OFFSET_STRUCT
+{
+	uint32_t ulOffset;
+	uint32_t ulSize;
+} I2C_RESULT_OFFSET_T;
+
+
+
+/* A ReadDelta command compares the received data with a snapshot of the
+ * previous read and stores only the changes. The result starts with one
+ * of these bytes. A bitmap has one bit for each byte of the read, bit
+ * (n&7) of byte (n>>3) is set if byte n changed. The full data is sent if
+ * the snapshot is not valid or if it is smaller than the changes.
+ */
+typedef enum I2C_READ_DELTA_ENUM
+{
+	I2C_READ_DELTA_Unchanged = 0,   /* Nothing follows. */
+	I2C_READ_DELTA_Changed = 1,     /* The bitmap and the changed bytes follow. */
+	I2C_READ_DELTA_Full = 2         /* All bytes follow. */
+} I2C_READ_DELTA_T;
+
+
+
+/* The limits of the firmware and of the parameter area layout. The Lua
+ * module reads them from the ELF file.
+ */
+typedef enum I2C_LIMITS_ENUM
+{
+	I2C_READ_DELTA_MAX = 1024,      /* The maximum size of one ReadDelta command. */
+	I2C_HANDLE_SLOTS = 2,           /* The number of handles in the parameter area. */
+	I2C_SNAPSHOT_AREA_SIZE = 4096   /* The size of the snapshot area of each handle. */
+} I2C_LIMITS_T;
+
+
+
+/* The options of the I2C_SEQ_COMMAND_MuxSelect command. The netX remembers
+ * the last channels written to a multiplexer in the handle and skips the
+ * write if they did not change. A write or a failed select to the address
+ * of the multiplexer clears the entry.
+ */
+typedef enum I2C_MUX_SELECT_FLAGS_ENUM
+{
+	I2C_MUX_SELECT_FLAGS_Force = 1    /* Always write the channels, e.g. after a reset of the multiplexer. */
+} I2C_MUX_SELECT_FLAGS_T;
+
+
+
+/* The SMBus transactions of the I2C_SEQ_COMMAND_Smbus command. The received
+ * data is stored in the bus order: low byte first for words. A block read
+ * stores the byte count and reserves space for the maximum block size.
+ */
+typedef enum I2C_SMBUS_PROTOCOL_ENUM
+{
+	I2C_SMBUS_PROTOCOL_ReadByte = 0,       /* Receives 1 byte. */
+	I2C_SMBUS_PROTOCOL_WriteByte = 1,      /* Sends 1 byte. */
+	I2C_SMBUS_PROTOCOL_ReadWord = 2,       /* Receives 2 bytes. */
+	I2C_SMBUS_PROTOCOL_WriteWord = 3,      /* Sends 2 bytes. */
+	I2C_SMBUS_PROTOCOL_BlockRead = 4,      /* Receives the count and up to the maximum bytes. */
+	I2C_SMBUS_PROTOCOL_BlockWrite = 5,     /* Sends the count and 1-255 bytes. */
+	I2C_SMBUS_PROTOCOL_ProcessCall = 6     /* Sends 2 bytes and receives 2 bytes. */
+} I2C_SMBUS_PROTOCOL_T;
+
+
+
+typedef enum I2C_SMBUS_FLAGS_ENUM
+{
+	I2C_SMBUS_FLAGS_Pec = 1    /* Send and check the packet error code. */
+} I2C_SMBUS_FLAGS_T;
+
+
+
 typedef enum I2C_SEQ_CONDITION_ENUM
 {
 	I2C_SEQ_CONDITION_None = 0,
@@ -33,6 +134,38 @@ typedef enum I2C_SEQ_CONDITION_ENUM
 
 
 
+/* The options of the I2C_SEQ_COMMAND_Rmw command. The register address is
+ * sent with the most significant byte first. The data is sent with the
+ * most significant byte first unless "DataLsbFirst" is set.
+ */
+typedef enum I2C_RMW_FLAGS_ENUM
+{
+	I2C_RMW_FLAGS_Register16 = 1,     /* The register address has 16 bits. */
+	I2C_RMW_FLAGS_Data16 = 2,         /* The register has 16 bits. */
+	I2C_RMW_FLAGS_DataLsbFirst = 4,   /* Send and receive the low byte of 16 bit data first. */
+	I2C_RMW_FLAGS_Verify = 8          /* Read back the register after the write. */
+} I2C_RMW_FLAGS_T;
+
+
+
+/* The error class of a failed sequence. */
+typedef enum I2C_SEQ_ERROR_ENUM
+{
+	I2C_SEQ_ERROR_None = 0,
+	I2C_SEQ_ERROR_InvalidCommand = 1,
+	I2C_SEQ_ERROR_CommandTruncated = 2,
+	I2C_SEQ_ERROR_RxOverflow = 3,
+	I2C_SEQ_ERROR_InvalidData = 4,
+	I2C_SEQ_ERROR_InvalidParameter = 5,
+	I2C_SEQ_ERROR_NakAddress = 6,
+	I2C_SEQ_ERROR_NakData = 7,
+	I2C_SEQ_ERROR_Timeout = 8,
+	I2C_SEQ_ERROR_PecMismatch = 9,
+	I2C_SEQ_ERROR_VerifyFailed = 10
+} I2C_SEQ_ERROR_T;
+
+
+
 typedef struct I2C_PARAMETER_OPEN_STRUCT
 {
 	uint32_t ptHandle;
@@ -41,6 +174,7 @@ typedef struct I2C_PARAMETER_OPEN_STRUCT
 	uint8_t ucMMIOIndexSDA;
 	uint16_t usPortcontrolSCL;
 	uint16_t usPortcontrolSDA;
+	uint16_t usClockStretchMs;
 } I2C_PARAMETER_OPEN_T;
 
 
@@ -53,10 +187,157 @@ typedef struct I2C_PARAMETER_RUN_SEQUENCE_STRUCT
 	uint8_t *pucReceivedData;
 	uint32_t sizReceivedDataMax;
 	uint32_t sizReceivedData;
+	uint8_t *pucPackedData;       /* Pack the received data here. Set to NULL to disable packing. */
+	uint32_t sizPackedDataMax;
+	uint32_t sizPackedData;       /* Size of the packed data or 0 if it was not packed. */
+	uint32_t ulResumeOffset;      /* Start the sequence at this offset in pucCommand. */
+	uint32_t ulResumeIndex;       /* The index of the command at ulResumeOffset. */
+	uint32_t ulErrorClass;        /* One of I2C_SEQ_ERROR_T. */
+	uint32_t ulErrorOffset;       /* Offset of the failed command in pucCommand. */
+	uint32_t ulErrorIndex;        /* Index of the failed command. */
+	uint32_t ulErrorBytes;        /* Number of bytes transferred by the failed command. */
+	uint8_t *pucSnapshot;         /* The snapshots of the ReadDelta commands. They are kept between the calls. */
+	uint32_t sizSnapshot;
+	uint32_t sizSlotArea;         /* The slots for the ReadTo commands are at the start of pucReceivedData. The other data follows them. */
+	I2C_RESULT_OFFSET_T *ptOffsetTable;  /* One entry for each executed command or NULL. */
+	uint32_t ulOffsetEntriesMax;
+	uint32_t ulOffsetEntries;     /* The number of executed commands. This can be larger than ulOffsetEntriesMax. */
 } I2C_PARAMETER_RUN_SEQUENCE_T;
 
 
 
+typedef struct I2C_PARAMETER_SCAN_STRUCT
+{
+	uint32_t ptHandle;
+	uint32_t ulAckPoll;
+	uint32_t ulFirstAddress;
+	uint32_t ulLastAddress;
+	uint8_t *pucPresenceBitmap;   /* 16 bytes, bit (n&7) of byte (n>>3) is set if address n acknowledged. */
+	uint32_t ulDevicesFound;
+} I2C_PARAMETER_SCAN_T;
+
+
+
+/* The benchmark results for one bus speed. All times are in microseconds. */
+typedef struct I2C_BENCHMARK_RESULT_STRUCT
+{
+	uint32_t ulSpeed;
+	uint32_t ulBytes;
+	uint32_t ulWriteTotalUs;
+	uint32_t ulWriteMinUs;
+	uint32_t ulWriteMaxUs;
+	uint32_t ulReadTotalUs;
+	uint32_t ulReadMinUs;
+	uint32_t ulReadMaxUs;
+	uint32_t ulErrors;
+} I2C_BENCHMARK_RESULT_T;
+
+
+
+typedef struct I2C_PARAMETER_BENCHMARK_STRUCT
+{
+	uint32_t ptHandle;                    /* The master. */
+	uint32_t ptSlaveHandle;               /* The slave, which must be connected to the master. */
+	uint32_t ulSlaveAddress;
+	uint32_t ulSpeedMask;                 /* Bit n selects the bus speed n. */
+	uint32_t ulTransferSize;              /* The number of data bytes for each transfer, 1-255. */
+	uint32_t ulTransfers;                 /* The number of transfers for each speed and direction. */
+	uint8_t *pucWorkBuffer;               /* 3*ulTransferSize+1 bytes. */
+	I2C_BENCHMARK_RESULT_T *ptResults;    /* One entry for each selected speed. */
+	uint32_t ulResults;
+} I2C_PARAMETER_BENCHMARK_T;
+
+
+
+/* Start or stop the capture of all bus events. The buffer gets an
+ * I2C_CAPTURE_T header and as many records as possible. A buffer size of 0
+ * stops the capture.
+ */
+typedef struct I2C_PARAMETER_CAPTURE_STRUCT
+{
+	uint32_t ptHandle;
+	uint8_t *pucBuffer;
+	uint32_t sizBuffer;
+	uint32_t ulMaxRecords;
+} I2C_PARAMETER_CAPTURE_T;
+
+
+
+/* Get the Adler-32 checksum of a memory area. The host uses this to check
+ * if the binary is already in the memory of the netX.
+ */
+typedef struct I2C_PARAMETER_CHECKSUM_STRUCT
+{
+	const uint8_t *pucData;
+	uint32_t sizData;
+	uint32_t ulChecksum;
+} I2C_PARAMETER_CHECKSUM_T;
+
+
+
+/* Run a sequence periodically and append the received data to a ring
+ * buffer. The buffer gets an I2C_SAMPLER_T header. The command runs until
+ * the host sets the stop request in the header or "ulSamplesMax" samples
+ * were taken. The host drains the ring while the command is running.
+ */
+typedef struct I2C_PARAMETER_SAMPLE_STRUCT
+{
+	uint32_t ptHandle;
+	const uint8_t *pucCommand;
+	uint32_t sizCommand;
+	uint32_t sizSample;           /* The maximum received data of one run. */
+	uint32_t ulPeriodMs;          /* The time between the starts of 2 runs. 0 runs them back to back. */
+	uint32_t ulSamplesMax;        /* Stop after this number of runs. 0 runs until the stop request. */
+	uint8_t *pucRing;
+	uint32_t sizRing;
+	uint32_t ulSamples;           /* The number of runs. */
+} I2C_PARAMETER_SAMPLE_T;
+
+
+
+/* The optional features of the firmware. Each one is a bit in the
+ * ulFeatures field of the capabilities.
+ */
+typedef enum I2C_FEATURE_ENUM
+{
+	I2C_FEATURE_PackedResult = 0x0001,     /* RLE packed result data and the WriteRle command. */
+	I2C_FEATURE_Resume = 0x0002,           /* Error record and resume of a sequence. */
+	I2C_FEATURE_AckPollPolicy = 0x0004,    /* The AckPollPolicy command. */
+	I2C_FEATURE_Scan = 0x0008,             /* The Scan command. */
+	I2C_FEATURE_Benchmark = 0x0010,        /* The slave mode and the Benchmark command. */
+	I2C_FEATURE_Capture = 0x0020,          /* The capture ring. */
+	I2C_FEATURE_WriteMulti = 0x0040,       /* The WriteMulti command. */
+	I2C_FEATURE_Smbus = 0x0080,            /* The Smbus command with PEC. */
+	I2C_FEATURE_Rmw = 0x0100,              /* The Rmw command. */
+	I2C_FEATURE_ExtendedLength = 0x0200,   /* The ReadExt and WriteExt commands. */
+	I2C_FEATURE_Checksum = 0x0400,         /* The Checksum command. */
+	I2C_FEATURE_Sample = 0x0800,           /* The periodic sampler. */
+	I2C_FEATURE_ReadDelta = 0x1000,        /* The ReadDelta command. */
+	I2C_FEATURE_ReadTo = 0x2000,           /* The ReadTo command, slots and the offset table. */
+	I2C_FEATURE_MuxSelect = 0x4000         /* The MuxSelect command with the channel cache. */
+} I2C_FEATURE_T;
+
+
+
+/* The limits of the I2C core and the firmware. All fields are set by the
+ * netX.
+ */
+typedef struct I2C_PARAMETER_CAPABILITIES_STRUCT
+{
+	uint32_t ulFifoDepth;             /* The number of entries in the master FIFO. */
+	uint32_t ulTransferSizeMax;       /* The maximum number of bytes in one hardware transfer. */
+	uint32_t ulAckPollMax;            /* The maximum ACK poll value of a command. */
+	uint32_t ulSpeedMask;             /* Bit n is set if I2CSPEED n is supported. */
+	uint32_t ulParameterStart;        /* The parameter area. */
+	uint32_t ulParameterSize;
+	uint32_t ulHandleSize;            /* The size of an I2C handle. */
+	uint32_t ulFeatures;              /* A combination of I2C_FEATURE_T. */
+	uint32_t ulBufferStart;           /* The transfer arena between .bss and the stack. */
+	uint32_t ulBufferSize;
+} I2C_PARAMETER_CAPABILITIES_T;
+
+
+
 typedef struct I2C_PARAMETER_STRUCT
 {
 	uint32_t ulVerbose;
@@ -64,6 +345,12 @@ typedef struct I2C_PARAMETER_STRUCT
 	union {
 		I2C_PARAMETER_OPEN_T tOpen;
 		I2C_PARAMETER_RUN_SEQUENCE_T tRunSequence;
+		I2C_PARAMETER_SCAN_T tScan;
+		I2C_PARAMETER_BENCHMARK_T tBenchmark;
+		I2C_PARAMETER_CAPTURE_T tCapture;
+		I2C_PARAMETER_CHECKSUM_T tChecksum;
+		I2C_PARAMETER_CAPABILITIES_T tCapabilities;
+		I2C_PARAMETER_SAMPLE_T tSample;
 	} uParameter;
 } I2C_PARAMETER_T;
 
@@ -23,10 +23,19 @@
 
 #include <string.h>
 
+#include "arena.h"
+#include "cycle_counter.h"
+#include "i2c_benchmark.h"
+#include "i2c_capture.h"
+#include "i2c_dispatch.h"
+#include "i2c_sampler.h"
 #include "netx_io_areas.h"
 #include "portcontrol.h"
 #include "rdy_run.h"
+#include "rle.h"
+#include "smbus.h"
 #include "systime.h"
+#include "tcm.h"
 #include "uprintf.h"
 #include "version.h"
 
@@ -34,6 +43,42 @@
 /*-------------------------------------------------------------------------*/
 
 
+extern unsigned long parameter_start_address[];
+extern unsigned long parameter_end_address[];
+extern unsigned long buffer_start_address[];
+extern unsigned long buffer_end_address[];
+
+
+/* The host places the handles and all buffers in the parameter area or in
+ * the transfer arena between .bss and the stack. A command must not write
+ * anywhere else.
+ */
+static ARENA_T tArenaParameter;
+static ARENA_T tArenaTransfer;
+
+
+static int is_valid_buffer(const void *pvData, size_t sizData)
+{
+	int iResult;
+
+
+	iResult = arena_contains(&tArenaParameter, pvData, sizData);
+	if( iResult==0 )
+	{
+		iResult = arena_contains(&tArenaTransfer, pvData, sizData);
+	}
+	if( iResult==0 )
+	{
+		uprintf("The buffer [0x%08x, 0x%08x[ is outside the parameter area and the transfer arena.\n", (unsigned long)pvData, (unsigned long)pvData + sizData);
+	}
+
+	return iResult;
+}
+
+
+/*-------------------------------------------------------------------------*/
+
+
 struct __attribute__((__packed__)) I2C_SEQ_COMMAND_RW_STRUCT
 {
         unsigned char ucConditions;
@@ -50,6 +95,164 @@ typedef union I2C_SEQ_COMMAND_RW_UNION
 
 
 
+/* The extended read and write commands have a 32 bit data size. */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_RW_EXT_STRUCT
+{
+        unsigned char ucConditions;
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned long ulDataSize;
+};
+
+typedef union I2C_SEQ_COMMAND_RW_EXT_UNION
+{
+        struct I2C_SEQ_COMMAND_RW_EXT_STRUCT s;
+        unsigned char auc[7];
+} I2C_SEQ_COMMAND_RW_EXT_T;
+
+
+
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_RW_RLE_STRUCT
+{
+        unsigned char ucConditions;
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned short usDataSize;
+        unsigned short usPackedSize;
+};
+
+typedef union I2C_SEQ_COMMAND_RW_RLE_UNION
+{
+        struct I2C_SEQ_COMMAND_RW_RLE_STRUCT s;
+        unsigned char auc[7];
+} I2C_SEQ_COMMAND_RW_RLE_T;
+
+
+
+/* The header of a write to several devices is followed by "ucAddresses"
+ * addresses and one block of data for all devices.
+ */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_WRITE_MULTI_STRUCT
+{
+        unsigned char ucConditions;
+        unsigned char ucAckPoll;
+        unsigned char ucAddresses;
+        unsigned short usDataSize;
+};
+
+typedef union I2C_SEQ_COMMAND_WRITE_MULTI_UNION
+{
+        struct I2C_SEQ_COMMAND_WRITE_MULTI_STRUCT s;
+        unsigned char auc[5];
+} I2C_SEQ_COMMAND_WRITE_MULTI_T;
+
+
+
+/* The header of an SMBus transaction. "ucSize" is the number of data bytes
+ * which follow the header for the write protocols and the maximum count for
+ * a block read.
+ */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_SMBUS_STRUCT
+{
+        unsigned char ucProtocol;
+        unsigned char ucFlags;
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned char ucCommand;
+        unsigned char ucSize;
+};
+
+typedef union I2C_SEQ_COMMAND_SMBUS_UNION
+{
+        struct I2C_SEQ_COMMAND_SMBUS_STRUCT s;
+        unsigned char auc[6];
+} I2C_SEQ_COMMAND_SMBUS_T;
+
+
+
+/* A read with a destination for the data. "usSlotOffset" is only used for
+ * the slot destination. It is the offset in the slot area.
+ */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_READ_TO_STRUCT
+{
+        unsigned char ucConditions;
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned short usDataSize;
+        unsigned char ucDestination;
+        unsigned short usSlotOffset;
+};
+
+typedef union I2C_SEQ_COMMAND_READ_TO_UNION
+{
+        struct I2C_SEQ_COMMAND_READ_TO_STRUCT s;
+        unsigned char auc[8];
+} I2C_SEQ_COMMAND_READ_TO_T;
+
+
+
+/* A complete read transaction with START and STOP, which only stores the
+ * changes since the last run. The snapshot at "usSnapshotOffset" in the
+ * snapshot area has a 32 bit tag and "usDataSize" bytes.
+ */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_READ_DELTA_STRUCT
+{
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned short usDataSize;
+        unsigned short usSnapshotOffset;
+};
+
+typedef union I2C_SEQ_COMMAND_READ_DELTA_UNION
+{
+        struct I2C_SEQ_COMMAND_READ_DELTA_STRUCT s;
+        unsigned char auc[6];
+} I2C_SEQ_COMMAND_READ_DELTA_T;
+
+
+
+/* A read-modify-write of one register. The new value is
+ * ((old & usAndMask) | usOrMask) ^ usXorMask.
+ */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_RMW_STRUCT
+{
+        unsigned char ucFlags;
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned short usRegister;
+        unsigned short usAndMask;
+        unsigned short usOrMask;
+        unsigned short usXorMask;
+};
+
+typedef union I2C_SEQ_COMMAND_RMW_UNION
+{
+        struct I2C_SEQ_COMMAND_RMW_STRUCT s;
+        unsigned char auc[11];
+} I2C_SEQ_COMMAND_RMW_T;
+
+
+
+/* Select the channels of a multiplexer with a complete write transaction.
+ * "ucChannels" is the value of the control register, e.g. one bit for each
+ * channel of a PCA9548.
+ */
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_MUX_SELECT_STRUCT
+{
+        unsigned char ucAddress;
+        unsigned char ucAckPoll;
+        unsigned char ucChannels;
+        unsigned char ucFlags;
+};
+
+typedef union I2C_SEQ_COMMAND_MUX_SELECT_UNION
+{
+        struct I2C_SEQ_COMMAND_MUX_SELECT_STRUCT s;
+        unsigned char auc[4];
+} I2C_SEQ_COMMAND_MUX_SELECT_T;
+
+
+
 struct __attribute__((__packed__)) I2C_SEQ_COMMAND_DELAY_STRUCT
 {
         unsigned long ulDelayInMs;
@@ -63,6 +266,41 @@ typedef union I2C_SEQ_COMMAND_DELAY_UNION
 
 
 
+struct __attribute__((__packed__)) I2C_SEQ_COMMAND_ACK_POLL_POLICY_STRUCT
+{
+        unsigned short usBudgetMs;
+        unsigned short usBackoffMs;
+        unsigned short usBackoffMaxMs;
+};
+
+typedef union I2C_SEQ_COMMAND_ACK_POLL_POLICY_UNION
+{
+        struct I2C_SEQ_COMMAND_ACK_POLL_POLICY_STRUCT s;
+        unsigned char auc[6];
+} I2C_SEQ_COMMAND_ACK_POLL_POLICY_T;
+
+
+
+/* The software ACK poll repeats a command which was not acknowledged on the
+ * address. It waits between the hardware ACK poll bursts, starting with
+ * ulBackoffMs and doubling the time up to ulBackoffMaxMs. A budget of 0
+ * disables the software ACK poll.
+ */
+typedef struct ACK_POLL_POLICY_STRUCT
+{
+	unsigned long ulBudgetMs;
+	unsigned long ulBackoffMs;
+	unsigned long ulBackoffMaxMs;
+} ACK_POLL_POLICY_T;
+
+typedef struct ACK_POLL_STATE_STRUCT
+{
+	TIMER_HANDLE_T tBudget;
+	unsigned long ulBackoffMs;
+} ACK_POLL_STATE_T;
+
+
+
 typedef struct CMD_STATE_STRUCT
 {
 	unsigned long ulVerbose;
@@ -70,62 +308,256 @@ typedef struct CMD_STATE_STRUCT
 	const unsigned char *pucCmdEnd;
 	unsigned char *pucRecCnt;
 	unsigned char *pucRecEnd;
+	I2C_SEQ_ERROR_T tError;
+	unsigned long ulErrorBytes;
+	ACK_POLL_POLICY_T tAckPollPolicy;
+	unsigned char *pucSnapshot;
+	unsigned long sizSnapshot;
+	unsigned char *pucSlotArea;
+	unsigned long sizSlotArea;
+	unsigned char *pucSlotData;      /* A command which wrote to a slot sets this for the offset table. */
+	unsigned long sizSlotData;
 } CMD_STATE_T;
 
 
 
-static int command_read(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
+/* Translate the result of a driver function to an error class. A failed
+ * transfer might have changed the channels of a multiplexer, so the
+ * multiplexer cache is cleared, too.
+ */
+static void TCM_CODE set_driver_error(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle, int iResult)
+{
+	I2C_SEQ_ERROR_T tError;
+
+
+	switch( (I2C_RESULT_T)iResult )
+	{
+	case I2C_RESULT_NakAddress:
+		tError = I2C_SEQ_ERROR_NakAddress;
+		break;
+
+	case I2C_RESULT_NakData:
+		tError = I2C_SEQ_ERROR_NakData;
+		break;
+
+	case I2C_RESULT_Timeout:
+		tError = I2C_SEQ_ERROR_Timeout;
+		break;
+
+	case I2C_RESULT_Ok:
+	case I2C_RESULT_InvalidParameter:
+	default:
+		tError = I2C_SEQ_ERROR_InvalidParameter;
+		break;
+	}
+
+	ptState->tError = tError;
+	ptState->ulErrorBytes = ptHandle->ulBytesTransferred;
+
+	i2c_core_hsoc_v2_mux_cache_clear(ptHandle);
+}
+
+
+
+static void ack_poll_start(const CMD_STATE_T *ptState, ACK_POLL_STATE_T *ptAckPoll)
+{
+	systime_handle_start_ms(&(ptAckPoll->tBudget), ptState->tAckPollPolicy.ulBudgetMs);
+	ptAckPoll->ulBackoffMs = ptState->tAckPollPolicy.ulBackoffMs;
+}
+
+
+
+/* Decide if a failed command should be repeated. This is the case if the
+ * address was not acknowledged and the budget is not exhausted yet.
+ * The routine waits for the backoff time before it returns.
+ */
+static int ack_poll_retry(const CMD_STATE_T *ptState, ACK_POLL_STATE_T *ptAckPoll, int iResult)
+{
+	int iRetry;
+	unsigned long ulBackoffMs;
+
+
+	iRetry = 0;
+	if( iResult==I2C_RESULT_NakAddress && ptState->tAckPollPolicy.ulBudgetMs!=0U )
+	{
+		if( systime_handle_is_elapsed(&(ptAckPoll->tBudget))==0 )
+		{
+			ulBackoffMs = ptAckPoll->ulBackoffMs;
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("No ACK, retry in %d ms.\n", ulBackoffMs);
+			}
+			systime_delay_ms(ulBackoffMs);
+
+			/* Double the backoff time up to the limit. */
+			ulBackoffMs *= 2U;
+			if( ulBackoffMs>ptState->tAckPollPolicy.ulBackoffMaxMs )
+			{
+				ulBackoffMs = ptState->tAckPollPolicy.ulBackoffMaxMs;
+			}
+			ptAckPoll->ulBackoffMs = ulBackoffMs;
+
+			iRetry = 1;
+		}
+	}
+
+	return iRetry;
+}
+
+
+
+static int get_driver_conditions(unsigned char ucConditions, unsigned char ucAddress)
+{
+	int iConditions;
+	unsigned long ulValue;
+
+
+	/* Combine the address and the conditions for the
+	 * driver to one 32bit value.
+	 */
+	iConditions = (int)ucAddress;
+	ulValue = (unsigned long)ucConditions;
+	if( (ulValue&I2C_SEQ_CONDITION_Start)!=0 )
+	{
+		iConditions |= I2C_START_COND;
+	}
+	if( (ulValue&I2C_SEQ_CONDITION_Stop)!=0 )
+	{
+		iConditions |= I2C_STOP_COND;
+	}
+	if( (ulValue&I2C_SEQ_CONDITION_Continue)!=0 )
+	{
+		iConditions |= I2C_CONTINUE;
+	}
+
+	return iConditions;
+}
+
+
+
+/* Get the cache entry of a multiplexer or NULL if it is not in the cache. */
+static I2C_MUX_CACHE_T * TCM_CODE mux_cache_find(I2C_HANDLE_T *ptHandle, unsigned char ucAddress)
+{
+	I2C_MUX_CACHE_T *ptEntry;
+	unsigned int uiCnt;
+
+
+	ptEntry = NULL;
+	for(uiCnt=0; uiCnt<I2C_MUX_CACHE_SIZE; ++uiCnt)
+	{
+		if( ptHandle->atMuxCache[uiCnt].ucAddress==ucAddress )
+		{
+			ptEntry = ptHandle->atMuxCache + uiCnt;
+			break;
+		}
+	}
+
+	return ptEntry;
+}
+
+
+
+/* A write to a multiplexer outside of a MuxSelect command changes the
+ * channels. Forget the cached value.
+ */
+static void TCM_CODE mux_cache_invalidate(I2C_HANDLE_T *ptHandle, int iConditions, unsigned char ucAddress)
+{
+	I2C_MUX_CACHE_T *ptEntry;
+
+
+	if( (iConditions&I2C_START_COND)!=0 )
+	{
+		ptEntry = mux_cache_find(ptHandle, ucAddress);
+		if( ptEntry!=NULL )
+		{
+			ptEntry->ucAddress = 0xffU;
+		}
+	}
+}
+
+
+
+/* Get the header of a read or write command. The extended commands have a
+ * 32 bit data size.
+ */
+static int TCM_CODE get_rw_header(CMD_STATE_T *ptState, int iIsExtended, I2C_SEQ_COMMAND_RW_EXT_T *ptHeader, unsigned int *psizHeader)
 {
 	int iResult;
 	const I2C_SEQ_COMMAND_RW_T *ptCmd;
-	unsigned long ulDataSize;
-	unsigned long ulValue;
-	int iConditions;
-	unsigned int uiAckPoll;
+	unsigned int sizHeader;
 
 
-	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_T))>ptState->pucCmdEnd )
+	if( iIsExtended!=0 )
+	{
+		sizHeader = sizeof(I2C_SEQ_COMMAND_RW_EXT_T);
+	}
+	else
+	{
+		sizHeader = sizeof(I2C_SEQ_COMMAND_RW_T);
+	}
+
+	if( (ptState->pucCmdCnt + sizHeader)>ptState->pucCmdEnd )
 	{
 		if( ptState->ulVerbose!=0U )
 		{
-			uprintf("Not enough data for the read command left.\n");
+			uprintf("Not enough data for the read/write header left.\n");
 		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
 		iResult = -1;
 	}
 	else
 	{
-		ptCmd = (const I2C_SEQ_COMMAND_RW_T*)(ptState->pucCmdCnt);
-		ulDataSize = ptCmd->s.usDataSize;
-		if( (ptState->pucRecCnt + ulDataSize)>ptState->pucRecEnd )
+		if( iIsExtended!=0 )
+		{
+			memcpy(ptHeader, ptState->pucCmdCnt, sizeof(I2C_SEQ_COMMAND_RW_EXT_T));
+		}
+		else
+		{
+			ptCmd = (const I2C_SEQ_COMMAND_RW_T*)(ptState->pucCmdCnt);
+			ptHeader->s.ucConditions = ptCmd->s.ucConditions;
+			ptHeader->s.ucAddress = ptCmd->s.ucAddress;
+			ptHeader->s.ucAckPoll = ptCmd->s.ucAckPoll;
+			ptHeader->s.ulDataSize = ptCmd->s.usDataSize;
+		}
+		*psizHeader = sizHeader;
+		iResult = 0;
+	}
+
+	return iResult;
+}
+
+
+
+static int TCM_CODE command_read(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle, int iIsExtended)
+{
+	int iResult;
+	I2C_SEQ_COMMAND_RW_EXT_T tCmd;
+	unsigned int sizHeader;
+	unsigned long ulDataSize;
+	int iConditions;
+	unsigned int uiAckPoll;
+	ACK_POLL_STATE_T tAckPoll;
+
+
+	iResult = get_rw_header(ptState, iIsExtended, &tCmd, &sizHeader);
+	if( iResult==0 )
+	{
+		ulDataSize = tCmd.s.ulDataSize;
+		if( ulDataSize>(unsigned long)(ptState->pucRecEnd - ptState->pucRecCnt) )
 		{
 			if( ptState->ulVerbose!=0U )
 			{
 				uprintf("Not enough data for the receive data left.\n");
 			}
+			ptState->tError = I2C_SEQ_ERROR_RxOverflow;
 			iResult = -1;
 		}
 		else
 		{
-			/* Combine the address and the conditions for the
-			 * driver to one 32bit value.
-			 */
-			iConditions = (int)(ptCmd->s.ucAddress);
-			ulValue = (unsigned long)(ptCmd->s.ucConditions);
-			if( (ulValue&I2C_SEQ_CONDITION_Start)!=0 )
-			{
-				iConditions |= I2C_START_COND;
-			}
-			if( (ulValue&I2C_SEQ_CONDITION_Stop)!=0 )
-			{
-				iConditions |= I2C_STOP_COND;
-			}
-			if( (ulValue&I2C_SEQ_CONDITION_Continue)!=0 )
-			{
-				iConditions |= I2C_CONTINUE;
-			}
+			iConditions = get_driver_conditions(tCmd.s.ucConditions, tCmd.s.ucAddress);
 
 			/* Get the ACK poll value. */
-			uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+			uiAckPoll = (unsigned int)(tCmd.s.ucAckPoll);
 
 			if( ptState->ulVerbose!=0U )
 			{
@@ -137,13 +569,18 @@ static int command_read(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
 				{
 					uprintf("CONTINUE\n");
 				}
-				uprintf("READ from address 0x%02x, %d retries, %d bytes\n", ptCmd->s.ucAddress, uiAckPoll, ulDataSize);
+				uprintf("READ from address 0x%02x, %d retries, %d bytes\n", tCmd.s.ucAddress, uiAckPoll, ulDataSize);
 			}
 
 			/* Run the command. */
-			iResult = ptHandle->tI2CFn.fnRecv(ptHandle, iConditions, uiAckPoll, ulDataSize, ptState->pucRecCnt);
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_RECV(ptHandle, iConditions, uiAckPoll, ulDataSize, ptState->pucRecCnt);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
 			if( iResult!=0 )
 			{
+				set_driver_error(ptState, ptHandle, iResult);
 				if( ptState->ulVerbose!=0U )
 				{
 					uprintf("The I2C receive operation failed.\n");
@@ -159,7 +596,7 @@ static int command_read(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
 						uprintf("STOP\n");
 					}
 				}
-				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_RW_T);
+				ptState->pucCmdCnt += sizHeader;
 				ptState->pucRecCnt += ulDataSize;
 			}
 		}
@@ -170,55 +607,138 @@ static int command_read(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
 
 
 
-static int command_write(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
+static int TCM_CODE command_write(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle, int iIsExtended)
 {
 	int iResult;
-	const I2C_SEQ_COMMAND_RW_T *ptCmd;
+	I2C_SEQ_COMMAND_RW_EXT_T tCmd;
+	unsigned int sizHeader;
+	const unsigned char *pucData;
 	unsigned long ulDataSize;
-	unsigned long ulValue;
 	int iConditions;
 	unsigned int uiAckPoll;
+	ACK_POLL_STATE_T tAckPoll;
 
 
-	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_T))>ptState->pucCmdEnd )
-	{
-		if( ptState->ulVerbose!=0U )
-		{
-			uprintf("Not enough data for the write header left.\n");
-		}
-		iResult = -1;
-	}
-	else
+	iResult = get_rw_header(ptState, iIsExtended, &tCmd, &sizHeader);
+	if( iResult==0 )
 	{
-		ptCmd = (const I2C_SEQ_COMMAND_RW_T*)(ptState->pucCmdCnt);
-		ulDataSize = ptCmd->s.usDataSize;
-		if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_T) + ulDataSize)>ptState->pucCmdEnd )
+		ulDataSize = tCmd.s.ulDataSize;
+		pucData = ptState->pucCmdCnt + sizHeader;
+		if( ulDataSize>(unsigned long)(ptState->pucCmdEnd - pucData) )
 		{
 			if( ptState->ulVerbose!=0U )
 			{
 				uprintf("Not enough data for the complete write command left.\n");
 			}
+			ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
 			iResult = -1;
 		}
 		else
 		{
-			/* Combine the address and the conditions for the
-			 * driver to one 32bit value.
-			 */
-			iConditions = (int)(ptCmd->s.ucAddress);
-			ulValue = (unsigned long)(ptCmd->s.ucConditions);
-			if( (ulValue&I2C_SEQ_CONDITION_Start)!=0 )
-			{
-				iConditions |= I2C_START_COND;
-			}
-			if( (ulValue&I2C_SEQ_CONDITION_Stop)!=0 )
-			{
-				iConditions |= I2C_STOP_COND;
+			iConditions = get_driver_conditions(tCmd.s.ucConditions, tCmd.s.ucAddress);
+			mux_cache_invalidate(ptHandle, iConditions, tCmd.s.ucAddress);
+
+			/* Get the ACK poll value. */
+			uiAckPoll = (unsigned int)(tCmd.s.ucAckPoll);
+
+			if( ptState->ulVerbose!=0U )
+			{
+				if( (iConditions&I2C_START_COND)!=0 )
+				{
+					uprintf("START\n");
+				}
+				if( (iConditions&I2C_CONTINUE)!=0 )
+				{
+					uprintf("CONTINUE\n");
+				}
+				uprintf("WRITE to address 0x%02x, %d retries, %d bytes\n", tCmd.s.ucAddress, uiAckPoll, ulDataSize);
+				hexdump(pucData, ulDataSize);
+			}
+
+			/* Run the command. */
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_SEND(ptHandle, iConditions, uiAckPoll, ulDataSize, pucData);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+			if( iResult!=0 )
+			{
+				set_driver_error(ptState, ptHandle, iResult);
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("The I2C send operation failed.\n");
+				}
+			}
+			else
+			{
+				if( ptState->ulVerbose!=0U )
+				{
+					if( (iConditions&I2C_STOP_COND)!=0 )
+					{
+						uprintf("STOP\n");
+					}
+				}
+				ptState->pucCmdCnt += sizHeader + ulDataSize;
+			}
+		}
+	}
+
+	return iResult;
+}
+
+
+
+static int TCM_CODE command_write_rle(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_RW_RLE_T *ptCmd;
+	const unsigned char *pucPacked;
+	unsigned long ulDataSize;
+	unsigned long ulPackedSize;
+	int iConditions;
+	unsigned int uiAckPoll;
+	ACK_POLL_STATE_T tAckPoll;
+	RLE_DECODER_T tDecoder;
+
+
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_RLE_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the RLE write header left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+		iResult = -1;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_RW_RLE_T*)(ptState->pucCmdCnt);
+		ulDataSize = ptCmd->s.usDataSize;
+		ulPackedSize = ptCmd->s.usPackedSize;
+		pucPacked = ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_RLE_T);
+		if( (pucPacked + ulPackedSize)>ptState->pucCmdEnd )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Not enough data for the complete RLE write command left.\n");
 			}
-			if( (ulValue&I2C_SEQ_CONDITION_Continue)!=0 )
+			ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+			iResult = -1;
+		}
+		/* Check the packed data before anything is sent to the bus. */
+		else if( rle_validate(pucPacked, ulPackedSize, ulDataSize)!=0 )
+		{
+			if( ptState->ulVerbose!=0U )
 			{
-				iConditions |= I2C_CONTINUE;
+				uprintf("The packed data is invalid.\n");
 			}
+			ptState->tError = I2C_SEQ_ERROR_InvalidData;
+			iResult = -1;
+		}
+		else
+		{
+			iConditions = get_driver_conditions(ptCmd->s.ucConditions, ptCmd->s.ucAddress);
+			mux_cache_invalidate(ptHandle, iConditions, ptCmd->s.ucAddress);
 
 			/* Get the ACK poll value. */
 			uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
@@ -233,14 +753,19 @@ static int command_write(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
 				{
 					uprintf("CONTINUE\n");
 				}
-				uprintf("WRITE to address 0x%02x, %d retries, %d bytes\n", ptCmd->s.ucAddress, uiAckPoll, ulDataSize);
-				hexdump(ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_T), ulDataSize);
+				uprintf("WRITE RLE to address 0x%02x, %d retries, %d bytes packed to %d bytes\n", ptCmd->s.ucAddress, uiAckPoll, ulDataSize, ulPackedSize);
 			}
 
-			/* Run the command. */
-			iResult = ptHandle->tI2CFn.fnSend(ptHandle, iConditions, uiAckPoll, ulDataSize, ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RW_T));
+			/* Run the command. The data is unpacked directly into the FIFO. */
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				rle_decoder_init(&tDecoder, pucPacked);
+				iResult = I2C_SEND_STREAM(ptHandle, iConditions, uiAckPoll, ulDataSize, rle_decoder_get_byte, &tDecoder);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
 			if( iResult!=0 )
 			{
+				set_driver_error(ptState, ptHandle, iResult);
 				if( ptState->ulVerbose!=0U )
 				{
 					uprintf("The I2C send operation failed.\n");
@@ -255,7 +780,7 @@ static int command_write(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
 						uprintf("STOP\n");
 					}
 				}
-				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_RW_T) + ulDataSize;
+				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_RW_RLE_T) + ulPackedSize;
 			}
 		}
 	}
@@ -265,32 +790,1411 @@ static int command_write(CMD_STATE_T *ptState, const I2C_HANDLE_T *ptHandle)
 
 
 
-static int command_delay(CMD_STATE_T *ptState)
+/* Write the same data to several devices, one after the other. Each write
+ * uses the same conditions, so every device gets its own START.
+ * If one device fails, the error bytes include the data of all devices
+ * before it. The host can get the index of the failed device by dividing
+ * the error bytes by the data size.
+ */
+static int command_write_multi(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
 {
 	int iResult;
-	const I2C_SEQ_COMMAND_DELAY_T *ptCmd;
+	const I2C_SEQ_COMMAND_WRITE_MULTI_T *ptCmd;
+	const unsigned char *pucAddresses;
+	const unsigned char *pucData;
+	unsigned long ulDataSize;
+	unsigned int uiAddresses;
+	unsigned int uiAddressCnt;
+	int iConditions;
+	unsigned int uiAckPoll;
+	ACK_POLL_STATE_T tAckPoll;
 
 
-	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_DELAY_T))>ptState->pucCmdEnd )
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_WRITE_MULTI_T))>ptState->pucCmdEnd )
 	{
 		if( ptState->ulVerbose!=0U )
 		{
-			uprintf("Not enough data for the delay command left.\n");
+			uprintf("Not enough data for the multi write header left.\n");
 		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
 		iResult = -1;
 	}
 	else
 	{
-		ptCmd = (const I2C_SEQ_COMMAND_DELAY_T*)(ptState->pucCmdCnt);
+		ptCmd = (const I2C_SEQ_COMMAND_WRITE_MULTI_T*)(ptState->pucCmdCnt);
+		ulDataSize = ptCmd->s.usDataSize;
+		uiAddresses = ptCmd->s.ucAddresses;
+		pucAddresses = ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_WRITE_MULTI_T);
+		pucData = pucAddresses + uiAddresses;
+		if( (pucData + ulDataSize)>ptState->pucCmdEnd )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Not enough data for the complete multi write command left.\n");
+			}
+			ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+			iResult = -1;
+		}
+		/* Without a START condition all data would go to the first device. */
+		else if( uiAddresses==0 || (uiAddresses>1 && (ptCmd->s.ucConditions&I2C_SEQ_CONDITION_Start)==0) )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("A multi write needs at least one address and a START condition for more than one address.\n");
+			}
+			ptState->tError = I2C_SEQ_ERROR_InvalidParameter;
+			iResult = -1;
+		}
+		else
+		{
+			/* Get the ACK poll value. */
+			uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("WRITE to %d addresses, %d retries, %d bytes\n", uiAddresses, uiAckPoll, ulDataSize);
+				hexdump(pucData, ulDataSize);
+			}
+
+			iResult = 0;
+			for(uiAddressCnt=0; uiAddressCnt<uiAddresses; ++uiAddressCnt)
+			{
+				iConditions = get_driver_conditions(ptCmd->s.ucConditions, pucAddresses[uiAddressCnt]);
+				mux_cache_invalidate(ptHandle, iConditions, pucAddresses[uiAddressCnt]);
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("WRITE to address 0x%02x\n", pucAddresses[uiAddressCnt]);
+				}
+
+				/* Run the command. All devices use the same data. */
+				ack_poll_start(ptState, &tAckPoll);
+				do
+				{
+					iResult = I2C_SEND(ptHandle, iConditions, uiAckPoll, ulDataSize, pucData);
+				} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+				if( iResult!=0 )
+				{
+					set_driver_error(ptState, ptHandle, iResult);
+					ptState->ulErrorBytes += uiAddressCnt * ulDataSize;
+					if( ptState->ulVerbose!=0U )
+					{
+						uprintf("The I2C send operation to address 0x%02x failed.\n", pucAddresses[uiAddressCnt]);
+					}
+					break;
+				}
+			}
+
+			if( iResult==0 )
+			{
+				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_WRITE_MULTI_T) + uiAddresses + ulDataSize;
+			}
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* Run one SMBus transaction with the command code, the optional count, the
+ * data and the optional PEC. The PEC is generated for writes and checked
+ * for reads on the netX.
+ */
+static int command_smbus(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_SMBUS_T *ptCmd;
+	const unsigned char *pucData;
+	I2C_SMBUS_PROTOCOL_T tProtocol;
+	unsigned int uiSize;
+	unsigned int uiWriteSize;
+	unsigned int uiReadSize;
+	unsigned int uiPecSize;
+	unsigned int sizWrite;
+	unsigned int sizRead;
+	int iIsBlock;
+	int iConditions;
+	unsigned int uiAckPoll;
+	unsigned char ucAddress;
+	unsigned char ucPec;
+	ACK_POLL_STATE_T tAckPoll;
+	/* The command code, the count, up to 255 bytes of data and the PEC. */
+	unsigned char aucWrite[258];
+	/* The count, up to 255 bytes of data and the PEC. */
+	unsigned char aucRead[257];
 
+
+	iResult = -1;
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_SMBUS_T))>ptState->pucCmdEnd )
+	{
 		if( ptState->ulVerbose!=0U )
 		{
-			uprintf("I2C_COMMAND_Delay %d ms\n", ptCmd->s.ulDelayInMs);
+			uprintf("Not enough data for the SMBus header left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_SMBUS_T*)(ptState->pucCmdCnt);
+		pucData = ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_SMBUS_T);
+		tProtocol = (I2C_SMBUS_PROTOCOL_T)(ptCmd->s.ucProtocol);
+		uiSize = ptCmd->s.ucSize;
+		uiPecSize = ((ptCmd->s.ucFlags&I2C_SMBUS_FLAGS_Pec)!=0) ? 1U : 0U;
+		uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+		iIsBlock = 0;
+
+		/* Get the number of data bytes for both directions. */
+		uiWriteSize = 0;
+		uiReadSize = 0;
+		switch( tProtocol )
+		{
+		case I2C_SMBUS_PROTOCOL_ReadByte:
+			uiReadSize = 1;
+			iResult = (uiSize==0) ? 0 : -1;
+			break;
+
+		case I2C_SMBUS_PROTOCOL_WriteByte:
+			uiWriteSize = 1;
+			iResult = (uiSize==1) ? 0 : -1;
+			break;
+
+		case I2C_SMBUS_PROTOCOL_ReadWord:
+			uiReadSize = 2;
+			iResult = (uiSize==0) ? 0 : -1;
+			break;
+
+		case I2C_SMBUS_PROTOCOL_WriteWord:
+			uiWriteSize = 2;
+			iResult = (uiSize==2) ? 0 : -1;
+			break;
+
+		case I2C_SMBUS_PROTOCOL_BlockRead:
+			/* The result is the count and space for the maximum count. */
+			uiReadSize = 1U + uiSize;
+			iIsBlock = 1;
+			iResult = (uiSize!=0) ? 0 : -1;
+			break;
+
+		case I2C_SMBUS_PROTOCOL_BlockWrite:
+			uiWriteSize = uiSize;
+			iIsBlock = 1;
+			iResult = (uiSize!=0) ? 0 : -1;
+			break;
+
+		case I2C_SMBUS_PROTOCOL_ProcessCall:
+			uiWriteSize = 2;
+			uiReadSize = 2;
+			iResult = (uiSize==2) ? 0 : -1;
+			break;
+		}
+		if( iResult!=0 )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Invalid SMBus protocol %d with size %d.\n", tProtocol, uiSize);
+			}
+			ptState->tError = I2C_SEQ_ERROR_InvalidParameter;
+		}
+		else if( (pucData + uiWriteSize)>ptState->pucCmdEnd )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Not enough data for the complete SMBus command left.\n");
+			}
+			ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+			iResult = -1;
+		}
+		else if( (ptState->pucRecCnt + uiReadSize)>ptState->pucRecEnd )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Not enough data for the receive data left.\n");
+			}
+			ptState->tError = I2C_SEQ_ERROR_RxOverflow;
+			iResult = -1;
+		}
+		else
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("SMBUS protocol %d to address 0x%02x, command 0x%02x, %d retries, PEC %s\n", tProtocol, ptCmd->s.ucAddress, ptCmd->s.ucCommand, uiAckPoll, (uiPecSize!=0) ? "on" : "off");
+			}
+
+			/* Collect the write phase: command code, count and data. */
+			sizWrite = 0;
+			aucWrite[sizWrite++] = ptCmd->s.ucCommand;
+			if( iIsBlock!=0 && uiWriteSize!=0 )
+			{
+				aucWrite[sizWrite++] = (unsigned char)uiWriteSize;
+			}
+			memcpy(aucWrite + sizWrite, pucData, uiWriteSize);
+			sizWrite += uiWriteSize;
+
+			/* The PEC starts with the address in write mode. */
+			ucAddress = (unsigned char)(ptCmd->s.ucAddress << 1U);
+			ucPec = smbus_pec(0, &ucAddress, 1);
+			ucPec = smbus_pec(ucPec, aucWrite, sizWrite);
+
+			if( uiReadSize==0 )
+			{
+				/* A write transaction ends with the PEC. */
+				if( uiPecSize!=0 )
+				{
+					aucWrite[sizWrite++] = ucPec;
+				}
+				iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Stop, ptCmd->s.ucAddress);
+			}
+			else
+			{
+				/* A read transaction continues with a repeated START. */
+				iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start, ptCmd->s.ucAddress);
+			}
+
+			mux_cache_invalidate(ptHandle, iConditions, ptCmd->s.ucAddress);
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_SEND(ptHandle, iConditions, uiAckPoll, sizWrite, aucWrite);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+
+			if( iResult==0 && uiReadSize!=0 )
+			{
+				ucAddress |= 1U;
+				ucPec = smbus_pec(ucPec, &ucAddress, 1);
+
+				sizRead = uiReadSize;
+				if( iIsBlock==0 )
+				{
+					iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Stop, ptCmd->s.ucAddress);
+					iResult = I2C_RECV(ptHandle, iConditions, 0, sizRead + uiPecSize, aucRead);
+				}
+				else
+				{
+					/* Get the count first. Then read the data and the PEC. */
+					iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Continue, ptCmd->s.ucAddress);
+					iResult = I2C_RECV(ptHandle, iConditions, 0, 1, aucRead);
+					if( iResult==0 )
+					{
+						sizRead = aucRead[0];
+						iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Stop, 0);
+						if( sizRead==0 || sizRead>uiSize )
+						{
+							/* Terminate the transfer with a NAK and a STOP. */
+							if( ptState->ulVerbose!=0U )
+							{
+								uprintf("The block count %d exceeds the limit of %d.\n", sizRead, uiSize);
+							}
+							I2C_RECV(ptHandle, iConditions, 0, 1, aucRead + 1);
+							ptState->tError = I2C_SEQ_ERROR_InvalidData;
+							iResult = -1;
+						}
+						else
+						{
+							iResult = I2C_RECV(ptHandle, iConditions, 0, sizRead + uiPecSize, aucRead + 1);
+							++sizRead;
+						}
+					}
+				}
+
+				if( iResult==0 && uiPecSize!=0 )
+				{
+					ucPec = smbus_pec(ucPec, aucRead, sizRead);
+					if( ucPec!=aucRead[sizRead] )
+					{
+						if( ptState->ulVerbose!=0U )
+						{
+							uprintf("PEC mismatch: expected 0x%02x, received 0x%02x.\n", ucPec, aucRead[sizRead]);
+						}
+						ptState->tError = I2C_SEQ_ERROR_PecMismatch;
+						iResult = -1;
+					}
+				}
+
+				if( iResult==0 )
+				{
+					if( ptState->ulVerbose!=0U )
+					{
+						hexdump(aucRead, sizRead);
+					}
+
+					/* Fill the unused part of a block with 0. */
+					memcpy(ptState->pucRecCnt, aucRead, sizRead);
+					memset(ptState->pucRecCnt + sizRead, 0, uiReadSize - sizRead);
+					ptState->pucRecCnt += uiReadSize;
+				}
+			}
+
+			if( iResult!=0 )
+			{
+				/* Errors from the driver have no error class yet. */
+				if( ptState->tError==I2C_SEQ_ERROR_None )
+				{
+					set_driver_error(ptState, ptHandle, iResult);
+				}
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("The SMBus transaction failed.\n");
+				}
+			}
+			else
+			{
+				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_SMBUS_T) + uiWriteSize;
+			}
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* Read a register of the size "sizData" at the register address in
+ * "pucRegister". This is a write of the register address followed by a
+ * repeated START and the read.
+ */
+static int rmw_read_register(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle, unsigned char ucAddress, unsigned int uiAckPoll, const unsigned char *pucRegister, unsigned int sizRegister, unsigned char *pucData, unsigned int sizData)
+{
+	int iResult;
+	int iConditions;
+	ACK_POLL_STATE_T tAckPoll;
+
+
+	iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start, ucAddress);
+	mux_cache_invalidate(ptHandle, iConditions, ucAddress);
+	ack_poll_start(ptState, &tAckPoll);
+	do
+	{
+		iResult = I2C_SEND(ptHandle, iConditions, uiAckPoll, sizRegister, pucRegister);
+	} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+	if( iResult==0 )
+	{
+		iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Stop, ucAddress);
+		iResult = I2C_RECV(ptHandle, iConditions, 0, sizData, pucData);
+	}
+
+	return iResult;
+}
+
+
+
+static int command_rmw(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_RMW_T *ptCmd;
+	unsigned int uiFlags;
+	unsigned int sizRegister;
+	unsigned int sizData;
+	unsigned int uiAckPoll;
+	unsigned int uiOld;
+	unsigned int uiNew;
+	int iConditions;
+	ACK_POLL_STATE_T tAckPoll;
+	/* The register address followed by the data. */
+	unsigned char aucBuffer[4];
+	unsigned char aucRead[2];
+
+
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_RMW_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the RMW command left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+		iResult = -1;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_RMW_T*)(ptState->pucCmdCnt);
+		uiFlags = ptCmd->s.ucFlags;
+		uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+
+		/* Get the register address with the most significant byte first. */
+		if( (uiFlags&I2C_RMW_FLAGS_Register16)!=0 )
+		{
+			aucBuffer[0] = (unsigned char)(ptCmd->s.usRegister >> 8U);
+			aucBuffer[1] = (unsigned char)(ptCmd->s.usRegister & 0xffU);
+			sizRegister = 2;
+		}
+		else
+		{
+			aucBuffer[0] = (unsigned char)(ptCmd->s.usRegister & 0xffU);
+			sizRegister = 1;
+		}
+		sizData = ((uiFlags&I2C_RMW_FLAGS_Data16)!=0) ? 2U : 1U;
+
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("RMW address 0x%02x, register 0x%04x, AND 0x%04x, OR 0x%04x, XOR 0x%04x\n", ptCmd->s.ucAddress, ptCmd->s.usRegister, ptCmd->s.usAndMask, ptCmd->s.usOrMask, ptCmd->s.usXorMask);
+		}
+
+		/* Read the current value. */
+		iResult = rmw_read_register(ptState, ptHandle, ptCmd->s.ucAddress, uiAckPoll, aucBuffer, sizRegister, aucRead, sizData);
+		if( iResult==0 )
+		{
+			if( sizData==1 )
+			{
+				uiOld = aucRead[0];
+			}
+			else if( (uiFlags&I2C_RMW_FLAGS_DataLsbFirst)!=0 )
+			{
+				uiOld = aucRead[0] | ((unsigned int)aucRead[1] << 8U);
+			}
+			else
+			{
+				uiOld = ((unsigned int)aucRead[0] << 8U) | aucRead[1];
+			}
+
+			/* Apply the masks. */
+			uiNew  = uiOld & ptCmd->s.usAndMask;
+			uiNew |= ptCmd->s.usOrMask;
+			uiNew ^= ptCmd->s.usXorMask;
+			if( sizData==1 )
+			{
+				uiNew &= 0xffU;
+				aucBuffer[sizRegister] = (unsigned char)uiNew;
+			}
+			else if( (uiFlags&I2C_RMW_FLAGS_DataLsbFirst)!=0 )
+			{
+				aucBuffer[sizRegister] = (unsigned char)(uiNew & 0xffU);
+				aucBuffer[sizRegister+1] = (unsigned char)(uiNew >> 8U);
+			}
+			else
+			{
+				aucBuffer[sizRegister] = (unsigned char)(uiNew >> 8U);
+				aucBuffer[sizRegister+1] = (unsigned char)(uiNew & 0xffU);
+			}
+
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("RMW 0x%04x -> 0x%04x\n", uiOld, uiNew);
+			}
+
+			/* Write back the register address and the new value. */
+			iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Stop, ptCmd->s.ucAddress);
+			mux_cache_invalidate(ptHandle, iConditions, ptCmd->s.ucAddress);
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_SEND(ptHandle, iConditions, uiAckPoll, sizRegister + sizData, aucBuffer);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+		}
+
+		if( iResult==0 && (uiFlags&I2C_RMW_FLAGS_Verify)!=0 )
+		{
+			iResult = rmw_read_register(ptState, ptHandle, ptCmd->s.ucAddress, uiAckPoll, aucBuffer, sizRegister, aucRead, sizData);
+			if( iResult==0 )
+			{
+				if( memcmp(aucRead, aucBuffer + sizRegister, sizData)!=0 )
+				{
+					if( ptState->ulVerbose!=0U )
+					{
+						uprintf("The read back value differs from the written value.\n");
+						hexdump(aucRead, sizData);
+					}
+					ptState->tError = I2C_SEQ_ERROR_VerifyFailed;
+					iResult = -1;
+				}
+			}
+		}
+
+		if( iResult!=0 )
+		{
+			/* Errors from the driver have no error class yet. */
+			if( ptState->tError==I2C_SEQ_ERROR_None )
+			{
+				set_driver_error(ptState, ptHandle, iResult);
+			}
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("The RMW command failed.\n");
+			}
+		}
+		else
+		{
+			ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_RMW_T);
+		}
+	}
+
+	return iResult;
+}
+
+
+
+static int command_ack_poll_policy(CMD_STATE_T *ptState)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_ACK_POLL_POLICY_T *ptCmd;
+
+
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_ACK_POLL_POLICY_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the ACK poll policy command left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+		iResult = -1;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_ACK_POLL_POLICY_T*)(ptState->pucCmdCnt);
+
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("ACK poll budget %d ms, backoff %d-%d ms\n", ptCmd->s.usBudgetMs, ptCmd->s.usBackoffMs, ptCmd->s.usBackoffMaxMs);
+		}
+
+		ptState->tAckPollPolicy.ulBudgetMs = ptCmd->s.usBudgetMs;
+		ptState->tAckPollPolicy.ulBackoffMs = ptCmd->s.usBackoffMs;
+		ptState->tAckPollPolicy.ulBackoffMaxMs = ptCmd->s.usBackoffMaxMs;
+		iResult = 0;
+		ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_ACK_POLL_POLICY_T);
+	}
+
+	return iResult;
+}
+
+
+
+static int command_read_to(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_READ_TO_T *ptCmd;
+	I2C_READ_DESTINATION_T tDestination;
+	unsigned long ulDataSize;
+	unsigned char *pucData;
+	int iConditions;
+	unsigned int uiAckPoll;
+	ACK_POLL_STATE_T tAckPoll;
+
+
+	iResult = -1;
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_READ_TO_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the read command left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_READ_TO_T*)(ptState->pucCmdCnt);
+		ulDataSize = ptCmd->s.usDataSize;
+		tDestination = (I2C_READ_DESTINATION_T)(ptCmd->s.ucDestination);
+
+		/* Get the destination of the data. */
+		pucData = NULL;
+		switch( tDestination )
+		{
+		case I2C_READ_DESTINATION_Append:
+			if( ulDataSize>(unsigned long)(ptState->pucRecEnd - ptState->pucRecCnt) )
+			{
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("Not enough data for the receive data left.\n");
+				}
+				ptState->tError = I2C_SEQ_ERROR_RxOverflow;
+			}
+			else
+			{
+				pucData = ptState->pucRecCnt;
+				iResult = 0;
+			}
+			break;
+
+		case I2C_READ_DESTINATION_Discard:
+			iResult = 0;
+			break;
+
+		case I2C_READ_DESTINATION_Slot:
+			if( (ptCmd->s.usSlotOffset + ulDataSize)>ptState->sizSlotArea )
+			{
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("The slot at offset 0x%04x with %d bytes exceeds the slot area.\n", ptCmd->s.usSlotOffset, ulDataSize);
+				}
+				ptState->tError = I2C_SEQ_ERROR_InvalidParameter;
+			}
+			else
+			{
+				pucData = ptState->pucSlotArea + ptCmd->s.usSlotOffset;
+				iResult = 0;
+			}
+			break;
+		}
+		if( iResult!=0 && ptState->tError==I2C_SEQ_ERROR_None )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Invalid destination: %d\n", tDestination);
+			}
+			ptState->tError = I2C_SEQ_ERROR_InvalidParameter;
+		}
+
+		if( iResult==0 )
+		{
+			iConditions = get_driver_conditions(ptCmd->s.ucConditions, ptCmd->s.ucAddress);
+			uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("READ from address 0x%02x, %d retries, %d bytes to destination %d\n", ptCmd->s.ucAddress, uiAckPoll, ulDataSize, tDestination);
+			}
+
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_RECV(ptHandle, iConditions, uiAckPoll, ulDataSize, pucData);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+			if( iResult!=0 )
+			{
+				set_driver_error(ptState, ptHandle, iResult);
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("The I2C receive operation failed.\n");
+				}
+			}
+			else
+			{
+				if( tDestination==I2C_READ_DESTINATION_Append )
+				{
+					ptState->pucRecCnt += ulDataSize;
+				}
+				else if( tDestination==I2C_READ_DESTINATION_Slot )
+				{
+					ptState->pucSlotData = pucData;
+					ptState->sizSlotData = ulDataSize;
+				}
+				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_READ_TO_T);
+			}
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* The tag of a snapshot marks it as valid for the address and the size.
+ * The host clears the snapshot area to invalidate all snapshots.
+ */
+#define READ_DELTA_TAG(ucAddress, usSize) (0x44000000U | ((unsigned long)(ucAddress)<<16U) | (unsigned long)(usSize))
+
+static int command_read_delta(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_READ_DELTA_T *ptCmd;
+	unsigned int sizData;
+	unsigned int sizBitmap;
+	unsigned int sizChanged;
+	unsigned int uiCnt;
+	unsigned int uiAckPoll;
+	unsigned long ulTag;
+	unsigned long *pulTag;
+	unsigned char *pucSnapshot;
+	unsigned char *pucData;
+	unsigned char *pucOut;
+	unsigned char aucBitmap[I2C_READ_DELTA_MAX/8U];
+	ACK_POLL_STATE_T tAckPoll;
+
+
+	iResult = -1;
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_READ_DELTA_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the delta read command left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_READ_DELTA_T*)(ptState->pucCmdCnt);
+		sizData = ptCmd->s.usDataSize;
+		uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+
+		/* The snapshot must be 32 bit aligned and inside the snapshot area. */
+		if( sizData==0 || sizData>I2C_READ_DELTA_MAX || (ptCmd->s.usSnapshotOffset&3U)!=0 || ptState->pucSnapshot==NULL || (ptCmd->s.usSnapshotOffset + 4U + sizData)>ptState->sizSnapshot )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Invalid delta read: %d bytes, snapshot at offset 0x%04x.\n", sizData, ptCmd->s.usSnapshotOffset);
+			}
+			ptState->tError = I2C_SEQ_ERROR_InvalidParameter;
+		}
+		/* The result needs the header byte and at most the full data. */
+		else if( (1U + sizData)>(unsigned long)(ptState->pucRecEnd - ptState->pucRecCnt) )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("Not enough data for the receive data left.\n");
+			}
+			ptState->tError = I2C_SEQ_ERROR_RxOverflow;
+		}
+		else
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("READ DELTA from address 0x%02x, %d retries, %d bytes, snapshot at offset 0x%04x\n", ptCmd->s.ucAddress, uiAckPoll, sizData, ptCmd->s.usSnapshotOffset);
+			}
+
+			/* Receive the data behind the header byte. */
+			pucData = ptState->pucRecCnt + 1U;
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_RECV(ptHandle, get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Stop, ptCmd->s.ucAddress), uiAckPoll, sizData, pucData);
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+			if( iResult!=0 )
+			{
+				set_driver_error(ptState, ptHandle, iResult);
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("The I2C receive operation failed.\n");
+				}
+			}
+			else
+			{
+				pulTag = (unsigned long*)(ptState->pucSnapshot + ptCmd->s.usSnapshotOffset);
+				pucSnapshot = (unsigned char*)(pulTag + 1);
+				ulTag = READ_DELTA_TAG(ptCmd->s.ucAddress, sizData);
+
+				/* Compare the data with the snapshot and update it. */
+				sizBitmap = (sizData + 7U) / 8U;
+				memset(aucBitmap, 0, sizBitmap);
+				sizChanged = 0;
+				for(uiCnt=0; uiCnt<sizData; ++uiCnt)
+				{
+					if( pucData[uiCnt]!=pucSnapshot[uiCnt] )
+					{
+						aucBitmap[uiCnt>>3U] |= (unsigned char)(1U << (uiCnt&7U));
+						pucSnapshot[uiCnt] = pucData[uiCnt];
+						++sizChanged;
+					}
+				}
+
+				if( *pulTag!=ulTag || (sizBitmap + sizChanged)>=sizData )
+				{
+					/* The data is already in place. */
+					*pulTag = ulTag;
+					ptState->pucRecCnt[0] = I2C_READ_DELTA_Full;
+					ptState->pucRecCnt += 1U + sizData;
+				}
+				else if( sizChanged==0 )
+				{
+					ptState->pucRecCnt[0] = I2C_READ_DELTA_Unchanged;
+					ptState->pucRecCnt += 1U;
+				}
+				else
+				{
+					/* Move the changed bytes to the front. Then make room
+					 * for the bitmap. The changed bytes are less than the
+					 * data, so the result still fits.
+					 */
+					pucOut = pucData;
+					for(uiCnt=0; uiCnt<sizData; ++uiCnt)
+					{
+						if( (aucBitmap[uiCnt>>3U]&(1U<<(uiCnt&7U)))!=0 )
+						{
+							*(pucOut++) = pucData[uiCnt];
+						}
+					}
+					memmove(pucData + sizBitmap, pucData, sizChanged);
+					memcpy(pucData, aucBitmap, sizBitmap);
+					ptState->pucRecCnt[0] = I2C_READ_DELTA_Changed;
+					ptState->pucRecCnt += 1U + sizBitmap + sizChanged;
+				}
+
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("%d bytes changed.\n", sizChanged);
+				}
+				ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_READ_DELTA_T);
+			}
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* Select the channels of a multiplexer. The write is skipped if the cache
+ * of the handle shows that the channels are already selected. A new
+ * multiplexer gets a free cache entry. If all entries are in use, the
+ * channels are written every time.
+ */
+static int command_mux_select(CMD_STATE_T *ptState, I2C_HANDLE_T *ptHandle)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_MUX_SELECT_T *ptCmd;
+	I2C_MUX_CACHE_T *ptEntry;
+	int iConditions;
+	unsigned int uiAckPoll;
+	ACK_POLL_STATE_T tAckPoll;
+
+
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_MUX_SELECT_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the mux select command left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+		iResult = -1;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_MUX_SELECT_T*)(ptState->pucCmdCnt);
+
+		iResult = 0;
+		ptEntry = mux_cache_find(ptHandle, ptCmd->s.ucAddress);
+		if( ptEntry!=NULL && ptEntry->ucChannels==ptCmd->s.ucChannels && (ptCmd->s.ucFlags&I2C_MUX_SELECT_FLAGS_Force)==0 )
+		{
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("MUX 0x%02x already selects channels 0x%02x\n", ptCmd->s.ucAddress, ptCmd->s.ucChannels);
+			}
+		}
+		else
+		{
+			iConditions = get_driver_conditions(I2C_SEQ_CONDITION_Start|I2C_SEQ_CONDITION_Stop, ptCmd->s.ucAddress);
+			uiAckPoll = (unsigned int)(ptCmd->s.ucAckPoll);
+
+			if( ptState->ulVerbose!=0U )
+			{
+				uprintf("MUX 0x%02x select channels 0x%02x, %d retries\n", ptCmd->s.ucAddress, ptCmd->s.ucChannels, uiAckPoll);
+			}
+
+			/* The state of the multiplexer is unknown until the write succeeded. */
+			if( ptEntry==NULL )
+			{
+				ptEntry = mux_cache_find(ptHandle, 0xffU);
+			}
+			if( ptEntry!=NULL )
+			{
+				ptEntry->ucAddress = 0xffU;
+			}
+
+			ack_poll_start(ptState, &tAckPoll);
+			do
+			{
+				iResult = I2C_SEND(ptHandle, iConditions, uiAckPoll, 1U, &(ptCmd->s.ucChannels));
+			} while( ack_poll_retry(ptState, &tAckPoll, iResult)!=0 );
+			if( iResult!=0 )
+			{
+				set_driver_error(ptState, ptHandle, iResult);
+				if( ptState->ulVerbose!=0U )
+				{
+					uprintf("Failed to select the channels of the multiplexer.\n");
+				}
+			}
+			else if( ptEntry!=NULL )
+			{
+				ptEntry->ucAddress = ptCmd->s.ucAddress;
+				ptEntry->ucChannels = ptCmd->s.ucChannels;
+			}
+		}
+
+		if( iResult==0 )
+		{
+			ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_MUX_SELECT_T);
+		}
+	}
+
+	return iResult;
+}
+
+
+
+static int command_delay(CMD_STATE_T *ptState)
+{
+	int iResult;
+	const I2C_SEQ_COMMAND_DELAY_T *ptCmd;
+
+
+	if( (ptState->pucCmdCnt + sizeof(I2C_SEQ_COMMAND_DELAY_T))>ptState->pucCmdEnd )
+	{
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("Not enough data for the delay command left.\n");
+		}
+		ptState->tError = I2C_SEQ_ERROR_CommandTruncated;
+		iResult = -1;
+	}
+	else
+	{
+		ptCmd = (const I2C_SEQ_COMMAND_DELAY_T*)(ptState->pucCmdCnt);
+
+		if( ptState->ulVerbose!=0U )
+		{
+			uprintf("I2C_COMMAND_Delay %d ms\n", ptCmd->s.ulDelayInMs);
+		}
+
+		systime_delay_ms(ptCmd->s.ulDelayInMs);
+		iResult = 0;
+		ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_DELAY_T);
+	}
+
+	return iResult;
+}
+
+
+
+typedef struct I2C_INTERFACE_NAME_LOOKUP_STRUCT
+{
+	I2C_SETUP_CORE_T tID;
+	const char *pcName;
+} I2C_INTERFACE_NAME_LOOKUP_T;
+
+static const I2C_INTERFACE_NAME_LOOKUP_T atI2cInterfaceNameLookup[] =
+{
+	{
+		.tID = I2C_SETUP_CORE_RAPI2C0,
+		.pcName = "RAP_I2C0"
+	},
+	{
+		.tID = I2C_SETUP_CORE_RAPI2C1,
+		.pcName = "RAP_I2C1"
+	},
+	{
+		.tID = I2C_SETUP_CORE_RAPI2C2,
+		.pcName = "RAP_I2C2"
+	},
+	{
+		.tID = I2C_SETUP_CORE_RAPI2C3,
+		.pcName = "RAP_I2C3"
+	},
+	{
+		.tID = I2C_SETUP_CORE_RAPI2C4,
+		.pcName = "RAP_I2C4"
+	},
+	{
+		.tID = I2C_SETUP_CORE_RAPI2C5,
+		.pcName = "RAP_I2C5"
+	},
+	{
+		.tID = I2C_SETUP_CORE_I2C0,
+		.pcName = "I2C0"
+	},
+	{
+		.tID = I2C_SETUP_CORE_I2C1,
+		.pcName = "I2C1"
+	},
+	{
+		.tID = I2C_SETUP_CORE_I2C2,
+		.pcName = "I2C2"
+	}
+};
+
+
+static const char *getInterfaceName(I2C_SETUP_CORE_T tCore)
+{
+	const I2C_INTERFACE_NAME_LOOKUP_T *pcCnt;
+	const I2C_INTERFACE_NAME_LOOKUP_T *pcEnd;
+	const char *pcName;
+
+
+	pcName = "Unknown";
+
+	pcCnt = atI2cInterfaceNameLookup;
+	pcEnd = atI2cInterfaceNameLookup + (sizeof(atI2cInterfaceNameLookup)/sizeof(atI2cInterfaceNameLookup[0]));
+	while( pcCnt<pcEnd )
+	{
+		if( pcCnt->tID==tCore )
+		{
+			pcName = pcCnt->pcName;
+			break;
+		}
+		++pcCnt;
+	};
+
+	return pcName;
+}
+
+
+
+static TEST_RESULT_T processCommandOpen(unsigned long ulVerbose, I2C_PARAMETER_OPEN_T *ptParameter)
+{
+	TEST_RESULT_T tResult;
+	int iResult;
+	I2C_SETUP_T tI2CSetup;
+	I2C_SETUP_CORE_T tCore;
+	I2C_HANDLE_T *ptHandle;
+	const char *pcIfName;
+
+
+	/* Check the parameter. */
+	tResult = TEST_RESULT_ERROR;
+	tCore = (I2C_SETUP_CORE_T)(ptParameter->usI2CCore);
+	switch(tCore)
+	{
+	case I2C_SETUP_CORE_RAPI2C0:
+	case I2C_SETUP_CORE_RAPI2C1:
+	case I2C_SETUP_CORE_RAPI2C2:
+	case I2C_SETUP_CORE_RAPI2C3:
+	case I2C_SETUP_CORE_RAPI2C4:
+	case I2C_SETUP_CORE_RAPI2C5:
+	case I2C_SETUP_CORE_I2C0:
+	case I2C_SETUP_CORE_I2C1:
+	case I2C_SETUP_CORE_I2C2:
+		tResult = TEST_RESULT_OK;
+		break;
+	}
+	if( tResult!=TEST_RESULT_OK )
+	{
+		uprintf("Invalid core selected: %d\n", tCore);
+	}
+	else
+	{
+		tI2CSetup.tI2CCore = tCore;
+		tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SCL] = ptParameter->ucMMIOIndexSCL;
+		tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SDA] = ptParameter->ucMMIOIndexSDA;
+		tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SCL] = ptParameter->usPortcontrolSCL;
+		tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SDA] = ptParameter->usPortcontrolSDA;
+		tI2CSetup.ulClockStretchMs = ptParameter->usClockStretchMs;
+
+		if( ulVerbose!=0 )
+		{
+			pcIfName = getInterfaceName(tCore);
+			uprintf("Setup interface %s with MMIOs %d/%d and port control 0x%04x/0x%04x.\n",
+			        pcIfName,
+			        tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SCL],
+				tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SDA],
+				tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SCL],
+				tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SDA]
+			);
+		}
+
+		ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
+		if( is_valid_buffer(ptHandle, sizeof(I2C_HANDLE_T))==0 )
+		{
+			tResult = TEST_RESULT_ERROR;
+		}
+		else
+		{
+			iResult = i2c_core_hsoc_v2_init(&tI2CSetup, ptHandle);
+			if( iResult!=0 )
+			{
+				uprintf("Failed to setup the I2C core.\n");
+				tResult = TEST_RESULT_ERROR;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+static int TCM_CODE processCommandSequence(unsigned long ulVerbose, I2C_PARAMETER_RUN_SEQUENCE_T *ptParameter)
+{
+	int iResult;
+	CMD_STATE_T tState;
+	unsigned char ucData;
+	I2C_SEQ_COMMAND_T tCmd;
+	unsigned int uiDataSize;
+	I2C_HANDLE_T *ptHandle;
+	const unsigned char *pucCmdStart;
+	unsigned long ulCmdIndex;
+	unsigned char *pucRecStart;
+	unsigned long ulOffsetEntries;
+	I2C_RESULT_OFFSET_T *ptOffset;
+
+
+	/* An empty command is OK. */
+	iResult = 0;
+
+	/* Get the verbose flag. */
+	tState.ulVerbose = ulVerbose;
+	tState.tError = I2C_SEQ_ERROR_None;
+	tState.ulErrorBytes = 0;
+
+	/* The software ACK poll is off by default. */
+	tState.tAckPollPolicy.ulBudgetMs = 0;
+	tState.tAckPollPolicy.ulBackoffMs = 0;
+	tState.tAckPollPolicy.ulBackoffMaxMs = 0;
+
+	/* Get the snapshot area for the ReadDelta commands. */
+	tState.pucSnapshot = ptParameter->pucSnapshot;
+	tState.sizSnapshot = ptParameter->sizSnapshot;
+
+	/* The slots of the ReadTo commands are in front of the other received
+	 * data.
+	 */
+	tState.pucSlotArea = ptParameter->pucReceivedData;
+	tState.sizSlotArea = ptParameter->sizSlotArea;
+	tState.pucSlotData = NULL;
+	tState.sizSlotData = 0;
+	ulOffsetEntries = 0;
+
+	/* Get the handle. */
+	ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
+
+	/* Loop over all commands. Start at the resume offset. */
+	tState.pucCmdCnt = ptParameter->pucCommand + ptParameter->ulResumeOffset;
+	tState.pucCmdEnd = ptParameter->pucCommand + ptParameter->sizCommand;
+	tState.pucRecCnt = ptParameter->pucReceivedData;
+	tState.pucRecEnd = tState.pucRecCnt + ptParameter->sizReceivedDataMax;
+	pucCmdStart = tState.pucCmdCnt;
+	ulCmdIndex = ptParameter->ulResumeIndex;
+	if( tState.ulVerbose!=0U )
+	{
+		uprintf("Running command [0x%08x, 0x%08x[.\n", (unsigned long)tState.pucCmdCnt, (unsigned long)tState.pucCmdEnd);
+	}
+
+	if( ptParameter->ulResumeOffset>ptParameter->sizCommand )
+	{
+		uprintf("The resume offset 0x%08x exceeds the sequence.\n", ptParameter->ulResumeOffset);
+		tState.tError = I2C_SEQ_ERROR_InvalidParameter;
+		iResult = -1;
+	}
+	else if( is_valid_buffer(ptHandle, sizeof(I2C_HANDLE_T))==0 ||
+	         is_valid_buffer(ptParameter->pucCommand, ptParameter->sizCommand)==0 ||
+	         is_valid_buffer(ptParameter->pucReceivedData, ptParameter->sizReceivedDataMax)==0 ||
+	         (ptParameter->pucPackedData!=NULL && is_valid_buffer(ptParameter->pucPackedData, ptParameter->sizPackedDataMax)==0) ||
+	         (ptParameter->pucSnapshot!=NULL && (ptParameter->sizSnapshot>I2C_SNAPSHOT_AREA_SIZE || is_valid_buffer(ptParameter->pucSnapshot, ptParameter->sizSnapshot)==0)) ||
+	         (ptParameter->ptOffsetTable!=NULL && (ptParameter->ulOffsetEntriesMax>(0xffffffffU/sizeof(I2C_RESULT_OFFSET_T)) || is_valid_buffer(ptParameter->ptOffsetTable, ptParameter->ulOffsetEntriesMax*sizeof(I2C_RESULT_OFFSET_T))==0)) )
+	{
+		tState.tError = I2C_SEQ_ERROR_InvalidParameter;
+		iResult = -1;
+	}
+	else if( ptParameter->sizSlotArea>ptParameter->sizReceivedDataMax )
+	{
+		uprintf("The slot area with %d bytes exceeds the received data.\n", ptParameter->sizSlotArea);
+		tState.tError = I2C_SEQ_ERROR_InvalidParameter;
+		iResult = -1;
+	}
+	else
+	{
+		tState.pucRecCnt += ptParameter->sizSlotArea;
+
+		while( tState.pucCmdCnt<tState.pucCmdEnd )
+		{
+			/* Remember the start of the command for the error record. */
+			pucCmdStart = tState.pucCmdCnt;
+
+			/* Remember the start of the data for the offset table. */
+			pucRecStart = tState.pucRecCnt;
+			tState.pucSlotData = NULL;
+
+			/* Get the next command. */
+			iResult = -1;
+			ucData = *(tState.pucCmdCnt++);
+			tCmd = (I2C_SEQ_COMMAND_T)ucData;
+			switch( tCmd )
+			{
+			case I2C_SEQ_COMMAND_Read:
+			case I2C_SEQ_COMMAND_Write:
+			case I2C_SEQ_COMMAND_Delay:
+			case I2C_SEQ_COMMAND_WriteRle:
+			case I2C_SEQ_COMMAND_AckPollPolicy:
+			case I2C_SEQ_COMMAND_WriteMulti:
+			case I2C_SEQ_COMMAND_Smbus:
+			case I2C_SEQ_COMMAND_Rmw:
+			case I2C_SEQ_COMMAND_ReadExt:
+			case I2C_SEQ_COMMAND_WriteExt:
+			case I2C_SEQ_COMMAND_ReadDelta:
+			case I2C_SEQ_COMMAND_ReadTo:
+			case I2C_SEQ_COMMAND_MuxSelect:
+				iResult = 0;
+				break;
+			}
+			if( iResult!=0 )
+			{
+				uprintf("Invalid command: 0x%02x\n", ucData);
+				tState.tError = I2C_SEQ_ERROR_InvalidCommand;
+				break;
+			}
+			else
+			{
+				switch( tCmd )
+				{
+				case I2C_SEQ_COMMAND_Read:
+					iResult = command_read(&tState, ptHandle, 0);
+					break;
+
+				case I2C_SEQ_COMMAND_Write:
+					iResult = command_write(&tState, ptHandle, 0);
+					break;
+
+				case I2C_SEQ_COMMAND_Delay:
+					iResult = command_delay(&tState);
+					break;
+
+				case I2C_SEQ_COMMAND_WriteRle:
+					iResult = command_write_rle(&tState, ptHandle);
+					break;
+
+				case I2C_SEQ_COMMAND_AckPollPolicy:
+					iResult = command_ack_poll_policy(&tState);
+					break;
+
+				case I2C_SEQ_COMMAND_WriteMulti:
+					iResult = command_write_multi(&tState, ptHandle);
+					break;
+
+				case I2C_SEQ_COMMAND_Smbus:
+					iResult = command_smbus(&tState, ptHandle);
+					break;
+
+				case I2C_SEQ_COMMAND_Rmw:
+					iResult = command_rmw(&tState, ptHandle);
+					break;
+
+				case I2C_SEQ_COMMAND_ReadExt:
+					iResult = command_read(&tState, ptHandle, 1);
+					break;
+
+				case I2C_SEQ_COMMAND_WriteExt:
+					iResult = command_write(&tState, ptHandle, 1);
+					break;
+
+				case I2C_SEQ_COMMAND_ReadDelta:
+					iResult = command_read_delta(&tState, ptHandle);
+					break;
+
+				case I2C_SEQ_COMMAND_ReadTo:
+					iResult = command_read_to(&tState, ptHandle);
+					break;
+
+				case I2C_SEQ_COMMAND_MuxSelect:
+					iResult = command_mux_select(&tState, ptHandle);
+					break;
+				}
+				if( iResult!=0 )
+				{
+					if( tState.ulVerbose!=0U )
+					{
+						uprintf("The command failed. Stopping execution of the sequence.\n");
+					}
+					break;
+				}
+			}
+
+			/* Add the data of the command to the offset table. */
+			if( ptParameter->ptOffsetTable!=NULL && ulOffsetEntries<ptParameter->ulOffsetEntriesMax )
+			{
+				ptOffset = ptParameter->ptOffsetTable + ulOffsetEntries;
+				if( tState.pucSlotData!=NULL )
+				{
+					ptOffset->ulOffset = (uint32_t)(tState.pucSlotData - ptParameter->pucReceivedData);
+					ptOffset->ulSize = tState.sizSlotData;
+				}
+				else
+				{
+					ptOffset->ulOffset = (uint32_t)(pucRecStart - ptParameter->pucReceivedData);
+					ptOffset->ulSize = (uint32_t)(tState.pucRecCnt - pucRecStart);
+				}
+			}
+			++ulOffsetEntries;
+
+			++ulCmdIndex;
+		}
+	}
+
+	/* Set the size of the result data. This is also valid for a failed
+	 * sequence. It covers all commands before the failed one.
+	 */
+	uiDataSize = (unsigned int)(tState.pucRecCnt-ptParameter->pucReceivedData);
+	if( uiDataSize<=ptParameter->sizReceivedDataMax )
+	{
+		ptParameter->sizReceivedData = uiDataSize;
+	}
+	else
+	{
+		iResult = -1;
+	}
+
+	/* Fill the error record. The host can resume the sequence at the failed command. */
+	if( tState.tError==I2C_SEQ_ERROR_None )
+	{
+		pucCmdStart = tState.pucCmdCnt;
+	}
+	ptParameter->ulErrorClass = (uint32_t)tState.tError;
+	ptParameter->ulErrorOffset = (uint32_t)(pucCmdStart - ptParameter->pucCommand);
+	ptParameter->ulErrorIndex = ulCmdIndex;
+	ptParameter->ulErrorBytes = tState.ulErrorBytes;
+	ptParameter->ulOffsetEntries = ulOffsetEntries;
+
+	ptParameter->sizPackedData = 0;
+	if( iResult==0 )
+	{
+		/* Pack the received data if requested.
+		 * The size is 0 if the packed data does not fit into the buffer.
+		 * In this case the host reads the raw data.
+		 */
+		if( ptParameter->pucPackedData!=NULL )
+		{
+			ptParameter->sizPackedData = rle_encode(ptParameter->pucReceivedData, ptParameter->sizReceivedData, ptParameter->pucPackedData, ptParameter->sizPackedDataMax);
+			if( tState.ulVerbose!=0U )
+			{
+				uprintf("Packed %d bytes of received data to %d bytes.\n", ptParameter->sizReceivedData, ptParameter->sizPackedData);
+			}
+		}
+	}
+
+	return iResult;
+}
+
+
+
+static int processCommandScan(unsigned long ulVerbose, I2C_PARAMETER_SCAN_T *ptParameter)
+{
+	int iResult;
+	I2C_HANDLE_T *ptHandle;
+	unsigned int uiAddress;
+	unsigned int uiLastAddress;
+	unsigned int uiAckPoll;
+	unsigned char *pucBitmap;
+	unsigned long ulDevicesFound;
+
+
+	ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
+	uiAckPoll = (unsigned int)(ptParameter->ulAckPoll);
+	uiAddress = (unsigned int)(ptParameter->ulFirstAddress);
+	uiLastAddress = (unsigned int)(ptParameter->ulLastAddress);
+	pucBitmap = ptParameter->pucPresenceBitmap;
+
+	if( uiAddress>uiLastAddress || uiLastAddress>0x7fU )
+	{
+		uprintf("Invalid scan range: 0x%02x-0x%02x\n", uiAddress, uiLastAddress);
+		iResult = -1;
+	}
+	else if( is_valid_buffer(ptHandle, sizeof(I2C_HANDLE_T))==0 || is_valid_buffer(pucBitmap, 16)==0 )
+	{
+		iResult = -1;
+	}
+	else
+	{
+		memset(pucBitmap, 0, 16);
+		ulDevicesFound = 0;
+		iResult = 0;
+
+		while( uiAddress<=uiLastAddress )
+		{
+			iResult = I2C_PROBE(ptHandle, uiAddress, uiAckPoll);
+			if( iResult!=I2C_RESULT_Ok && iResult!=I2C_RESULT_NakAddress )
+			{
+				uprintf("Failed to probe address 0x%02x.\n", uiAddress);
+				break;
+			}
+			else if( iResult==I2C_RESULT_Ok )
+			{
+				if( ulVerbose!=0U )
+				{
+					uprintf("Found a device at address 0x%02x.\n", uiAddress);
+				}
+				pucBitmap[uiAddress>>3U] |= (unsigned char)(1U << (uiAddress&7U));
+				++ulDevicesFound;
+			}
+			iResult = 0;
+			++uiAddress;
 		}
 
-		systime_delay_ms(ptCmd->s.ulDelayInMs);
-		iResult = 0;
-		ptState->pucCmdCnt += sizeof(I2C_SEQ_COMMAND_DELAY_T);
+		ptParameter->ulDevicesFound = ulDevicesFound;
 	}
 
 	return iResult;
@@ -298,238 +2202,325 @@ static int command_delay(CMD_STATE_T *ptState)
 
 
 
-typedef struct I2C_INTERFACE_NAME_LOOKUP_STRUCT
+/* Measure the throughput between 2 cores which are wired back to back. */
+static int processCommandBenchmark(unsigned long ulVerbose, I2C_PARAMETER_BENCHMARK_T *ptParameter)
 {
-	I2C_SETUP_CORE_T tID;
-	const char *pcName;
-} I2C_INTERFACE_NAME_LOOKUP_T;
+	int iResult;
+	I2C_HANDLE_T *ptHandle;
+	I2C_HANDLE_T *ptSlaveHandle;
+	unsigned int sizTransfer;
+	unsigned int uiSpeed;
+	unsigned int uiResults;
+	unsigned long ulResults;
 
-static const I2C_INTERFACE_NAME_LOOKUP_T atI2cInterfaceNameLookup[] =
-{
-	{
-		.tID = I2C_SETUP_CORE_RAPI2C0,
-		.pcName = "RAP_I2C0"
-	},
-	{
-		.tID = I2C_SETUP_CORE_RAPI2C1,
-		.pcName = "RAP_I2C1"
-	},
-	{
-		.tID = I2C_SETUP_CORE_RAPI2C2,
-		.pcName = "RAP_I2C2"
-	},
-	{
-		.tID = I2C_SETUP_CORE_RAPI2C3,
-		.pcName = "RAP_I2C3"
-	},
-	{
-		.tID = I2C_SETUP_CORE_RAPI2C4,
-		.pcName = "RAP_I2C4"
-	},
+
+	ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
+	ptSlaveHandle = (I2C_HANDLE_T*)(ptParameter->ptSlaveHandle);
+	sizTransfer = (unsigned int)(ptParameter->ulTransferSize);
+	ptParameter->ulResults = 0;
+
+	/* There is one result for each bit in the speed mask. */
+	uiResults = 0;
+	for(uiSpeed=I2CSPEED_50; uiSpeed<=I2CSPEED_3400; ++uiSpeed)
 	{
-		.tID = I2C_SETUP_CORE_RAPI2C5,
-		.pcName = "RAP_I2C5"
-	},
+		if( (ptParameter->ulSpeedMask&(1U<<uiSpeed))!=0 )
+		{
+			++uiResults;
+		}
+	}
+
+	if( sizTransfer==0 || sizTransfer>255U )
 	{
-		.tID = I2C_SETUP_CORE_I2C0,
-		.pcName = "I2C0"
-	},
+		uprintf("Invalid transfer size: %d\n", sizTransfer);
+		iResult = -1;
+	}
+	else if( is_valid_buffer(ptHandle, sizeof(I2C_HANDLE_T))==0 ||
+	         is_valid_buffer(ptSlaveHandle, sizeof(I2C_HANDLE_T))==0 ||
+	         is_valid_buffer(ptParameter->pucWorkBuffer, 3U*sizTransfer + 1U)==0 ||
+	         is_valid_buffer(ptParameter->ptResults, uiResults*sizeof(I2C_BENCHMARK_RESULT_T))==0 )
 	{
-		.tID = I2C_SETUP_CORE_I2C1,
-		.pcName = "I2C1"
-	},
+		iResult = -1;
+	}
+	else
 	{
-		.tID = I2C_SETUP_CORE_I2C2,
-		.pcName = "I2C2"
+		ulResults = 0;
+		iResult = i2c_benchmark_run(ptHandle, ptSlaveHandle, (unsigned int)(ptParameter->ulSlaveAddress), ptParameter->ulSpeedMask, sizTransfer, ptParameter->ulTransfers, ptParameter->pucWorkBuffer, ptParameter->ptResults, &ulResults, ulVerbose);
+		ptParameter->ulResults = ulResults;
 	}
-};
 
+	return iResult;
+}
 
-static const char *getInterfaceName(I2C_SETUP_CORE_T tCore)
+
+
+static int processCommandCapture(unsigned long ulVerbose, I2C_PARAMETER_CAPTURE_T *ptParameter)
 {
-	const I2C_INTERFACE_NAME_LOOKUP_T *pcCnt;
-	const I2C_INTERFACE_NAME_LOOKUP_T *pcEnd;
-	const char *pcName;
+	int iResult;
+	I2C_HANDLE_T *ptHandle;
+	I2C_CAPTURE_T *ptCapture;
 
 
-	pcName = "Unknown";
+	ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
 
-	pcCnt = atI2cInterfaceNameLookup;
-	pcEnd = atI2cInterfaceNameLookup + (sizeof(atI2cInterfaceNameLookup)/sizeof(atI2cInterfaceNameLookup[0]));
-	while( pcCnt<pcEnd )
+	iResult = 0;
+	if( is_valid_buffer(ptHandle, sizeof(I2C_HANDLE_T))==0 )
 	{
-		if( pcCnt->tID==tCore )
+		iResult = -1;
+	}
+	else if( ptParameter->sizBuffer==0 )
+	{
+		ptHandle->ptCapture = NULL;
+		ptParameter->ulMaxRecords = 0;
+		if( ulVerbose!=0U )
 		{
-			pcName = pcCnt->pcName;
-			break;
+			uprintf("Capture stopped.\n");
 		}
-		++pcCnt;
-	};
+	}
+	else
+	{
+		ptCapture = NULL;
+		if( is_valid_buffer(ptParameter->pucBuffer, ptParameter->sizBuffer)!=0 )
+		{
+			ptCapture = i2c_capture_init(ptParameter->pucBuffer, ptParameter->sizBuffer);
+		}
+		if( ptCapture==NULL )
+		{
+			uprintf("The capture buffer is too small: %d bytes\n", ptParameter->sizBuffer);
+			iResult = -1;
+		}
+		else
+		{
+			ptHandle->ptCapture = ptCapture;
+			ptParameter->ulMaxRecords = ptCapture->tRing.ulMaxRecords;
+			if( ulVerbose!=0U )
+			{
+				uprintf("Capture started with %d records at 0x%08x.\n", ptCapture->tRing.ulMaxRecords, (unsigned long)ptCapture);
+			}
+		}
+	}
 
-	return pcName;
+	return iResult;
 }
 
 
 
-static TEST_RESULT_T processCommandOpen(unsigned long ulVerbose, I2C_PARAMETER_OPEN_T *ptParameter)
+/* These symbols are defined in the linker script. */
+extern unsigned long load_address[];
+extern unsigned long parameter_start_address[];
+
+/* Build the Adler-32 checksum of the memory area. The modulo is only
+ * applied every 5552 bytes, which is the largest block that can not
+ * overflow the sums.
+ * The area must be part of the code between the load address and the
+ * parameter area. This is all the host needs, and it keeps the command
+ * from reading unmapped memory.
+ */
+static int processCommandChecksum(unsigned long ulVerbose, I2C_PARAMETER_CHECKSUM_T *ptParameter)
 {
-	TEST_RESULT_T tResult;
 	int iResult;
-	I2C_SETUP_T tI2CSetup;
-	I2C_SETUP_CORE_T tCore;
-	I2C_HANDLE_T *ptHandle;
-	const char *pcIfName;
-
-
-	/* Check the parameter. */
-	tResult = TEST_RESULT_ERROR;
-	tCore = (I2C_SETUP_CORE_T)(ptParameter->usI2CCore);
-	switch(tCore)
-	{
-	case I2C_SETUP_CORE_RAPI2C0:
-	case I2C_SETUP_CORE_RAPI2C1:
-	case I2C_SETUP_CORE_RAPI2C2:
-	case I2C_SETUP_CORE_RAPI2C3:
-	case I2C_SETUP_CORE_RAPI2C4:
-	case I2C_SETUP_CORE_RAPI2C5:
-	case I2C_SETUP_CORE_I2C0:
-	case I2C_SETUP_CORE_I2C1:
-	case I2C_SETUP_CORE_I2C2:
-		tResult = TEST_RESULT_OK;
-		break;
-	}
-	if( tResult!=TEST_RESULT_OK )
+	const unsigned char *pucCnt;
+	unsigned long ulSizLeft;
+	unsigned long ulSizBlock;
+	unsigned long ulA;
+	unsigned long ulB;
+	unsigned long ulData;
+	unsigned long ulStart;
+	unsigned long ulEnd;
+
+
+	ulData = (unsigned long)(ptParameter->pucData);
+	ulStart = (unsigned long)load_address;
+	ulEnd = (unsigned long)parameter_start_address;
+	if( ulData<ulStart || ulData>ulEnd || ptParameter->sizData>(ulEnd-ulData) )
 	{
-		uprintf("Invalid core selected: %d\n", tCore);
+		uprintf("The checksum area [0x%08x, +0x%08x] is outside of the code [0x%08x, 0x%08x[.\n", ulData, ptParameter->sizData, ulStart, ulEnd);
+		iResult = -1;
 	}
 	else
 	{
-		tI2CSetup.tI2CCore = tCore;
-		tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SCL] = ptParameter->ucMMIOIndexSCL;
-		tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SDA] = ptParameter->ucMMIOIndexSDA;
-		tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SCL] = ptParameter->usPortcontrolSCL;
-		tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SDA] = ptParameter->usPortcontrolSDA;
-
-		if( ulVerbose!=0 )
+		ulA = 1;
+		ulB = 0;
+		pucCnt = ptParameter->pucData;
+		ulSizLeft = ptParameter->sizData;
+		while( ulSizLeft!=0 )
 		{
-			pcIfName = getInterfaceName(tCore);
-			uprintf("Setup interface %s with MMIOs %d/%d and port control 0x%04x/0x%04x.\n",
-			        pcIfName,
-			        tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SCL],
-				tI2CSetup.aucMmioIndex[I2C_SETUP_PIN_INDEX_SDA],
-				tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SCL],
-				tI2CSetup.ausPortControl[I2C_SETUP_PIN_INDEX_SDA]
-			);
+			ulSizBlock = ulSizLeft;
+			if( ulSizBlock>5552U )
+			{
+				ulSizBlock = 5552U;
+			}
+			ulSizLeft -= ulSizBlock;
+
+			do
+			{
+				ulA += *(pucCnt++);
+				ulB += ulA;
+				--ulSizBlock;
+			} while( ulSizBlock!=0 );
+
+			ulA %= 65521U;
+			ulB %= 65521U;
 		}
 
-		ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
-		iResult = i2c_core_hsoc_v2_init(&tI2CSetup, ptHandle);
-		if( iResult!=0 )
+		ptParameter->ulChecksum = (ulB << 16U) | ulA;
+		if( ulVerbose!=0U )
 		{
-			uprintf("Failed to setup the I2C core.\n");
-			tResult = TEST_RESULT_ERROR;
+			uprintf("Adler-32 of [0x%08x, 0x%08x[: 0x%08x\n", ulData, ulData + ptParameter->sizData, ptParameter->ulChecksum);
 		}
+		iResult = 0;
 	}
 
-	return tResult;
+	return iResult;
 }
 
 
 
-static int processCommandSequence(unsigned long ulVerbose, I2C_PARAMETER_RUN_SEQUENCE_T *ptParameter)
+static int processCommandSample(unsigned long ulVerbose, I2C_PARAMETER_SAMPLE_T *ptParameter)
 {
 	int iResult;
-	CMD_STATE_T tState;
-	unsigned char ucData;
-	I2C_SEQ_COMMAND_T tCmd;
-	unsigned int uiDataSize;
-	I2C_HANDLE_T *ptHandle;
-
-
-	/* An empty command is OK. */
-	iResult = 0;
+	I2C_SAMPLER_T *ptSampler;
+	I2C_SAMPLER_RECORD_T *ptRecord;
+	I2C_PARAMETER_RUN_SEQUENCE_T tRun;
+	TIMER_HANDLE_T tPeriod;
+	unsigned long ulSamples;
+	I2C_SAMPLER_RECORD_T *ptDiscard;
 
-	/* Get the verbose flag. */
-	tState.ulVerbose = ulVerbose;
 
-	/* Get the handle. */
-	ptHandle = (I2C_HANDLE_T*)(ptParameter->ptHandle);
+	iResult = -1;
+	ulSamples = 0;
 
-	/* Loop over all commands. */
-	tState.pucCmdCnt = ptParameter->pucCommand;
-	tState.pucCmdEnd = tState.pucCmdCnt + ptParameter->sizCommand;
-	tState.pucRecCnt = ptParameter->pucReceivedData;
-	tState.pucRecEnd = tState.pucRecCnt + ptParameter->sizReceivedDataMax;
-	if( tState.ulVerbose!=0U )
+	ptSampler = NULL;
+	if( ptParameter->sizSample>0xffffU )
 	{
-		uprintf("Running command [0x%08x, 0x%08x[.\n", (unsigned long)tState.pucCmdCnt, (unsigned long)tState.pucCmdEnd);
+		uprintf("The sample size is limited to 65535 bytes: %d\n", ptParameter->sizSample);
 	}
-
-	while( tState.pucCmdCnt<tState.pucCmdEnd )
+	else if( is_valid_buffer((const void*)(ptParameter->ptHandle), sizeof(I2C_HANDLE_T))!=0 &&
+	    is_valid_buffer(ptParameter->pucCommand, ptParameter->sizCommand)!=0 &&
+	    is_valid_buffer(ptParameter->pucRing, ptParameter->sizRing)!=0 )
 	{
-		/* Get the next command. */
-		iResult = -1;
-		ucData = *(tState.pucCmdCnt++);
-		tCmd = (I2C_SEQ_COMMAND_T)ucData;
-		switch( tCmd )
+		ptSampler = i2c_sampler_init(ptParameter->pucRing, ptParameter->sizRing, ptParameter->sizSample);
+		if( ptSampler==NULL )
 		{
-		case I2C_SEQ_COMMAND_Read:
-		case I2C_SEQ_COMMAND_Write:
-		case I2C_SEQ_COMMAND_Delay:
-			iResult = 0;
-			break;
+			uprintf("The sampler ring is too small for 2 samples: %d bytes\n", ptParameter->sizRing);
 		}
-		if( iResult!=0 )
+	}
+
+	if( ptSampler!=NULL )
+	{
+		if( ulVerbose!=0U )
 		{
-			uprintf("Invalid command: 0x%02x\n", ucData);
-			break;
+			uprintf("Sampling %d bytes every %d ms into %d records at 0x%08x.\n", ptParameter->sizSample, ptParameter->ulPeriodMs, ptSampler->tRing.ulMaxRecords, (unsigned long)ptSampler);
 		}
-		else
+
+		tRun.ptHandle = ptParameter->ptHandle;
+		tRun.pucCommand = ptParameter->pucCommand;
+		tRun.sizCommand = ptParameter->sizCommand;
+		tRun.sizReceivedDataMax = ptParameter->sizSample;
+		tRun.pucPackedData = NULL;
+		tRun.sizPackedDataMax = 0;
+		tRun.pucSnapshot = NULL;
+		tRun.sizSnapshot = 0;
+		tRun.sizSlotArea = 0;
+		tRun.ptOffsetTable = NULL;
+		tRun.ulOffsetEntriesMax = 0;
+
+		iResult = 0;
+		while( ptSampler->ulStopRequest==0U && (ptParameter->ulSamplesMax==0U || ulSamples<ptParameter->ulSamplesMax) )
 		{
-			switch( tCmd )
-			{
-			case I2C_SEQ_COMMAND_Read:
-				iResult = command_read(&tState, ptHandle);
-				break;
+			systime_handle_start_ms(&tPeriod, ptParameter->ulPeriodMs);
 
-			case I2C_SEQ_COMMAND_Write:
-				iResult = command_write(&tState, ptHandle);
-				break;
+			/* A sample which does not fit into the ring is still received,
+			 * but it is dropped. It goes to the free record at the write
+			 * index, which the host never reads.
+			 */
+			ptRecord = i2c_sampler_get_free(ptSampler);
+			if( ptRecord!=NULL )
+			{
+				ptRecord->ulTimestampMs = systime_get_ms();
+				tRun.pucReceivedData = ptRecord->aucData;
+			}
+			else
+			{
+				ptDiscard = (I2C_SAMPLER_RECORD_T*)i2c_ring_get_record(&(ptSampler->tRing), sizeof(I2C_SAMPLER_T), ptSampler->tRing.ulWriteIndex);
+				tRun.pucReceivedData = ptDiscard->aucData;
+			}
+			tRun.ulResumeOffset = 0;
+			tRun.ulResumeIndex = 0;
+			tRun.sizReceivedData = 0;
 
-			case I2C_SEQ_COMMAND_Delay:
-				iResult = command_delay(&tState);
-				break;
+			if( processCommandSequence(0, &tRun)!=0 )
+			{
+				++ptSampler->ulErrors;
 			}
-			if( iResult!=0 )
+			if( ptRecord!=NULL )
 			{
-				if( tState.ulVerbose!=0U )
-				{
-					uprintf("The command failed. Stopping execution of the sequence.\n");
-				}
-				break;
+				ptRecord->usErrorClass = (unsigned short)tRun.ulErrorClass;
+				ptRecord->usDataSize = (unsigned short)tRun.sizReceivedData;
+				i2c_sampler_commit(ptSampler);
 			}
-		}
-	}
+			++ulSamples;
+			ptSampler->ulSamples = ulSamples;
 
-	if( iResult==0 )
-	{
-		/* Set the size of the result data. */
-		uiDataSize = (unsigned int)(tState.pucRecCnt-ptParameter->pucReceivedData);
-		if( uiDataSize<=ptParameter->sizReceivedDataMax )
-		{
-			ptParameter->sizReceivedData = uiDataSize;
+			/* Wait for the next period. */
+			while( ptSampler->ulStopRequest==0U && systime_handle_is_elapsed(&tPeriod)==0 )
+			{
+			}
 		}
-		else
+
+		if( ulVerbose!=0U )
 		{
-			iResult = -1;
+			uprintf("Sampler stopped after %d samples, %d overflows, %d errors.\n", ulSamples, ptSampler->ulOverflows, ptSampler->ulErrors);
 		}
 	}
 
+	ptParameter->ulSamples = ulSamples;
+
 	return iResult;
 }
 
 
 
+static void processCommandGetCapabilities(unsigned long ulVerbose, I2C_PARAMETER_CAPABILITIES_T *ptParameter)
+{
+	ptParameter->ulFifoDepth = I2C_CORE_HSOC_V2_FIFO_DEPTH;
+	ptParameter->ulTransferSizeMax = I2C_CORE_HSOC_V2_TRANSFER_SIZE_MAX;
+	ptParameter->ulAckPollMax = I2C_CORE_HSOC_V2_ACKPOLL_MAX;
+	ptParameter->ulSpeedMask = (1U << (I2CSPEED_3400 + 1)) - 1U;
+	ptParameter->ulParameterStart = (uint32_t)parameter_start_address;
+	ptParameter->ulParameterSize = (uint32_t)((unsigned char*)parameter_end_address - (unsigned char*)parameter_start_address);
+	ptParameter->ulHandleSize = sizeof(I2C_HANDLE_T);
+	ptParameter->ulBufferStart = (uint32_t)(tArenaTransfer.pucStart);
+	ptParameter->ulBufferSize = (uint32_t)(tArenaTransfer.pucEnd - tArenaTransfer.pucStart);
+	ptParameter->ulFeatures = I2C_FEATURE_PackedResult |
+	                          I2C_FEATURE_Resume |
+	                          I2C_FEATURE_AckPollPolicy |
+	                          I2C_FEATURE_Scan |
+	                          I2C_FEATURE_Benchmark |
+	                          I2C_FEATURE_Capture |
+	                          I2C_FEATURE_WriteMulti |
+	                          I2C_FEATURE_Smbus |
+	                          I2C_FEATURE_Rmw |
+	                          I2C_FEATURE_ExtendedLength |
+	                          I2C_FEATURE_Checksum |
+	                          I2C_FEATURE_Sample |
+	                          I2C_FEATURE_ReadDelta |
+	                          I2C_FEATURE_ReadTo |
+	                          I2C_FEATURE_MuxSelect;
+
+	if( ulVerbose!=0U )
+	{
+		uprintf("FIFO depth:          %d\n", ptParameter->ulFifoDepth);
+		uprintf("Max. transfer size:  %d\n", ptParameter->ulTransferSizeMax);
+		uprintf("Max. ACK poll:       %d\n", ptParameter->ulAckPollMax);
+		uprintf("Speeds:              0x%02x\n", ptParameter->ulSpeedMask);
+		uprintf("Parameter area:      0x%08x, %d bytes\n", ptParameter->ulParameterStart, ptParameter->ulParameterSize);
+		uprintf("Transfer arena:      0x%08x, %d bytes\n", ptParameter->ulBufferStart, ptParameter->ulBufferSize);
+		uprintf("Features:            0x%08x\n", ptParameter->ulFeatures);
+	}
+}
+
+
+
 TEST_RESULT_T test(I2C_PARAMETER_T *ptTestParams)
 {
 	TEST_RESULT_T tResult;
@@ -538,6 +2529,10 @@ TEST_RESULT_T test(I2C_PARAMETER_T *ptTestParams)
 	I2C_CMD_T tCmd;
 
 	systime_init();
+	cycle_counter_init();
+
+	arena_init(&tArenaParameter, parameter_start_address, parameter_end_address);
+	arena_init(&tArenaTransfer, buffer_start_address, buffer_end_address);
 
 	/* Set the verbose mode. */
 	ulVerbose = ptTestParams->ulVerbose;
@@ -558,6 +2553,12 @@ TEST_RESULT_T test(I2C_PARAMETER_T *ptTestParams)
 	case I2C_CMD_Open:
 	case I2C_CMD_RunSequence:
 	case I2C_CMD_Close:
+	case I2C_CMD_Scan:
+	case I2C_CMD_Benchmark:
+	case I2C_CMD_Capture:
+	case I2C_CMD_Checksum:
+	case I2C_CMD_GetCapabilities:
+	case I2C_CMD_Sample:
 		tResult = TEST_RESULT_OK;
 		break;
 	}
@@ -581,6 +2582,50 @@ TEST_RESULT_T test(I2C_PARAMETER_T *ptTestParams)
 			}
 			break;
 
+		case I2C_CMD_Scan:
+			iResult = processCommandScan(ulVerbose, &(ptTestParams->uParameter.tScan));
+			if( iResult!=0 )
+			{
+				tResult = TEST_RESULT_ERROR;
+			}
+			break;
+
+		case I2C_CMD_Benchmark:
+			iResult = processCommandBenchmark(ulVerbose, &(ptTestParams->uParameter.tBenchmark));
+			if( iResult!=0 )
+			{
+				tResult = TEST_RESULT_ERROR;
+			}
+			break;
+
+		case I2C_CMD_Capture:
+			iResult = processCommandCapture(ulVerbose, &(ptTestParams->uParameter.tCapture));
+			if( iResult!=0 )
+			{
+				tResult = TEST_RESULT_ERROR;
+			}
+			break;
+
+		case I2C_CMD_Checksum:
+			iResult = processCommandChecksum(ulVerbose, &(ptTestParams->uParameter.tChecksum));
+			if( iResult!=0 )
+			{
+				tResult = TEST_RESULT_ERROR;
+			}
+			break;
+
+		case I2C_CMD_GetCapabilities:
+			processCommandGetCapabilities(ulVerbose, &(ptTestParams->uParameter.tCapabilities));
+			break;
+
+		case I2C_CMD_Sample:
+			iResult = processCommandSample(ulVerbose, &(ptTestParams->uParameter.tSample));
+			if( iResult!=0 )
+			{
+				tResult = TEST_RESULT_ERROR;
+			}
+			break;
+
 		case I2C_CMD_Close:
 			uprintf("Not yet.\n");
 			tResult = TEST_RESULT_ERROR;
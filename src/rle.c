@@ -0,0 +1,201 @@
+#include "rle.h"
+
+#include "tcm.h"
+
+
+/* Pack "sizData" bytes from "pucData" to "pucPacked".
+ * Returns the size of the packed data or 0 if it does not fit into
+ * "sizPackedMax" bytes.
+ */
+unsigned int rle_encode(const unsigned char *pucData, unsigned int sizData, unsigned char *pucPacked, unsigned int sizPackedMax)
+{
+	const unsigned char *pucCnt;
+	const unsigned char *pucEnd;
+	const unsigned char *pucLiteral;
+	const unsigned char *pucRunEnd;
+	unsigned char *pucPackedCnt;
+	unsigned char *pucPackedEnd;
+	unsigned int sizChunk;
+	unsigned int sizRun;
+	unsigned char ucData;
+	int iResult;
+
+
+	iResult = 0;
+
+	pucCnt = pucData;
+	pucEnd = pucData + sizData;
+	pucLiteral = pucData;
+	pucPackedCnt = pucPacked;
+	pucPackedEnd = pucPacked + sizPackedMax;
+
+	/* Loop over the data and one more time to flush the last literals. */
+	while( iResult==0 && pucLiteral<pucEnd )
+	{
+		/* Get the length of the run starting at pucCnt. */
+		sizRun = 0;
+		pucRunEnd = pucCnt;
+		if( pucCnt<pucEnd )
+		{
+			ucData = *pucCnt;
+			pucRunEnd = pucCnt + 1;
+			while( pucRunEnd<pucEnd && (unsigned int)(pucRunEnd-pucCnt)<RLE_REPEAT_MAX && *pucRunEnd==ucData )
+			{
+				++pucRunEnd;
+			}
+			sizRun = (unsigned int)(pucRunEnd - pucCnt);
+		}
+
+		/* Runs shorter than RLE_REPEAT_MIN bytes stay in the literal block. */
+		if( sizRun>=RLE_REPEAT_MIN || pucCnt==pucEnd )
+		{
+			/* Flush all literals up to the run. */
+			while( pucLiteral<pucCnt )
+			{
+				sizChunk = (unsigned int)(pucCnt - pucLiteral);
+				if( sizChunk>RLE_LITERAL_MAX )
+				{
+					sizChunk = RLE_LITERAL_MAX;
+				}
+				if( (pucPackedCnt+1U+sizChunk)>pucPackedEnd )
+				{
+					iResult = -1;
+					break;
+				}
+				*(pucPackedCnt++) = (unsigned char)(sizChunk - 1U);
+				while( sizChunk!=0 )
+				{
+					*(pucPackedCnt++) = *(pucLiteral++);
+					--sizChunk;
+				}
+			}
+
+			if( iResult==0 && sizRun>=RLE_REPEAT_MIN )
+			{
+				if( (pucPackedCnt+2U)>pucPackedEnd )
+				{
+					iResult = -1;
+				}
+				else
+				{
+					*(pucPackedCnt++) = (unsigned char)(0x80U | (sizRun - RLE_REPEAT_MIN));
+					*(pucPackedCnt++) = *pucCnt;
+					pucLiteral = pucRunEnd;
+				}
+			}
+		}
+		pucCnt = pucRunEnd;
+	}
+
+	sizChunk = 0;
+	if( iResult==0 )
+	{
+		sizChunk = (unsigned int)(pucPackedCnt - pucPacked);
+	}
+
+	return sizChunk;
+}
+
+
+
+/* Walk over all blocks of a packed stream without decoding it.
+ * The stream must consume exactly "sizPacked" bytes and produce exactly
+ * "sizUnpacked" bytes.
+ */
+int rle_validate(const unsigned char *pucPacked, unsigned int sizPacked, unsigned int sizUnpacked)
+{
+	const unsigned char *pucCnt;
+	const unsigned char *pucEnd;
+	unsigned int uiControl;
+	unsigned int uiRun;
+	int iResult;
+
+
+	iResult = 0;
+
+	pucCnt = pucPacked;
+	pucEnd = pucPacked + sizPacked;
+	while( pucCnt<pucEnd )
+	{
+		uiControl = *(pucCnt++);
+		if( (uiControl&0x80U)!=0 )
+		{
+			uiRun = (uiControl & 0x7fU) + RLE_REPEAT_MIN;
+			/* The repeated byte follows. */
+			pucCnt += 1;
+		}
+		else
+		{
+			uiRun = uiControl + 1U;
+			pucCnt += uiRun;
+		}
+
+		if( pucCnt>pucEnd || uiRun>sizUnpacked )
+		{
+			iResult = -1;
+			break;
+		}
+		sizUnpacked -= uiRun;
+	}
+
+	if( sizUnpacked!=0 )
+	{
+		iResult = -1;
+	}
+
+	return iResult;
+}
+
+
+
+void rle_decoder_init(RLE_DECODER_T *ptDecoder, const unsigned char *pucPacked)
+{
+	ptDecoder->pucCnt = pucPacked;
+	ptDecoder->uiRun = 0;
+	ptDecoder->iIsRepeat = 0;
+	ptDecoder->ucRepeat = 0;
+}
+
+
+
+/* Get the next byte from the packed stream. The stream must be checked with
+ * "rle_validate" before, as this routine does no bounds checks.
+ */
+unsigned char TCM_CODE rle_decoder_get_byte(void *pvDecoder)
+{
+	RLE_DECODER_T *ptDecoder;
+	unsigned int uiControl;
+	unsigned char ucData;
+
+
+	ptDecoder = (RLE_DECODER_T*)pvDecoder;
+
+	/* Start a new block? */
+	if( ptDecoder->uiRun==0 )
+	{
+		uiControl = *(ptDecoder->pucCnt++);
+		if( (uiControl&0x80U)!=0 )
+		{
+			ptDecoder->uiRun = (uiControl & 0x7fU) + RLE_REPEAT_MIN;
+			ptDecoder->iIsRepeat = 1;
+			ptDecoder->ucRepeat = *(ptDecoder->pucCnt++);
+		}
+		else
+		{
+			ptDecoder->uiRun = uiControl + 1U;
+			ptDecoder->iIsRepeat = 0;
+		}
+	}
+
+	if( ptDecoder->iIsRepeat!=0 )
+	{
+		ucData = ptDecoder->ucRepeat;
+	}
+	else
+	{
+		ucData = *(ptDecoder->pucCnt++);
+	}
+	--ptDecoder->uiRun;
+
+	return ucData;
+}
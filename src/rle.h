@@ -0,0 +1,31 @@
+
+#ifndef __RLE_H__
+#define __RLE_H__
+
+
+/* The RLE stream is a list of blocks. Each block starts with a control byte.
+ *
+ *   0x00-0x7f: a literal block with (control+1) bytes follows.
+ *   0x80-0xff: the next byte is repeated ((control&0x7f)+RLE_REPEAT_MIN) times.
+ */
+#define RLE_LITERAL_MAX 128U
+#define RLE_REPEAT_MIN 3U
+#define RLE_REPEAT_MAX (0x7fU+RLE_REPEAT_MIN)
+
+
+typedef struct RLE_DECODER_STRUCT
+{
+	const unsigned char *pucCnt;
+	unsigned int uiRun;
+	int iIsRepeat;
+	unsigned char ucRepeat;
+} RLE_DECODER_T;
+
+
+unsigned int rle_encode(const unsigned char *pucData, unsigned int sizData, unsigned char *pucPacked, unsigned int sizPackedMax);
+int rle_validate(const unsigned char *pucPacked, unsigned int sizPacked, unsigned int sizUnpacked);
+void rle_decoder_init(RLE_DECODER_T *ptDecoder, const unsigned char *pucPacked);
+unsigned char rle_decoder_get_byte(void *pvDecoder);
+
+
+#endif  /* __RLE_H__ */
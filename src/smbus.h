@@ -0,0 +1,12 @@
+#ifndef __SMBUS_H__
+#define __SMBUS_H__
+
+
+/* The SMBus packet error code (PEC) is a CRC-8 with the polynomial
+ * x^8 + x^2 + x + 1 over all bytes of a transaction including the address
+ * bytes. Start with 0 and feed all bytes in the order they are on the bus.
+ */
+unsigned char smbus_pec(unsigned char ucPec, const unsigned char *pucData, unsigned int sizData);
+
+
+#endif  /* __SMBUS_H__ */
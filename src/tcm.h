@@ -0,0 +1,31 @@
+#ifndef __TCM_H__
+#define __TCM_H__
+
+
+/* Place time critical code in the ITCM and its data in the DTCM. Both are
+ * copied from the load image in init.S on every start. A build with
+ * CFG_USE_TCM=0 keeps everything in the normal RAM like before. This is the
+ * reference for the benchmark.
+ */
+#ifndef CFG_USE_TCM
+#       define CFG_USE_TCM 1
+#endif
+
+/* The build uses -mlong-calls, as the ITCM is too far away from the rest of
+ * the code for a direct branch. A function in the ITCM which is called from
+ * other code in the ITCM gets TCM_SHORT_CALL in its declaration. The calls
+ * are direct branches then. The linker adds a veneer for callers which are
+ * out of range.
+ */
+#if CFG_USE_TCM!=0
+#       define TCM_CODE __attribute__((section(".itcm_code")))
+#       define TCM_DATA __attribute__((section(".dtcm_data")))
+#       define TCM_SHORT_CALL __attribute__((short_call))
+#else
+#       define TCM_CODE
+#       define TCM_DATA
+#       define TCM_SHORT_CALL
+#endif
+
+
+#endif  /* __TCM_H__ */
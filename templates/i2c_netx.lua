@@ -6,10 +6,100 @@ function I2CNetx:_init(tLog)
   self.I2C_CMD_Open = ${I2C_CMD_Open}
   self.I2C_CMD_RunSequence = ${I2C_CMD_RunSequence}
   self.I2C_CMD_Close = ${I2C_CMD_Close}
+  self.I2C_CMD_Scan = ${I2C_CMD_Scan}
+  self.I2C_CMD_Benchmark = ${I2C_CMD_Benchmark}
+  self.I2C_CMD_Capture = ${I2C_CMD_Capture}
+  self.I2C_CMD_Checksum = ${I2C_CMD_Checksum}
+  self.I2C_CMD_GetCapabilities = ${I2C_CMD_GetCapabilities}
+  self.I2C_CMD_Sample = ${I2C_CMD_Sample}
+
+  self.atFeatureNames = {
+    [${I2C_FEATURE_PackedResult}] = 'PackedResult',
+    [${I2C_FEATURE_Resume}] = 'Resume',
+    [${I2C_FEATURE_AckPollPolicy}] = 'AckPollPolicy',
+    [${I2C_FEATURE_Scan}] = 'Scan',
+    [${I2C_FEATURE_Benchmark}] = 'Benchmark',
+    [${I2C_FEATURE_Capture}] = 'Capture',
+    [${I2C_FEATURE_WriteMulti}] = 'WriteMulti',
+    [${I2C_FEATURE_Smbus}] = 'Smbus',
+    [${I2C_FEATURE_Rmw}] = 'Rmw',
+    [${I2C_FEATURE_ExtendedLength}] = 'ExtendedLength',
+    [${I2C_FEATURE_Checksum}] = 'Checksum',
+    [${I2C_FEATURE_Sample}] = 'Sample',
+    [${I2C_FEATURE_ReadDelta}] = 'ReadDelta',
+    [${I2C_FEATURE_ReadTo}] = 'ReadTo',
+    [${I2C_FEATURE_MuxSelect}] = 'MuxSelect'
+  }
 
   self.I2C_SEQ_COMMAND_Read = ${I2C_SEQ_COMMAND_Read}
   self.I2C_SEQ_COMMAND_Write = ${I2C_SEQ_COMMAND_Write}
   self.I2C_SEQ_COMMAND_Delay = ${I2C_SEQ_COMMAND_Delay}
+  self.I2C_SEQ_COMMAND_WriteRle = ${I2C_SEQ_COMMAND_WriteRle}
+  self.I2C_SEQ_COMMAND_AckPollPolicy = ${I2C_SEQ_COMMAND_AckPollPolicy}
+  self.I2C_SEQ_COMMAND_WriteMulti = ${I2C_SEQ_COMMAND_WriteMulti}
+  self.I2C_SEQ_COMMAND_Smbus = ${I2C_SEQ_COMMAND_Smbus}
+
+  self.I2C_SMBUS_FLAGS_Pec = ${I2C_SMBUS_FLAGS_Pec}
+
+  self.I2C_SEQ_COMMAND_Rmw = ${I2C_SEQ_COMMAND_Rmw}
+  self.I2C_SEQ_COMMAND_ReadExt = ${I2C_SEQ_COMMAND_ReadExt}
+  self.I2C_SEQ_COMMAND_WriteExt = ${I2C_SEQ_COMMAND_WriteExt}
+  self.I2C_SEQ_COMMAND_ReadDelta = ${I2C_SEQ_COMMAND_ReadDelta}
+  self.I2C_SEQ_COMMAND_ReadTo = ${I2C_SEQ_COMMAND_ReadTo}
+  self.I2C_READ_DESTINATION_Append = ${I2C_READ_DESTINATION_Append}
+  self.I2C_READ_DESTINATION_Discard = ${I2C_READ_DESTINATION_Discard}
+  self.I2C_READ_DESTINATION_Slot = ${I2C_READ_DESTINATION_Slot}
+  self.I2C_RESULT_OFFSET_SIZE = ${SIZEOF_I2C_RESULT_OFFSET_STRUCT}
+  self.I2C_SEQ_COMMAND_MuxSelect = ${I2C_SEQ_COMMAND_MuxSelect}
+  self.I2C_MUX_SELECT_FLAGS_Force = ${I2C_MUX_SELECT_FLAGS_Force}
+  self.I2C_READ_DELTA_Unchanged = ${I2C_READ_DELTA_Unchanged}
+  self.I2C_READ_DELTA_Changed = ${I2C_READ_DELTA_Changed}
+  self.I2C_READ_DELTA_Full = ${I2C_READ_DELTA_Full}
+  self.I2C_READ_DELTA_MAX = ${I2C_READ_DELTA_MAX}
+  self.atRmwOptions = {
+    reg16 = ${I2C_RMW_FLAGS_Register16},
+    data16 = ${I2C_RMW_FLAGS_Data16},
+    lsb = ${I2C_RMW_FLAGS_DataLsbFirst},
+    verify = ${I2C_RMW_FLAGS_Verify}
+  }
+
+  -- These are the SMBus protocols with the size of the parameter and the
+  -- result data. A size of nil means the parameter is the maximum count of
+  -- a block read or the data of a block write.
+  self.atSmbusProtocols = {
+    read_byte =    { id=${I2C_SMBUS_PROTOCOL_ReadByte},    write=0, read=1 },
+    write_byte =   { id=${I2C_SMBUS_PROTOCOL_WriteByte},   write=1, read=0 },
+    read_word =    { id=${I2C_SMBUS_PROTOCOL_ReadWord},    write=0, read=2 },
+    write_word =   { id=${I2C_SMBUS_PROTOCOL_WriteWord},   write=2, read=0 },
+    block_read =   { id=${I2C_SMBUS_PROTOCOL_BlockRead},   write=0, read=nil },
+    block_write =  { id=${I2C_SMBUS_PROTOCOL_BlockWrite},  write=nil, read=0 },
+    process_call = { id=${I2C_SMBUS_PROTOCOL_ProcessCall}, write=2, read=2 }
+  }
+
+  self.atSeqErrorNames = {
+    [${I2C_SEQ_ERROR_None}] = 'None',
+    [${I2C_SEQ_ERROR_InvalidCommand}] = 'InvalidCommand',
+    [${I2C_SEQ_ERROR_CommandTruncated}] = 'CommandTruncated',
+    [${I2C_SEQ_ERROR_RxOverflow}] = 'RxOverflow',
+    [${I2C_SEQ_ERROR_InvalidData}] = 'InvalidData',
+    [${I2C_SEQ_ERROR_InvalidParameter}] = 'InvalidParameter',
+    [${I2C_SEQ_ERROR_NakAddress}] = 'NakAddress',
+    [${I2C_SEQ_ERROR_NakData}] = 'NakData',
+    [${I2C_SEQ_ERROR_Timeout}] = 'Timeout',
+    [${I2C_SEQ_ERROR_PecMismatch}] = 'PecMismatch',
+    [${I2C_SEQ_ERROR_VerifyFailed}] = 'VerifyFailed'
+  }
+
+  self.atCaptureEventNames = {
+    [${I2C_CAPTURE_EVENT_Start}] = 'Start',
+    [${I2C_CAPTURE_EVENT_AddressAck}] = 'AddressAck',
+    [${I2C_CAPTURE_EVENT_AddressNak}] = 'AddressNak',
+    [${I2C_CAPTURE_EVENT_DataWrite}] = 'DataWrite',
+    [${I2C_CAPTURE_EVENT_DataRead}] = 'DataRead',
+    [${I2C_CAPTURE_EVENT_DataNak}] = 'DataNak',
+    [${I2C_CAPTURE_EVENT_Stop}] = 'Stop',
+    [${I2C_CAPTURE_EVENT_Timeout}] = 'Timeout'
+  }
 
   self.I2C_SEQ_CONDITION_None = ${I2C_SEQ_CONDITION_None}
   self.I2C_SEQ_CONDITION_Start = ${I2C_SEQ_CONDITION_Start}
@@ -27,9 +117,39 @@ function I2CNetx:_init(tLog)
   self.I2C_SETUP_CORE_I2C2 = ${I2C_SETUP_CORE_I2C2}
 
   self.I2C_HANDLE_SIZE = ${SIZEOF_I2C_HANDLE_STRUCT}
+  self.VERSION_HEADER_SIZE = ${SIZEOF_VERSION_HEADER_STRUCT}
+  self.I2C_BENCHMARK_RESULT_SIZE = ${SIZEOF_I2C_BENCHMARK_RESULT_STRUCT}
+  self.I2C_CAPTURE_HEADER_SIZE = ${SIZEOF_I2C_CAPTURE_STRUCT}
+  self.I2C_CAPTURE_RECORD_SIZE = ${SIZEOF_I2C_CAPTURE_RECORD_STRUCT}
+  self.I2C_SAMPLER_HEADER_SIZE = ${SIZEOF_I2C_SAMPLER_STRUCT}
+  self.I2C_SAMPLER_RECORD_SIZE = ${SIZEOF_I2C_SAMPLER_RECORD_STRUCT}
+
+  -- This is the number of handles in the parameter area.
+  self.I2C_HANDLE_SLOTS = ${I2C_HANDLE_SLOTS}
+
+  -- run_sequence_async gives up if the netX does not answer within the
+  -- estimated time of the sequence plus this margin. wait_all sleeps this
+  -- time between 2 polls of all netX.
+  self.I2C_ASYNC_TIMEOUT_MARGIN_MS = 2000
+  self.I2C_ASYNC_POLL_INTERVAL_MS = 10
+
+  -- This is the size of the snapshot area for the "readdelta" commands of
+  -- one handle. The areas of all handle slots are at the end of the transfer
+  -- arena.
+  self.I2C_SNAPSHOT_AREA_SIZE = ${I2C_SNAPSHOT_AREA_SIZE}
+
+  -- This is the format of the precompiled sequence files.
+  self.I2C_SEQUENCE_FILE_MAGIC = 'I2CS'
+  self.I2C_SEQUENCE_FILE_VERSION = 2
 
   self.romloader = require 'romloader'
   self.lpeg = require 'lpeglabel'
+  -- LuaSocket is optional. It is only used for the sleep between the polls
+  -- of wait_all and the deadline of run_sequence_async.
+  local fSocket, tSocket = pcall(require, 'socket')
+  if fSocket==true then
+    self.socket = tSocket
+  end
   self.pl = require'pl.import_into'()
 
   self.tLog = tLog
@@ -52,12 +172,24 @@ function I2CNetx:__create_i2c_macro_grammar()
   local HexInteger = lpeg.V('HexInteger')
   local BinInteger = lpeg.V('BinInteger')
   local Integer = lpeg.V('Integer')
+  local Name = lpeg.V('Name')
+  local ReadDestination = lpeg.V('ReadDestination')
   local Data = lpeg.V('Data')
+  local AddressList = lpeg.V('AddressList')
   local StartCommand = lpeg.V('StartCommand')
   local StopCommand = lpeg.V('StopCommand')
   local ReadCommand = lpeg.V('ReadCommand')
+  local ReadDeltaCommand = lpeg.V('ReadDeltaCommand')
   local WriteCommand = lpeg.V('WriteCommand')
   local DelayCommand = lpeg.V('DelayCommand')
+  local AckPollCommand = lpeg.V('AckPollCommand')
+  local SmbusCommand = lpeg.V('SmbusCommand')
+  local SmbusProtocol = lpeg.V('SmbusProtocol')
+  local RmwCommand = lpeg.V('RmwCommand')
+  local RmwOption = lpeg.V('RmwOption')
+  local SelectCommand = lpeg.V('SelectCommand')
+  local MuxCommand = lpeg.V('MuxCommand')
+  local Force = lpeg.V('Force')
   local Command = lpeg.V('Command')
   local Comment = lpeg.V('Comment')
   local Statement = lpeg.V('Statement')
@@ -73,8 +205,8 @@ function I2CNetx:__create_i2c_macro_grammar()
     -- A comment starts with a hash and covers the complete line.
     Comment = lpeg.P('#') * (1 - lpeg.S("\r\n"))^0;
 
-    -- A command is one of the 5 possible commands.
-    Command = lpeg.Ct(Space * (StartCommand + StopCommand + ReadCommand + WriteCommand + DelayCommand) * Comment^-1 * Space);
+    -- A command is one of the possible commands.
+    Command = lpeg.Ct(Space * (StartCommand + StopCommand + ReadDeltaCommand + ReadCommand + WriteCommand + DelayCommand + AckPollCommand + SmbusCommand + RmwCommand + SelectCommand + MuxCommand) * Comment^-1 * Space);
 
     -- A start command has no parameter.
     StartCommand = lpeg.Cg(lpeg.P("start"), 'cmd');
@@ -82,15 +214,53 @@ function I2CNetx:__create_i2c_macro_grammar()
     -- A stop command has no parameter.
     StopCommand = lpeg.Cg(lpeg.P("stop"), 'cmd');
 
-    -- A read command has the address, a length parameter and an optional retry.
-    ReadCommand = lpeg.Cg(lpeg.P("read"), 'cmd') * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'length') * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'retries'))^-1;
+    -- A read command has the address, a length parameter, an optional retry and an optional destination.
+    --   discard:     drop the data
+    --   slot <name>: write the data to a named slot, a later read to the same slot overwrites it
+    ReadCommand = lpeg.Cg(lpeg.P("read"), 'cmd') * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'length') * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'retries'))^-1 * (Space * lpeg.P(',') * Space * ReadDestination)^-1;
+    ReadDestination = lpeg.Cg(lpeg.P("discard"), 'discard') + (lpeg.P("slot") * lpeg.S(" \t")^1 * lpeg.Cg(Name, 'slot'));
+
+    -- A delta read command has the address, a length parameter, the offset of the snapshot and an optional retry.
+    -- It is a complete transaction with its own START and STOP conditions.
+    ReadDeltaCommand = lpeg.Cg(lpeg.P("readdelta"), 'cmd') * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'length') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'snapshot') * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'retries'))^-1;
 
-    -- A write command has the address, an optional retry and a data definition as parameters.
-    WriteCommand = lpeg.Cg(lpeg.P("write"), 'cmd') * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * Data * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'retries'))^-1;
+    -- A write command has the address or a list of addresses, an optional retry and a data definition as parameters.
+    WriteCommand = lpeg.Cg(lpeg.P("write"), 'cmd') * Space * (lpeg.Cg(AddressList, 'addresses') + lpeg.Cg(Integer, 'address')) * Space * lpeg.P(',') * Space * Data * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'retries'))^-1;
 
     -- A delay command has the delay in milliseconds as the parameter.
     DelayCommand = lpeg.Cg(lpeg.P("delay"), 'cmd') * Space * lpeg.Cg(Integer, 'delay'); 
 
+    -- An ACK poll command has the budget and the backoff in milliseconds and an optional maximum backoff.
+    AckPollCommand = lpeg.Cg(lpeg.P("ackpoll"), 'cmd') * Space * lpeg.Cg(Integer, 'budget') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'backoff') * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'backoffmax'))^-1;
+
+    -- An address list is a list of comma separated integers surrounded by square brackets.
+    AddressList = lpeg.Ct(lpeg.P('[') * Space * lpeg.C(Integer) * Space * (lpeg.P(',') * Space * lpeg.C(Integer) * Space)^0 * lpeg.P(']'));
+
+    -- An SMBus command has the protocol, an optional "pec", the address, the command code and a parameter depending on the protocol:
+    --   read_byte, read_word: none
+    --   write_byte, write_word, process_call: the value
+    --   block_read: the maximum count
+    --   block_write: a data definition
+    SmbusCommand = lpeg.Cg(lpeg.P("smbus"), 'cmd') * Space * lpeg.Cg(SmbusProtocol, 'protocol') * (Space * lpeg.Cg(lpeg.P("pec"), 'pec'))^-1 * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'command') * (Space * lpeg.P(',') * Space * (Data + lpeg.Cg(Integer, 'value')))^-1;
+    SmbusProtocol = lpeg.P("read_byte") + lpeg.P("write_byte") + lpeg.P("read_word") + lpeg.P("write_word") + lpeg.P("block_read") + lpeg.P("block_write") + lpeg.P("process_call");
+
+    -- A read-modify-write command has the address, the register, the AND mask, the OR mask, an optional XOR mask and a list of options.
+    --   reg16:  the register address has 16 bits
+    --   data16: the register has 16 bits
+    --   lsb:    16 bit data is sent with the low byte first
+    --   verify: read back the register after the write
+    RmwCommand = lpeg.Cg(lpeg.P("rmw"), 'cmd') * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'register') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'andmask') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'ormask') * (Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'xormask'))^-1 * (Space * lpeg.P(',') * Space * lpeg.Cg(lpeg.Ct(RmwOption * (lpeg.S(" \t")^1 * RmwOption)^0), 'options'))^-1;
+    RmwOption = lpeg.C(lpeg.P("reg16") + lpeg.P("data16") + lpeg.P("lsb") + lpeg.P("verify"));
+
+    -- A select command switches the multiplexers to the channel of a device in the topology.
+    SelectCommand = lpeg.Cg(lpeg.P("select"), 'cmd') * lpeg.S(" \t")^1 * lpeg.Cg(Name, 'device') * (Space * lpeg.P(',') * Space * Force)^-1;
+
+    -- A mux command writes the channels to the multiplexer at the address.
+    MuxCommand = lpeg.Cg(lpeg.P("mux"), 'cmd') * Space * lpeg.Cg(Integer, 'address') * Space * lpeg.P(',') * Space * lpeg.Cg(Integer, 'channels') * (Space * lpeg.P(',') * Space * Force)^-1;
+
+    -- Write the channels even if the netX has them in its cache.
+    Force = lpeg.Cg(lpeg.P("force"), 'force');
+
     -- A data definition is a list of comma separated integers or strings surrounded by curly brackets. 
     Data = lpeg.Ct(lpeg.P('{') * Space * (lpeg.Cg(QuotedString) + lpeg.Cg(Integer)) * Space * (lpeg.P(',') * Space * (lpeg.Cg(QuotedString) + lpeg.Cg(Integer)))^0 * Space * lpeg.P('}'));
 
@@ -105,6 +275,9 @@ function I2CNetx:__create_i2c_macro_grammar()
     BinInteger = lpeg.P("0b") * lpeg.R('01')^1;
     Integer = lpeg.P(HexInteger + BinInteger + DecimalInteger);
 
+    -- A name starts with a letter or an underscore.
+    Name = (lpeg.R('az', 'AZ') + lpeg.P('_')) * (lpeg.R('az', 'AZ', '09') + lpeg.P('_'))^0;
+
     -- Whitespace.
     Space = lpeg.S(" \t")^0;
   }
@@ -112,7 +285,94 @@ end
 
 
 
-function I2CNetx:initialize(tPlugin)
+-- Build the Adler-32 checksum of a string. This must match the
+-- I2C_CMD_Checksum command of the netX.
+function I2CNetx:__adler32(strData)
+  local ulA = 1
+  local ulB = 0
+  for uiPos=1,string.len(strData) do
+    ulA = (ulA + string.byte(strData, uiPos)) % 65521
+    ulB = (ulB + ulA) % 65521
+  end
+
+  return ulB * 0x10000 + ulA
+end
+
+
+
+-- Check if the binary is already in the memory of the netX. This is the
+-- case if the version header at the load address matches the local file
+-- and the checksum of the code on the netX matches the checksum of the
+-- file. The checksum is only built if the header matches, so the code is
+-- never executed without a plausible header.
+function I2CNetx:__is_resident(tPlugin, aAttr)
+  local tLog = self.tLog
+  local tester = _G.tester
+  local fIsResident = false
+
+  local strBinary = aAttr.strBinary
+  local strLocalHeader = string.sub(strBinary, 1, self.VERSION_HEADER_SIZE)
+  local fOk, strRemoteHeader = pcall(tester.stdRead, tester, tPlugin, aAttr.ulLoadAddress, self.VERSION_HEADER_SIZE)
+  if fOk~=true or strRemoteHeader~=strLocalHeader then
+    tLog.debug('The version header on the netX does not match.')
+  else
+    -- Only the code up to the parameter area is constant.
+    local sizCode = math.min(string.len(strBinary), aAttr.ulParameterStartAddress - aAttr.ulLoadAddress)
+    local aParameter = {
+      0,             -- verbose
+      self.I2C_CMD_Checksum,
+      aAttr.ulLoadAddress,
+      sizCode,
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    local ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.debug('Failed to get the checksum of the code on the netX.')
+    else
+      local ulLocalChecksum = self:__adler32(string.sub(strBinary, 1, sizCode))
+      if aParameter[5]~=ulLocalChecksum then
+        tLog.debug('The checksum of the code on the netX does not match: 0x%08x != 0x%08x', aParameter[5], ulLocalChecksum)
+      else
+        fIsResident = true
+      end
+    end
+  end
+
+  return fIsResident
+end
+
+
+
+-- Get the transfer arena from a version header. The fields were added in
+-- version 1.2 of the header. Older binaries have only the parameter area.
+-- This works for the header of the local binary and for a header read from
+-- the netX.
+function I2CNetx:__get_buffer_area(strHeader)
+  local ulBufferStart
+  local ulBufferEnd
+
+  -- The header is a list of 32 bit values with the 16 byte VCS version
+  -- before the buffer fields:
+  --   magic, version, load, exec, param start, param end, major, minor,
+  --   micro, VCS[16], buffer start, buffer end
+  local ulVersion = self:__bytes_to_uint32(strHeader, 5)
+  if ulVersion>=0x00010002 and string.len(strHeader)>=60 then
+    ulBufferStart = self:__bytes_to_uint32(strHeader, 53)
+    ulBufferEnd = self:__bytes_to_uint32(strHeader, 57)
+  end
+
+  return ulBufferStart, ulBufferEnd
+end
+
+
+
+-- Download the binary to the netX. Skip the download if the same binary is
+-- already there, unless fForceDownload is true.
+-- Set strVariant to "notcm" to load the binary without the TCMs. This is
+-- only useful as the reference for the benchmark. The variant "direct" calls
+-- the driver without the function pointers of the handle.
+function I2CNetx:initialize(tPlugin, fForceDownload, strVariant)
   local tLog = self.tLog
   local romloader = self.romloader
   local tester = _G.tester
@@ -137,12 +397,23 @@ function I2CNetx:initialize(tPlugin)
   if strBinary==nil then
     error('No binary for chip type %s.', tAsicTyp)
   end
+  if strVariant~=nil then
+    strBinary = strBinary .. '_' .. strVariant
+  end
   local strNetxBinary = string.format('netx/i2c_netx%s.bin', strBinary)
   tLog.debug('Loading binary "%s"...', strNetxBinary)
 
   local aAttr = tester:mbin_open(strNetxBinary, tPlugin)
   tester:mbin_debug(aAttr)
-  tester:mbin_write(tPlugin, aAttr)
+  aAttr.ulBufferStartAddress, aAttr.ulBufferEndAddress = self:__get_buffer_area(aAttr.strBinary)
+  if aAttr.ulBufferStartAddress~=nil then
+    tLog.debug('Transfer arena: [0x%08x, 0x%08x[', aAttr.ulBufferStartAddress, aAttr.ulBufferEndAddress)
+  end
+  if fForceDownload~=true and self:__is_resident(tPlugin, aAttr)==true then
+    tLog.debug('The binary is already on the netX.')
+  else
+    tester:mbin_write(tPlugin, aAttr)
+  end
 
   return {
     plugin = tPlugin,
@@ -155,13 +426,7 @@ end
 function I2CNetx:__parseNumber(strNumber)
   local tResult
   if string.sub(strNumber, 1, 2)=='0b' then
-    tResult = 0
-    local uiPos = 0
-    for iPos=string.len(strNumber),3,-1 do
-      local uiDigit = string.byte(strNumber, iPos) - 0x30
-      tResult = tResult + uiDigit * math.pow(2, uiPos)
-      uiPos = uiPos + 1
-    end
+    tResult = tonumber(string.sub(strNumber, 3), 2)
   else
     tResult = tonumber(strNumber)
   end
@@ -215,12 +480,357 @@ end
 
 
 
-function I2CNetx:parseI2cMacro(strMacro)
+-- Pack data with the RLE scheme from "src/rle.h".
+--   0x00-0x7f: a literal block with (control+1) bytes follows.
+--   0x80-0xff: the next byte is repeated ((control&0x7f)+3) times.
+function I2CNetx:__rle_compress(strData)
+  local astrPacked = {}
+  local sizData = string.len(strData)
+  local uiLiteralStart = 1
+
+  -- Write all bytes from uiLiteralStart up to uiLiteralEnd-1 as literal blocks.
+  local function flushLiterals(uiLiteralEnd)
+    while uiLiteralStart<uiLiteralEnd do
+      local sizChunk = math.min(uiLiteralEnd - uiLiteralStart, 128)
+      table.insert(astrPacked, string.char(sizChunk - 1))
+      table.insert(astrPacked, string.sub(strData, uiLiteralStart, uiLiteralStart + sizChunk - 1))
+      uiLiteralStart = uiLiteralStart + sizChunk
+    end
+  end
+
+  local uiPos = 1
+  while uiPos<=sizData do
+    -- Get the length of the run starting at uiPos.
+    local ucData = string.byte(strData, uiPos)
+    local uiRunEnd = uiPos + 1
+    while uiRunEnd<=sizData and (uiRunEnd-uiPos)<130 and string.byte(strData, uiRunEnd)==ucData do
+      uiRunEnd = uiRunEnd + 1
+    end
+    local sizRun = uiRunEnd - uiPos
+    -- Runs shorter than 3 bytes stay in the literal block.
+    if sizRun>=3 then
+      flushLiterals(uiPos)
+      table.insert(astrPacked, string.char(0x80 + sizRun - 3, ucData))
+      uiLiteralStart = uiRunEnd
+    end
+    uiPos = uiRunEnd
+  end
+  flushLiterals(sizData + 1)
+
+  return table.concat(astrPacked)
+end
+
+
+
+-- Unpack data which was packed with the RLE scheme from "src/rle.h".
+function I2CNetx:__rle_decompress(strPacked)
+  local astrData = {}
+  local sizPacked = string.len(strPacked)
+  local uiPos = 1
+  while uiPos<=sizPacked do
+    local ucControl = string.byte(strPacked, uiPos)
+    if ucControl>=0x80 then
+      local strRepeat = string.sub(strPacked, uiPos+1, uiPos+1)
+      table.insert(astrData, string.rep(strRepeat, ucControl - 0x80 + 3))
+      uiPos = uiPos + 2
+    else
+      table.insert(astrData, string.sub(strPacked, uiPos+1, uiPos+1+ucControl))
+      uiPos = uiPos + 2 + ucControl
+    end
+  end
+
+  return table.concat(astrData)
+end
+
+
+
+-- Check packed data like "rle_validate" on the netX. Returns true if the
+-- data unpacks to exactly sizUnpacked bytes.
+function I2CNetx:__rle_validate(strPacked, sizUnpacked)
+  local fIsValid = true
+  local sizPacked = string.len(strPacked)
+  local uiPos = 1
+  while uiPos<=sizPacked do
+    local ucControl = string.byte(strPacked, uiPos)
+    local sizRun
+    if ucControl>=0x80 then
+      sizRun = ucControl - 0x80 + 3
+      uiPos = uiPos + 2
+    else
+      sizRun = ucControl + 1
+      uiPos = uiPos + 1 + sizRun
+    end
+    if uiPos>(sizPacked + 1) or sizRun>sizUnpacked then
+      fIsValid = false
+      break
+    end
+    sizUnpacked = sizUnpacked - sizRun
+  end
+  if sizUnpacked~=0 then
+    fIsValid = false
+  end
+
+  return fIsValid
+end
+
+
+
+function I2CNetx:__bytes_to_uint32(strData, uiOffset)
+  local ucB0, ucB1, ucB2, ucB3 = string.byte(strData, uiOffset, uiOffset+3)
+
+  return ucB0 + 0x00000100*ucB1 + 0x00010000*ucB2 + 0x01000000*ucB3
+end
+
+
+
+function I2CNetx:__parseData(atRawData, uiCommandCnt)
+  local tLog = self.tLog
+
+  local astrData = {}
+  local astrReplace = {
+    ['\\"'] = '"',
+    ["\\'"] = "'",
+    ['\\a'] = '\a',
+    ['\\b'] = '\b',
+    ['\\f'] = '\f',
+    ['\\n'] = '\n',
+    ['\\r'] = '\r',
+    ['\\t'] = '\t',
+    ['\\v'] = '\v'
+  }
+  for uiDataElement, strData in ipairs(atRawData) do
+    if string.sub(strData, 1, 1)=='"' or string.sub(strData, 1, 1)=="'" then
+      -- Unquote the string.
+      strData = string.sub(strData, 2, -2)
+      -- Unescape the string.
+      strData = string.gsub(strData, '(\\["\'abfnrtv])', astrReplace)
+      table.insert(astrData, strData)
+    else
+      local uiData = self:__parseNumber(strData)
+      if uiData<0 or uiData>255 then
+        tLog.error('Data element %d of command %d exceeds the 8 bit range: %d.', uiDataElement, uiCommandCnt, uiData)
+        error('Invalid data.')
+      end
+      table.insert(astrData, string.char(uiData))
+    end
+  end
+
+  return table.concat(astrData)
+end
+
+
+
+-- Append the binary form of one merged command to astrMacro. atSlots has
+-- the offset of each slot name. Returns the number of bytes the command
+-- appends to the received data.
+function I2CNetx:__encodeCommand(tCmd, astrMacro, atSlots)
+  local tLog = self.tLog
+  local sizRx = 0
+
+  if tCmd.cmd=='read' and (tCmd.discard==true or tCmd.slot~=nil) then
+    local ucDestination = self.I2C_READ_DESTINATION_Discard
+    local usSlotOffset = 0
+    if tCmd.slot~=nil then
+      ucDestination = self.I2C_READ_DESTINATION_Slot
+      usSlotOffset = atSlots[tCmd.slot].offset
+    end
+    local ucLen0, ucLen1 = self:__uint16_to_bytes(tCmd.length)
+    local ucSlot0, ucSlot1 = self:__uint16_to_bytes(usSlotOffset)
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_ReadTo,
+      self:__combineConditions(tCmd.conditions),
+      tCmd.address,
+      tCmd.retries,
+      ucLen0, ucLen1,
+      ucDestination,
+      ucSlot0, ucSlot1
+    ))
+
+  elseif tCmd.cmd=='read' then
+    local ulLen = tCmd.length
+    sizRx = sizRx + ulLen
+
+    -- Use the extended command for more than 16 bits of length.
+    if ulLen>0xffff then
+      local ucLen0, ucLen1, ucLen2, ucLen3 = self:__uint32_to_bytes(ulLen)
+      table.insert(astrMacro, string.char(
+        self.I2C_SEQ_COMMAND_ReadExt,
+        self:__combineConditions(tCmd.conditions),
+        tCmd.address,
+        tCmd.retries,
+        ucLen0, ucLen1, ucLen2, ucLen3
+      ))
+    else
+      local ucLen0, ucLen1 = self:__uint16_to_bytes(ulLen)
+      table.insert(astrMacro, string.char(
+        self.I2C_SEQ_COMMAND_Read,
+        self:__combineConditions(tCmd.conditions),
+        tCmd.address,
+        tCmd.retries,
+        ucLen0, ucLen1
+      ))
+    end
+
+  elseif tCmd.cmd=='readdelta' then
+    -- The result has one byte for the type and at most all data bytes.
+    sizRx = sizRx + 1 + tCmd.length
+
+    local ucLen0, ucLen1 = self:__uint16_to_bytes(tCmd.length)
+    local ucSnapshot0, ucSnapshot1 = self:__uint16_to_bytes(tCmd.snapshot)
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_ReadDelta,
+      tCmd.address,
+      tCmd.retries,
+      ucLen0, ucLen1,
+      ucSnapshot0, ucSnapshot1
+    ))
+
+  elseif tCmd.cmd=='write' and tCmd.addresses~=nil then
+    local sizData = string.len(tCmd.data)
+    if sizData>0xffff then
+      tLog.error('A write to several addresses is limited to 65535 bytes.')
+      error('Too much data.')
+    end
+    local ucLen0, ucLen1 = self:__uint16_to_bytes(sizData)
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_WriteMulti,
+      self:__combineConditions(tCmd.conditions),
+      tCmd.retries,
+      #tCmd.addresses,
+      ucLen0, ucLen1
+    ))
+    for _, ucAddress in ipairs(tCmd.addresses) do
+      table.insert(astrMacro, string.char(ucAddress))
+    end
+    table.insert(astrMacro, tCmd.data)
+
+  elseif tCmd.cmd=='write' and string.len(tCmd.data)>0xffff then
+    -- Use the extended command for more than 16 bits of length.
+    local ucLen0, ucLen1, ucLen2, ucLen3 = self:__uint32_to_bytes(string.len(tCmd.data))
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_WriteExt,
+      self:__combineConditions(tCmd.conditions),
+      tCmd.address,
+      tCmd.retries,
+      ucLen0, ucLen1, ucLen2, ucLen3
+    ))
+    table.insert(astrMacro, tCmd.data)
+
+  elseif tCmd.cmd=='write' then
+    local sizData = string.len(tCmd.data)
+    local ucLen0, ucLen1 = self:__uint16_to_bytes(sizData)
+    -- Use the packed data if it is smaller than the raw data and the
+    -- larger header of the RLE command.
+    local strPacked = self:__rle_compress(tCmd.data)
+    local sizPacked = string.len(strPacked)
+    if (sizPacked+2)<sizData then
+      local ucPacked0, ucPacked1 = self:__uint16_to_bytes(sizPacked)
+      table.insert(astrMacro, string.char(
+        self.I2C_SEQ_COMMAND_WriteRle,
+        self:__combineConditions(tCmd.conditions),
+        tCmd.address,
+        tCmd.retries,
+        ucLen0, ucLen1,
+        ucPacked0, ucPacked1
+      ))
+      table.insert(astrMacro, strPacked)
+    else
+      table.insert(astrMacro, string.char(
+        self.I2C_SEQ_COMMAND_Write,
+        self:__combineConditions(tCmd.conditions),
+        tCmd.address,
+        tCmd.retries,
+        ucLen0, ucLen1
+      ))
+      table.insert(astrMacro, tCmd.data)
+    end
+
+  elseif tCmd.cmd=='smbus' then
+    sizRx = sizRx + tCmd.read
+
+    local ucFlags = 0
+    if tCmd.pec==true then
+      ucFlags = self.I2C_SMBUS_FLAGS_Pec
+    end
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_Smbus,
+      tCmd.protocol,
+      ucFlags,
+      tCmd.address,
+      tCmd.retries,
+      tCmd.command,
+      tCmd.size
+    ))
+    table.insert(astrMacro, tCmd.data)
+
+  elseif tCmd.cmd=='rmw' then
+    local ucRegister0, ucRegister1 = self:__uint16_to_bytes(tCmd.register)
+    local ucAnd0, ucAnd1 = self:__uint16_to_bytes(tCmd.andmask)
+    local ucOr0, ucOr1 = self:__uint16_to_bytes(tCmd.ormask)
+    local ucXor0, ucXor1 = self:__uint16_to_bytes(tCmd.xormask)
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_Rmw,
+      tCmd.flags,
+      tCmd.address,
+      tCmd.retries,
+      ucRegister0, ucRegister1,
+      ucAnd0, ucAnd1,
+      ucOr0, ucOr1,
+      ucXor0, ucXor1
+    ))
+
+  elseif tCmd.cmd=='ackpoll' then
+    local ucBudget0, ucBudget1 = self:__uint16_to_bytes(tCmd.budget)
+    local ucBackoff0, ucBackoff1 = self:__uint16_to_bytes(tCmd.backoff)
+    local ucBackoffMax0, ucBackoffMax1 = self:__uint16_to_bytes(tCmd.backoffmax)
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_AckPollPolicy,
+      ucBudget0, ucBudget1,
+      ucBackoff0, ucBackoff1,
+      ucBackoffMax0, ucBackoffMax1
+    ))
+
+  elseif tCmd.cmd=='delay' then
+    local ucDelay0, ucDelay1, ucDelay2, ucDelay3 = self:__uint32_to_bytes(tCmd.delay)
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_Delay,
+      ucDelay0, ucDelay1, ucDelay2, ucDelay3
+    ))
+
+  elseif tCmd.cmd=='mux' then
+    local ucFlags = 0
+    if tCmd.force==true then
+      ucFlags = self.I2C_MUX_SELECT_FLAGS_Force
+    end
+    table.insert(astrMacro, string.char(
+      self.I2C_SEQ_COMMAND_MuxSelect,
+      tCmd.address,
+      tCmd.retries,
+      tCmd.channels,
+      ucFlags
+    ))
+
+  else
+    tLog.error('Unknown command: "%s".', tCmd.cmd)
+    error('Unknown command.')
+  end
+
+  return sizRx
+end
+
+
+
+-- Translate a macro to a sequence for run_sequence.
+-- Pass the topology of the handle as "tTopology" to switch the multiplexers
+-- automatically, see setTopology. Each switch is an extra command of the
+-- sequence.
+function I2CNetx:parseI2cMacro(strMacro, tTopology)
   local lpeg = self.lpeg
   local tLog = self.tLog
   local pl = self.pl
 
   local uiExpectedReadData = 0
+  local tLayout
   local tResult = lpeg.match(self.tGrammarI2cMacro, strMacro)
   if tResult==nil then
     error('Failed to parse the macro...')
@@ -266,11 +876,49 @@ function I2CNetx:parseI2cMacro(strMacro)
         -- Was the last command a "start" command?
         if tCommandStack~=nil and tCommandStack.cmd=='start' then
           tCmd.conditions['start'] = true
+          self:__auto_mux_select(atCmdMerged, tTopology, tCmd.address)
         end
         -- Add the optional retries.
         local strRetries = tRawCommand.retries or self.ucDefaultRetries
         tCmd.retries = self:__parseNumber(strRetries)
+        -- Add the optional destination.
+        if tRawCommand.discard~=nil then
+          tCmd.discard = true
+        elseif tRawCommand.slot~=nil then
+          tCmd.slot = tRawCommand.slot
+        end
+        if (tCmd.discard==true or tCmd.slot~=nil) and tCmd.length>0xffff then
+          tLog.error('A read with a destination is limited to 65535 bytes.')
+          error('Too much data.')
+        end
+
+        table.insert(atCmdMerged, tCmd)
+        tCommandStack = tCmd
+      elseif strCmd=='readdelta' then
+        -- Create a new delta read command. It is a complete transaction
+        -- with its own START and STOP conditions.
+        if tCommandStack~=nil and tCommandStack.cmd=='start' then
+          tLog.error('A "readdelta" command can not follow a "start" command.')
+          error('Invalid position of start command.')
+        end
+        local tCmd = {
+          cmd = 'readdelta',
+          address = self:__parseNumber(tRawCommand.address),
+          length = self:__parseNumber(tRawCommand.length),
+          snapshot = self:__parseNumber(tRawCommand.snapshot)
+        }
+        if tCmd.length<1 or tCmd.length>self.I2C_READ_DELTA_MAX then
+          tLog.error('The delta read in command %d has %d bytes. It must be 1-%d.', uiCommandCnt, tCmd.length, self.I2C_READ_DELTA_MAX)
+          error('Invalid length.')
+        end
+        if (tCmd.snapshot % 4)~=0 or (tCmd.snapshot + 4 + tCmd.length)>self.I2C_SNAPSHOT_AREA_SIZE then
+          tLog.error('The snapshot offset 0x%x in command %d must be 32 bit aligned and fit into the snapshot area.', tCmd.snapshot, uiCommandCnt)
+          error('Invalid snapshot.')
+        end
+        local strRetries = tRawCommand.retries or self.ucDefaultRetries
+        tCmd.retries = self:__parseNumber(strRetries)
 
+        self:__auto_mux_select(atCmdMerged, tTopology, tCmd.address)
         table.insert(atCmdMerged, tCmd)
         tCommandStack = tCmd
       elseif strCmd=='write' then
@@ -278,49 +926,183 @@ function I2CNetx:parseI2cMacro(strMacro)
         local tCmd = {
           cmd = 'write',
           conditions = {},
-          address = self:__parseNumber(tRawCommand.address),
+          address = nil,
+          addresses = nil,
           data = nil
         }
+        if tRawCommand.addresses==nil then
+          tCmd.address = self:__parseNumber(tRawCommand.address)
+        else
+          -- All addresses get the same data. The data is stored only once.
+          local aucAddresses = {}
+          for _, strAddress in ipairs(tRawCommand.addresses) do
+            table.insert(aucAddresses, self:__parseNumber(strAddress))
+          end
+          if #aucAddresses>255 then
+            tLog.error('Command %d has %d addresses. The maximum is 255.', uiCommandCnt, #aucAddresses)
+            error('Too many addresses.')
+          elseif #aucAddresses==1 then
+            tCmd.address = aucAddresses[1]
+          else
+            tCmd.addresses = aucAddresses
+          end
+        end
         -- Was the last command a "start" command?
+        -- A write to several addresses needs a "select" command if the
+        -- devices are behind a multiplexer.
         if tCommandStack~=nil and tCommandStack.cmd=='start' then
           tCmd.conditions['start'] = true
+          if tCmd.address~=nil then
+            self:__auto_mux_select(atCmdMerged, tTopology, tCmd.address)
+          end
         end
         -- Add the optional retries.
         local strRetries = tRawCommand.retries or self.ucDefaultRetries
         tCmd.retries = self:__parseNumber(strRetries)
         -- Collect the data.
-        local astrData = {}
-        local astrReplace = {
-          ['\\"'] = '"',
-          ["\\'"] = "'",
-          ['\\a'] = '\a',
-          ['\\b'] = '\b',
-          ['\\f'] = '\f',
-          ['\\n'] = '\n',
-          ['\\r'] = '\r',
-          ['\\t'] = '\t',
-          ['\\v'] = '\v'
+        tCmd.data = self:__parseData(tRawCommand[1], uiCommandCnt)
+
+        table.insert(atCmdMerged, tCmd)
+        tCommandStack = tCmd
+      elseif strCmd=='ackpoll' then
+        -- Create a new ACK poll policy command. It applies to all following
+        -- read and write commands. The backoff doubles after each retry up
+        -- to the maximum. Without a maximum the backoff is fixed.
+        local tCmd = {
+          cmd = 'ackpoll',
+          budget = self:__parseNumber(tRawCommand.budget),
+          backoff = self:__parseNumber(tRawCommand.backoff)
         }
-        for uiDataElement, strData in ipairs(tRawCommand[1]) do
-          if string.sub(strData, 1, 1)=='"' or string.sub(strData, 1, 1)=="'" then
-            -- Unquote the string.
-            strData = string.sub(strData, 2, -2)
-            -- Unescape the string.
-            strData = string.gsub(strData, '(\\["\'abfnrtv])', astrReplace)
-            table.insert(astrData, strData)
-          else
-            local uiData = self:__parseNumber(strData)
-            if uiData<0 or uiData>255 then
-              tLog.error('Data element %d of command %d exceeds the 8 bit range: %d.', uiData, uiCommandCnt, tData)
-              error('Invalid data.')
-            end
-            table.insert(astrData, string.char(uiData))
+        tCmd.backoffmax = self:__parseNumber(tRawCommand.backoffmax or tRawCommand.backoff)
+        -- Do not replace the command stack. This keeps a previous "start"
+        -- for the next read or write command.
+        table.insert(atCmdMerged, tCmd)
+      elseif strCmd=='smbus' then
+        -- Create a new SMBus command. It is a complete transaction with
+        -- its own START and STOP conditions.
+        local tProtocol = self.atSmbusProtocols[tRawCommand.protocol]
+        local tCmd = {
+          cmd = 'smbus',
+          protocol = tProtocol.id,
+          pec = (tRawCommand.pec~=nil),
+          address = self:__parseNumber(tRawCommand.address),
+          command = self:__parseNumber(tRawCommand.command),
+          retries = self.ucDefaultRetries,
+          size = 0,
+          read = tProtocol.read,
+          data = ''
+        }
+        local ulValue
+        if tRawCommand.value~=nil then
+          ulValue = self:__parseNumber(tRawCommand.value)
+        end
+        if tProtocol.write==nil then
+          -- A block write has a data definition.
+          if tRawCommand[1]==nil then
+            tLog.error('The SMBus command %d needs a data definition.', uiCommandCnt)
+            error('Missing data.')
+          end
+          tCmd.data = self:__parseData(tRawCommand[1], uiCommandCnt)
+          tCmd.size = string.len(tCmd.data)
+          if tCmd.size<1 or tCmd.size>255 then
+            tLog.error('The SMBus block write in command %d has %d bytes. It must be 1-255.', uiCommandCnt, tCmd.size)
+            error('Invalid data.')
+          end
+        elseif tRawCommand[1]~=nil then
+          tLog.error('The SMBus command %d does not accept a data definition.', uiCommandCnt)
+          error('Invalid data.')
+        elseif tProtocol.read==nil then
+          -- A block read has the maximum count.
+          if ulValue==nil or ulValue<1 or ulValue>255 then
+            tLog.error('The SMBus block read in command %d needs a maximum count of 1-255.', uiCommandCnt)
+            error('Invalid count.')
           end
+          tCmd.size = ulValue
+          tCmd.read = 1 + ulValue
+        elseif tProtocol.write==0 then
+          if ulValue~=nil then
+            tLog.error('The SMBus command %d does not accept a value.', uiCommandCnt)
+            error('Invalid value.')
+          end
+        else
+          -- Write the value with the low byte first.
+          if ulValue==nil or ulValue<0 or ulValue>=2^(8*tProtocol.write) then
+            tLog.error('The SMBus command %d needs a %d bit value.', uiCommandCnt, 8*tProtocol.write)
+            error('Invalid value.')
+          end
+          local ucValue0, ucValue1 = self:__uint16_to_bytes(ulValue)
+          tCmd.size = tProtocol.write
+          tCmd.data = string.sub(string.char(ucValue0, ucValue1), 1, tProtocol.write)
         end
-        tCmd.data = table.concat(astrData)
-
+        self:__auto_mux_select(atCmdMerged, tTopology, tCmd.address)
+        table.insert(atCmdMerged, tCmd)
+        tCommandStack = tCmd
+      elseif strCmd=='rmw' then
+        -- Create a new read-modify-write command. It is a complete
+        -- transaction with its own START and STOP conditions.
+        local tCmd = {
+          cmd = 'rmw',
+          flags = 0,
+          address = self:__parseNumber(tRawCommand.address),
+          register = self:__parseNumber(tRawCommand.register),
+          andmask = self:__parseNumber(tRawCommand.andmask),
+          ormask = self:__parseNumber(tRawCommand.ormask),
+          xormask = self:__parseNumber(tRawCommand.xormask or '0'),
+          retries = self.ucDefaultRetries
+        }
+        local atOptions = {}
+        for _, strOption in ipairs(tRawCommand.options or {}) do
+          if atOptions[strOption]==nil then
+            atOptions[strOption] = true
+            tCmd.flags = tCmd.flags + self.atRmwOptions[strOption]
+          end
+        end
+        -- Check the ranges.
+        local ulRegisterMax = atOptions.reg16 and 0xffff or 0xff
+        local ulDataMax = atOptions.data16 and 0xffff or 0xff
+        if tCmd.register>ulRegisterMax then
+          tLog.error('The register 0x%x in command %d exceeds the register address size.', tCmd.register, uiCommandCnt)
+          error('Invalid register.')
+        end
+        if tCmd.andmask>ulDataMax or tCmd.ormask>ulDataMax or tCmd.xormask>ulDataMax then
+          tLog.error('A mask in command %d exceeds the register size.', uiCommandCnt)
+          error('Invalid mask.')
+        end
+        self:__auto_mux_select(atCmdMerged, tTopology, tCmd.address)
         table.insert(atCmdMerged, tCmd)
         tCommandStack = tCmd
+      elseif strCmd=='select' or strCmd=='mux' then
+        -- A multiplexer is selected with a complete transaction.
+        if tCommandStack~=nil and tCommandStack.cmd=='start' then
+          tLog.error('A "%s" command can not follow a "start" command.', strCmd)
+          error('Invalid position of start command.')
+        end
+        local fForce = (tRawCommand.force~=nil)
+        if strCmd=='select' then
+          local tDevice
+          if tTopology~=nil then
+            tDevice = tTopology.devices[tRawCommand.device]
+          end
+          if tDevice==nil then
+            tLog.error('The device "%s" in command %d is not in the topology.', tRawCommand.device, uiCommandCnt)
+            error('Unknown device.')
+          end
+          self:__add_mux_select(atCmdMerged, tTopology, tDevice, fForce)
+        else
+          local tCmd = {
+            cmd = 'mux',
+            address = self:__parseNumber(tRawCommand.address),
+            channels = self:__parseNumber(tRawCommand.channels),
+            force = fForce,
+            retries = self.ucDefaultRetries
+          }
+          if tCmd.channels>0xff then
+            tLog.error('The channels 0x%x in command %d exceed 8 bits.', tCmd.channels, uiCommandCnt)
+            error('Invalid channels.')
+          end
+          table.insert(atCmdMerged, tCmd)
+        end
+        tCommandStack = atCmdMerged[#atCmdMerged]
       elseif strCmd=='delay' then
         -- Create a new delay command.
         local tCmd = {
@@ -334,152 +1116,2645 @@ function I2CNetx:parseI2cMacro(strMacro)
 
 --    pl.pretty.dump(atCmdMerged)
 
-    -- Loop over all merged commands and generate a binary stream.
-    local astrMacro = {}
+    -- Assign an offset in the slot area to each slot. The size of a slot is
+    -- the largest read to it.
+    local atSlots = {}
+    local atSlotNames = {}
     for _, tCmd in ipairs(atCmdMerged) do
-      if tCmd.cmd=='read' then
-        local usLen = tCmd.length
-        uiExpectedReadData = uiExpectedReadData + usLen
-
-        local ucLen0, ucLen1 = self:__uint16_to_bytes(usLen)
-        table.insert(astrMacro, string.char(
-          self.I2C_SEQ_COMMAND_Read,
-          self:__combineConditions(tCmd.conditions),
-          tCmd.address,
-          tCmd.retries,
-          ucLen0, ucLen1
-        ))
-
-      elseif tCmd.cmd=='write' then
-        local ucLen0, ucLen1 = self:__uint16_to_bytes(string.len(tCmd.data))
-        table.insert(astrMacro, string.char(
-          self.I2C_SEQ_COMMAND_Write,
-          self:__combineConditions(tCmd.conditions),
-          tCmd.address,
-          tCmd.retries,
-          ucLen0, ucLen1
-        ))
-        table.insert(astrMacro, tCmd.data)
-
-      elseif tCmd.cmd=='delay' then
-        local ucDelay0, ucDelay1, ucDelay2, ucDelay3 = self:__uint32_to_bytes(tCmd.delay)
-        table.insert(astrMacro, string.char(
-          self.I2C_SEQ_COMMAND_Delay,
-          ucDelay0, ucDelay1, ucDelay2, ucDelay3
-        ))
+      if tCmd.slot~=nil then
+        local tSlot = atSlots[tCmd.slot]
+        if tSlot==nil then
+          tSlot = { length=0 }
+          atSlots[tCmd.slot] = tSlot
+          table.insert(atSlotNames, tCmd.slot)
+        end
+        tSlot.length = math.max(tSlot.length, tCmd.length)
+      end
+    end
+    local sizSlotArea = 0
+    for _, strName in ipairs(atSlotNames) do
+      local tSlot = atSlots[strName]
+      tSlot.offset = sizSlotArea
+      sizSlotArea = sizSlotArea + tSlot.length
+    end
+    if sizSlotArea>0xffff then
+      tLog.error('The slots need %d bytes. The maximum is 65535.', sizSlotArea)
+      error('Too many slots.')
+    end
+    uiExpectedReadData = sizSlotArea
 
-      else
-        tLog.error('Unknown command: "%s".', tCmd.cmd)
-        error('Unknown command.')
+    -- Loop over all merged commands and generate a binary stream.
+    local astrMacro = {}
+    local atCommandNames = {}
+    for uiCmdIndex, tCmd in ipairs(atCmdMerged) do
+      if tCmd.slot~=nil then
+        atCommandNames[uiCmdIndex] = tCmd.slot
       end
+      uiExpectedReadData = uiExpectedReadData + self:__encodeCommand(tCmd, astrMacro, atSlots)
     end
 
     tResult = table.concat(astrMacro)
+
+    -- Pass this to run_sequence to get the data of each command.
+    tLayout = {
+      commands = #atCmdMerged,
+      slot_area = sizSlotArea,
+      names = atCommandNames
+    }
   end
 
-  return tResult, uiExpectedReadData
+  return tResult, uiExpectedReadData, tLayout
 end
 
 
 
-function I2CNetx:openDevice(tHandle, tCoreID, ucMMIO_SCL, ucMMIO_SDA, usPortcontrol_SCL, usPortcontrol_SDA)
-  ucMMIO_SCL = ucMMIO_SCL or 0xff
-  ucMMIO_SDA = ucMMIO_SDA or 0xff
-  usPortcontrol_SCL = usPortcontrol_SCL or 0xffff
-  usPortcontrol_SDA = usPortcontrol_SDA or 0xffff
+-- Analyze a sequence from parseI2cMacro without the netX. The sequence is
+-- checked with the same rules as the sequence interpreter on the netX.
+-- These options are possible, all are optional:
+--   speed:       the bus speed in kbit/s for the time estimate, default 100
+--   rx_max:      the size of the RX buffer, default unlimited
+--   slot_area:   the size of the slot area at the start of the RX buffer,
+--                default 0
+--   snapshot:    the size of the snapshot area, default I2C_SNAPSHOT_AREA_SIZE
+--   ackpoll_max: the hardware limit for the ACK poll, see getCapabilities
+--   overhead_us: the time of the netX for each command, default 0
+-- On success the function returns a table with these fields:
+--   commands:    the number of commands
+--   rx_size:     the size of the RX buffer for run_sequence including the
+--                slot area. The result of a "readdelta" can be smaller.
+--   tx_bytes:    the bytes sent by the master including the address bytes
+--   rx_bytes:    the bytes sent by the devices. This is the maximum for
+--                SMBus block reads.
+--   wire_bytes:  the sum of tx_bytes and rx_bytes
+--   starts:      the number of START and repeated START conditions
+--   stops:       the number of STOP conditions
+--   delay_ms:    the sum of all delays
+--   time_us:     the estimated time if all devices acknowledge at once
+--   time_max_us: the estimated time with the maximum ACK polling of all
+--                commands
+--   slot_end:    the end of the last slot which is used by a "read" to a
+--                slot. This is the minimum size of the slot area.
+--   command_list: a list with one entry for each command. Each entry has
+--                the offset of the command in the sequence ("offset"), its
+--                size in the sequence ("size"), the size of its received
+--                data ("rx_size") and the flag "bus_free", which is true if
+--                the bus is free after the command. splitSequence uses it.
+-- The time of a byte is 9 clocks, START and STOP count as 1 clock. A
+-- MuxSelect is counted although the netX skips it if the channels are in
+-- its cache.
+-- On failure the function returns nil and an error record with the fields
+-- "class", "offset" and "index" like run_sequence.
+function I2CNetx:analyzeSequence(strSequence, tOptions)
   local tLog = self.tLog
-  local tester = _G.tester
-  local aAttr = tHandle.attr
-
-  -- Setup a basic layout of the buffer:
-  --   * Parameter (fixed size: 64 bytes)
-  --   * Handle (fixed size: I2C_HANDLE_SIZE bytes)
-  --   * RX/TX buffer
-  tHandle.ulHandleAddress = aAttr.ulParameterStartAddress + 64
-  tHandle.ulBufferAddress = aAttr.ulParameterStartAddress + 64 + self.I2C_HANDLE_SIZE
-
-  -- Combine all options.
-  local ucCore0, ucCore1 = self:__uint16_to_bytes(tCoreID)
-  local ucPSCL0, ucPSCL1 = self:__uint16_to_bytes(usPortcontrol_SCL)
-  local ucPSDA0, ucPSDA1 = self:__uint16_to_bytes(usPortcontrol_SDA)
-  local strOptions = string.char(
-    ucCore0, ucCore1,
-    ucMMIO_SCL,
-    ucMMIO_SDA,
-    ucPSCL0, ucPSCL1,
-    ucPSDA0, ucPSDA1
-  )
+  tOptions = tOptions or {}
+  local ulSpeed = tOptions.speed or 100
+  local sizRxMax = tOptions.rx_max
+  local sizSlotArea = tOptions.slot_area or 0
+  local sizSnapshot = tOptions.snapshot or self.I2C_SNAPSHOT_AREA_SIZE
+  local ulAckPollMax = tOptions.ackpoll_max
+  local ulOverheadUs = tOptions.overhead_us or 0
+
+  local sizSequence = string.len(strSequence)
+
+  -- Test a bit of a flag value.
+  local function isSet(ulValue, ulFlag)
+    return (math.floor(ulValue / ulFlag) % 2)==1
+  end
+  local function getUint16(uiPos)
+    local ucB0, ucB1 = string.byte(strSequence, uiPos, uiPos+1)
+    return ucB0 + 0x0100*ucB1
+  end
 
-  local tPlugin = tHandle.plugin
-  if tPlugin==nil then
-    tLog.error('The handle has no "plugin" set.')
-  else
-    -- Run the command.
-    local aParameter = {
-      0xffffffff,    -- verbose
-      self.I2C_CMD_Open,
-      tHandle.ulHandleAddress
-    }
-    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
-    -- Append the options.
-    tester:stdWrite(tPlugin, aAttr.ulParameterStartAddress+0x18, strOptions)
+  -- Get the SMBus protocols by ID.
+  local atSmbusProtocols = {}
+  for _, tProtocol in pairs(self.atSmbusProtocols) do
+    atSmbusProtocols[tProtocol.id] = tProtocol
+  end
 
-    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
-    if ulValue~=0 then
-      tLog.error('Failed to open the device.')
-      error('Failed to open the device.')
+  local tResult = {
+    commands = 0,
+    rx_size = sizSlotArea,
+    tx_bytes = 0,
+    rx_bytes = 0,
+    wire_bytes = 0,
+    starts = 0,
+    stops = 0,
+    delay_ms = 0,
+    time_us = 0,
+    time_max_us = 0,
+    slot_end = 0,
+    command_list = {}
+  }
+  -- This is true between a START and a STOP condition.
+  local fBusOpen = false
+  local ulAckPollBudgetMs = 0
+  local ulAckPollBackoffMaxMs = 0
+  -- This is the worst case time for all ACK polls in microseconds.
+  local ulAckPollUs = 0
+  local ulBitUs = 1000 / ulSpeed
+
+  -- Count a START with the address byte. The hardware repeats the address
+  -- up to uiAckPoll times, the software ACK poll repeats the command until
+  -- the budget is exhausted.
+  local function addStart(uiAckPoll)
+    fBusOpen = true
+    tResult.starts = tResult.starts + 1
+    tResult.tx_bytes = tResult.tx_bytes + 1
+    if uiAckPoll~=nil then
+      if ulAckPollMax~=nil and uiAckPoll>ulAckPollMax then
+        uiAckPoll = ulAckPollMax
+      end
+      ulAckPollUs = ulAckPollUs + uiAckPoll * 10 * ulBitUs
+      if ulAckPollBudgetMs~=0 then
+        ulAckPollUs = ulAckPollUs + (ulAckPollBudgetMs + ulAckPollBackoffMaxMs) * 1000
+      end
     end
   end
-end
-
+  local function addStop()
+    fBusOpen = false
+    tResult.stops = tResult.stops + 1
+  end
 
+  local strError
+  local strErrorMessage
+  local uiPos = 1
+  local uiCmdIndex = 0
+  local uiCmdStart = 1
+  if sizRxMax~=nil and sizSlotArea>sizRxMax then
+    strError = 'InvalidParameter'
+    strErrorMessage = string.format('The slot area with %d bytes exceeds the RX buffer.', sizSlotArea)
+    -- Skip all commands.
+    uiPos = sizSequence + 1
+  end
+  while uiPos<=sizSequence do
+    uiCmdStart = uiPos
+    local ucCmd = string.byte(strSequence, uiPos)
+    uiPos = uiPos + 1
+    local sizRx = 0
+
+    -- Get the size of the header for the truncation check.
+    local sizHeader
+    if ucCmd==self.I2C_SEQ_COMMAND_Read or ucCmd==self.I2C_SEQ_COMMAND_Write then
+      sizHeader = 5
+    elseif ucCmd==self.I2C_SEQ_COMMAND_ReadExt or ucCmd==self.I2C_SEQ_COMMAND_WriteExt or ucCmd==self.I2C_SEQ_COMMAND_WriteRle then
+      sizHeader = 7
+    elseif ucCmd==self.I2C_SEQ_COMMAND_Delay or ucCmd==self.I2C_SEQ_COMMAND_MuxSelect then
+      sizHeader = 4
+    elseif ucCmd==self.I2C_SEQ_COMMAND_AckPollPolicy or ucCmd==self.I2C_SEQ_COMMAND_Smbus or ucCmd==self.I2C_SEQ_COMMAND_ReadDelta then
+      sizHeader = 6
+    elseif ucCmd==self.I2C_SEQ_COMMAND_WriteMulti then
+      sizHeader = 5
+    elseif ucCmd==self.I2C_SEQ_COMMAND_Rmw then
+      sizHeader = 11
+    elseif ucCmd==self.I2C_SEQ_COMMAND_ReadTo then
+      sizHeader = 8
+    else
+      strError = 'InvalidCommand'
+      strErrorMessage = string.format('Invalid command 0x%02x.', ucCmd)
+      break
+    end
+    if (uiPos + sizHeader - 1)>sizSequence then
+      strError = 'CommandTruncated'
+      strErrorMessage = 'Not enough data for the header left.'
+      break
+    end
 
-function I2CNetx:run_sequence(tHandle, strSequence, sizExpectedRxData)
-  local tLog = self.tLog
-  local tester = _G.tester
-  local tResult
+    if ucCmd==self.I2C_SEQ_COMMAND_Read or ucCmd==self.I2C_SEQ_COMMAND_ReadExt or ucCmd==self.I2C_SEQ_COMMAND_Write or ucCmd==self.I2C_SEQ_COMMAND_WriteExt then
+      local ucConditions, _, ucAckPoll = string.byte(strSequence, uiPos, uiPos+2)
+      local ulDataSize
+      if sizHeader==5 then
+        ulDataSize = getUint16(uiPos+3)
+      else
+        ulDataSize = self:__bytes_to_uint32(strSequence, uiPos+3)
+      end
+      uiPos = uiPos + sizHeader
+      if isSet(ucConditions, self.I2C_SEQ_CONDITION_Start) then
+        addStart(ucAckPoll)
+      end
+      if ucCmd==self.I2C_SEQ_COMMAND_Read or ucCmd==self.I2C_SEQ_COMMAND_ReadExt then
+        sizRx = ulDataSize
+        tResult.rx_bytes = tResult.rx_bytes + ulDataSize
+      else
+        if (uiPos + ulDataSize - 1)>sizSequence then
+          strError = 'CommandTruncated'
+          strErrorMessage = 'Not enough data for the complete write command left.'
+          break
+        end
+        uiPos = uiPos + ulDataSize
+        tResult.tx_bytes = tResult.tx_bytes + ulDataSize
+      end
+      if isSet(ucConditions, self.I2C_SEQ_CONDITION_Stop) then
+        addStop()
+      end
 
-  local aAttr = tHandle.attr
+    elseif ucCmd==self.I2C_SEQ_COMMAND_Delay then
+      tResult.delay_ms = tResult.delay_ms + self:__bytes_to_uint32(strSequence, uiPos)
+      uiPos = uiPos + sizHeader
+
+    elseif ucCmd==self.I2C_SEQ_COMMAND_WriteRle then
+      local ucConditions, _, ucAckPoll = string.byte(strSequence, uiPos, uiPos+2)
+      local sizData = getUint16(uiPos+3)
+      local sizPacked = getUint16(uiPos+5)
+      uiPos = uiPos + sizHeader
+      if (uiPos + sizPacked - 1)>sizSequence then
+        strError = 'CommandTruncated'
+        strErrorMessage = 'Not enough data for the complete RLE write command left.'
+        break
+      elseif self:__rle_validate(string.sub(strSequence, uiPos, uiPos + sizPacked - 1), sizData)~=true then
+        strError = 'InvalidData'
+        strErrorMessage = 'The packed data is invalid.'
+        break
+      end
+      uiPos = uiPos + sizPacked
+      if isSet(ucConditions, self.I2C_SEQ_CONDITION_Start) then
+        addStart(ucAckPoll)
+      end
+      tResult.tx_bytes = tResult.tx_bytes + sizData
+      if isSet(ucConditions, self.I2C_SEQ_CONDITION_Stop) then
+        addStop()
+      end
 
-  local sizTxBuffer = string.len(strSequence)
-  local pucTxBuffer = tHandle.ulBufferAddress
-  local pucRxBuffer = tHandle.ulBufferAddress + sizTxBuffer
+    elseif ucCmd==self.I2C_SEQ_COMMAND_AckPollPolicy then
+      ulAckPollBudgetMs = getUint16(uiPos)
+      ulAckPollBackoffMaxMs = getUint16(uiPos+4)
+      uiPos = uiPos + sizHeader
+
+    elseif ucCmd==self.I2C_SEQ_COMMAND_WriteMulti then
+      local ucConditions, ucAckPoll, ucAddresses = string.byte(strSequence, uiPos, uiPos+2)
+      local sizData = getUint16(uiPos+3)
+      uiPos = uiPos + sizHeader
+      if (uiPos + ucAddresses + sizData - 1)>sizSequence then
+        strError = 'CommandTruncated'
+        strErrorMessage = 'Not enough data for the complete multi write command left.'
+        break
+      elseif ucAddresses==0 or (ucAddresses>1 and isSet(ucConditions, self.I2C_SEQ_CONDITION_Start)==false) then
+        strError = 'InvalidParameter'
+        strErrorMessage = 'A multi write needs at least one address and a START condition for more than one address.'
+        break
+      end
+      uiPos = uiPos + ucAddresses + sizData
+      for uiCnt=1,ucAddresses do
+        if isSet(ucConditions, self.I2C_SEQ_CONDITION_Start) then
+          addStart(ucAckPoll)
+        end
+        tResult.tx_bytes = tResult.tx_bytes + sizData
+        if isSet(ucConditions, self.I2C_SEQ_CONDITION_Stop) then
+          addStop()
+        end
+      end
 
-  local tPlugin = tHandle.plugin
+    elseif ucCmd==self.I2C_SEQ_COMMAND_Smbus then
+      local ucProtocol, ucFlags, _, ucAckPoll, _, ucSize = string.byte(strSequence, uiPos, uiPos+5)
+      uiPos = uiPos + sizHeader
+      local tProtocol = atSmbusProtocols[ucProtocol]
+      local sizWrite
+      local sizRead
+      local fIsBlock = false
+      if tProtocol==nil then
+        sizWrite = nil
+      elseif tProtocol.write==nil then
+        -- A block write has the count and 1-255 bytes.
+        fIsBlock = true
+        if ucSize~=0 then
+          sizWrite = ucSize
+          sizRead = 0
+        end
+      elseif tProtocol.read==nil then
+        -- A block read has the count and up to the maximum count.
+        fIsBlock = true
+        if ucSize~=0 then
+          sizWrite = 0
+          sizRead = 1 + ucSize
+        end
+      elseif ucSize==tProtocol.write then
+        sizWrite = tProtocol.write
+        sizRead = tProtocol.read
+      end
+      if sizWrite==nil then
+        strError = 'InvalidParameter'
+        strErrorMessage = string.format('Invalid SMBus protocol %d with size %d.', ucProtocol, ucSize)
+        break
+      elseif (uiPos + sizWrite - 1)>sizSequence then
+        strError = 'CommandTruncated'
+        strErrorMessage = 'Not enough data for the complete SMBus command left.'
+        break
+      end
+      uiPos = uiPos + sizWrite
+      local sizPec = 0
+      if isSet(ucFlags, self.I2C_SMBUS_FLAGS_Pec) then
+        sizPec = 1
+      end
+      -- The write phase has the command code and the data.
+      addStart(ucAckPoll)
+      tResult.tx_bytes = tResult.tx_bytes + 1 + sizWrite
+      if fIsBlock==true and sizWrite~=0 then
+        tResult.tx_bytes = tResult.tx_bytes + 1
+      end
+      if sizRead==0 then
+        tResult.tx_bytes = tResult.tx_bytes + sizPec
+      else
+        -- The read phase starts with a repeated START.
+        addStart(nil)
+        tResult.rx_bytes = tResult.rx_bytes + sizRead + sizPec
+        sizRx = sizRead
+      end
+      addStop()
+
+    elseif ucCmd==self.I2C_SEQ_COMMAND_Rmw then
+      local ucFlags, _, ucAckPoll = string.byte(strSequence, uiPos, uiPos+2)
+      uiPos = uiPos + sizHeader
+      local sizRegister = 1
+      if isSet(ucFlags, self.atRmwOptions.reg16) then
+        sizRegister = 2
+      end
+      local sizData = 1
+      if isSet(ucFlags, self.atRmwOptions.data16) then
+        sizData = 2
+      end
+      local uiReads = 1
+      if isSet(ucFlags, self.atRmwOptions.verify) then
+        uiReads = 2
+      end
+      -- Each read is a write of the register address and a read with a
+      -- repeated START.
+      for uiCnt=1,uiReads do
+        addStart(ucAckPoll)
+        tResult.tx_bytes = tResult.tx_bytes + sizRegister
+        addStart(nil)
+        tResult.rx_bytes = tResult.rx_bytes + sizData
+        addStop()
+      end
+      addStart(ucAckPoll)
+      tResult.tx_bytes = tResult.tx_bytes + sizRegister + sizData
+      addStop()
+
+    elseif ucCmd==self.I2C_SEQ_COMMAND_ReadDelta then
+      local _, ucAckPoll = string.byte(strSequence, uiPos, uiPos+1)
+      local sizData = getUint16(uiPos+2)
+      local usSnapshot = getUint16(uiPos+4)
+      uiPos = uiPos + sizHeader
+      if sizData==0 or sizData>self.I2C_READ_DELTA_MAX or (usSnapshot % 4)~=0 or (usSnapshot + 4 + sizData)>sizSnapshot then
+        strError = 'InvalidParameter'
+        strErrorMessage = string.format('Invalid delta read of %d bytes with the snapshot at 0x%04x.', sizData, usSnapshot)
+        break
+      end
+      addStart(ucAckPoll)
+      tResult.rx_bytes = tResult.rx_bytes + sizData
+      addStop()
+      sizRx = 1 + sizData
+
+    elseif ucCmd==self.I2C_SEQ_COMMAND_ReadTo then
+      local ucConditions, _, ucAckPoll = string.byte(strSequence, uiPos, uiPos+2)
+      local sizData = getUint16(uiPos+3)
+      local ucDestination = string.byte(strSequence, uiPos+5)
+      local usSlot = getUint16(uiPos+6)
+      uiPos = uiPos + sizHeader
+      if ucDestination==self.I2C_READ_DESTINATION_Append then
+        sizRx = sizData
+      elseif ucDestination==self.I2C_READ_DESTINATION_Slot then
+        if (usSlot + sizData)>sizSlotArea then
+          strError = 'InvalidParameter'
+          strErrorMessage = string.format('The slot at offset 0x%04x with %d bytes exceeds the slot area.', usSlot, sizData)
+          break
+        end
+        tResult.slot_end = math.max(tResult.slot_end, usSlot + sizData)
+      elseif ucDestination~=self.I2C_READ_DESTINATION_Discard then
+        strError = 'InvalidParameter'
+        strErrorMessage = string.format('Invalid destination: %d', ucDestination)
+        break
+      end
+      if isSet(ucConditions, self.I2C_SEQ_CONDITION_Start) then
+        addStart(ucAckPoll)
+      end
+      tResult.rx_bytes = tResult.rx_bytes + sizData
+      if isSet(ucConditions, self.I2C_SEQ_CONDITION_Stop) then
+        addStop()
+      end
+
+    elseif ucCmd==self.I2C_SEQ_COMMAND_MuxSelect then
+      local _, ucAckPoll = string.byte(strSequence, uiPos, uiPos+1)
+      uiPos = uiPos + sizHeader
+      addStart(ucAckPoll)
+      tResult.tx_bytes = tResult.tx_bytes + 1
+      addStop()
+    end
+
+    -- Check the space for the received data.
+    if sizRxMax~=nil and (tResult.rx_size + sizRx)>sizRxMax then
+      strError = 'RxOverflow'
+      strErrorMessage = 'Not enough space for the receive data left.'
+      break
+    end
+    tResult.rx_size = tResult.rx_size + sizRx
+
+    table.insert(tResult.command_list, {
+      offset = uiCmdStart - 1,
+      size = uiPos - uiCmdStart,
+      rx_size = sizRx,
+      bus_free = (fBusOpen==false)
+    })
+
+    uiCmdIndex = uiCmdIndex + 1
+  end
+
+  local tError
+  if strError~=nil then
+    tError = {
+      class = strError,
+      offset = uiCmdStart - 1,
+      index = uiCmdIndex
+    }
+    tLog.error('Command %d at offset %d is invalid: %s', tError.index, tError.offset, strErrorMessage)
+    tResult = nil
+  else
+    tResult.commands = uiCmdIndex
+    tResult.wire_bytes = tResult.tx_bytes + tResult.rx_bytes
+    local ulBits = 9 * tResult.wire_bytes + tResult.starts + tResult.stops
+    tResult.time_us = ulBits * ulBitUs + tResult.delay_ms * 1000 + tResult.commands * ulOverheadUs
+    tResult.time_max_us = tResult.time_us + ulAckPollUs
+  end
+
+  return tResult, tError
+end
+
+
+
+-- Set the devices behind multiplexers for a handle. Each entry of atDevices
+-- has these fields:
+--   name:    the name for the "select" command of a macro
+--   address: the address of the device
+--   mux:     the address of the multiplexer
+--   channel: the channel of the multiplexer with the device, 0-7
+-- All multiplexers must be on the root bus. Switching to a device selects
+-- its channel and deselects all other multiplexers.
+-- The topology is stored in tHandle.topology for parseI2cMacro. A read or
+-- write to an address which is only used by one device switches to it
+-- automatically. Other devices need a "select" command.
+-- The netX remembers the channels of up to 4 multiplexers in the handle and
+-- only writes them if they change.
+function I2CNetx:setTopology(tHandle, atDevices)
+  local tLog = self.tLog
+
+  local atMuxes = {}
+  local atMuxSeen = {}
+  local atDeviceByName = {}
+  local atDeviceByAddress = {}
+  for uiCnt, tEntry in ipairs(atDevices) do
+    local strName = tEntry.name
+    local ucAddress = tEntry.address
+    local ucMux = tEntry.mux
+    local uiChannel = tEntry.channel
+    if type(strName)~='string' or string.match(strName, '^[A-Za-z_][A-Za-z0-9_]*$')==nil then
+      tLog.error('Device %d has an invalid name.', uiCnt)
+      error('Invalid topology.')
+    elseif atDeviceByName[strName]~=nil then
+      tLog.error('The device name "%s" is used more than once.', strName)
+      error('Invalid topology.')
+    elseif type(ucAddress)~='number' or ucAddress<0 or ucAddress>0x7f or type(ucMux)~='number' or ucMux<0 or ucMux>0x7f then
+      tLog.error('The device "%s" has an invalid address or multiplexer.', strName)
+      error('Invalid topology.')
+    elseif type(uiChannel)~='number' or uiChannel<0 or uiChannel>7 then
+      tLog.error('The device "%s" has an invalid channel.', strName)
+      error('Invalid topology.')
+    end
+
+    local tDevice = {
+      name = strName,
+      address = ucAddress,
+      mux = ucMux,
+      channels = math.floor(2^uiChannel)
+    }
+    atDeviceByName[strName] = tDevice
+    if atMuxSeen[ucMux]==nil then
+      atMuxSeen[ucMux] = true
+      table.insert(atMuxes, ucMux)
+    end
+
+    -- An address is ambiguous if several devices on different channels
+    -- use it.
+    local tOther = atDeviceByAddress[ucAddress]
+    if tOther==nil then
+      atDeviceByAddress[ucAddress] = tDevice
+    elseif tOther~=false and (tOther.mux~=ucMux or tOther.channels~=tDevice.channels) then
+      atDeviceByAddress[ucAddress] = false
+    end
+  end
+  table.sort(atMuxes)
+
+  -- Remove the ambiguous addresses.
+  local atAddresses = {}
+  for ucAddress, tDevice in pairs(atDeviceByAddress) do
+    if tDevice~=false then
+      atAddresses[ucAddress] = tDevice
+    end
+  end
+
+  tHandle.topology = {
+    muxes = atMuxes,
+    devices = atDeviceByName,
+    addresses = atAddresses
+  }
+end
+
+
+
+-- Add the commands to switch the multiplexers to a device. The other
+-- multiplexers are deselected first, so only one path is active. Nothing
+-- happens if tDevice is nil.
+function I2CNetx:__add_mux_select(atCmdMerged, tTopology, tDevice, fForce)
+  if tDevice~=nil then
+    for _, ucMux in ipairs(tTopology.muxes) do
+      if ucMux~=tDevice.mux then
+        table.insert(atCmdMerged, {
+          cmd = 'mux',
+          address = ucMux,
+          channels = 0,
+          force = fForce,
+          retries = self.ucDefaultRetries
+        })
+      end
+    end
+    table.insert(atCmdMerged, {
+      cmd = 'mux',
+      address = tDevice.mux,
+      channels = tDevice.channels,
+      force = fForce,
+      retries = self.ucDefaultRetries
+    })
+  end
+end
+
+
+
+-- Switch the multiplexers to the device at an address before a new
+-- transaction. Nothing happens for an address which is not in the topology
+-- or in the middle of a transaction, e.g. before a repeated START.
+function I2CNetx:__auto_mux_select(atCmdMerged, tTopology, ucAddress)
+  if tTopology~=nil then
+    local tDevice = tTopology.addresses[ucAddress]
+    if tDevice~=nil then
+      -- Find the last command on the bus.
+      local tLast
+      for uiCnt=#atCmdMerged,1,-1 do
+        if atCmdMerged[uiCnt].cmd~='ackpoll' then
+          tLast = atCmdMerged[uiCnt]
+          break
+        end
+      end
+      if tLast==nil or (tLast.cmd~='read' and tLast.cmd~='write') or tLast.conditions['stop']==true then
+        self:__add_mux_select(atCmdMerged, tTopology, tDevice, false)
+      end
+    end
+  end
+end
+
+
+
+-- Open an I2C core. The handle is placed in the slot uiHandleSlot of the
+-- parameter area. Use a copy of the handle table with a different slot to
+-- open a second core, e.g. the slave for the benchmark.
+function I2CNetx:openDevice(tHandle, tCoreID, ucMMIO_SCL, ucMMIO_SDA, usPortcontrol_SCL, usPortcontrol_SDA, usClockStretchMs, uiHandleSlot)
+  ucMMIO_SCL = ucMMIO_SCL or 0xff
+  ucMMIO_SDA = ucMMIO_SDA or 0xff
+  usPortcontrol_SCL = usPortcontrol_SCL or 0xffff
+  usPortcontrol_SDA = usPortcontrol_SDA or 0xffff
+  -- The timeout of each command is the time on the bus plus this allowance
+  -- for clock stretching. The default is the SMBus limit of 25ms.
+  usClockStretchMs = usClockStretchMs or 25
+  tHandle.usClockStretchMs = usClockStretchMs
+  uiHandleSlot = uiHandleSlot or 0
+  if uiHandleSlot>=self.I2C_HANDLE_SLOTS then
+    error(string.format('Invalid handle slot: %d', uiHandleSlot))
+  end
+  local tLog = self.tLog
+  local tester = _G.tester
+  local aAttr = tHandle.attr
+
+  -- Setup a basic layout of the parameter area:
+  --   * Parameter (fixed size: 128 bytes)
+  --   * Handles (fixed size: I2C_HANDLE_SLOTS * I2C_HANDLE_SIZE bytes)
+  --   * RX/TX buffer, if the binary has no transfer arena
+  -- The RX/TX buffer uses the whole transfer arena between .bss and the
+  -- stack if the binary has one.
+  -- The snapshots of the "readdelta" commands are at the end of the
+  -- transfer arena. Each handle slot has its own area, so opening one
+  -- handle does not clear the snapshots of the other. There is no snapshot
+  -- area without the arena.
+  tHandle.ulHandleAddress = aAttr.ulParameterStartAddress + 128 + uiHandleSlot*self.I2C_HANDLE_SIZE
+  tHandle.ulSnapshotAddress = 0
+  tHandle.sizSnapshot = 0
+  tHandle.atSnapshots = {}
+  if aAttr.ulBufferStartAddress~=nil then
+    tHandle.ulBufferAddress = aAttr.ulBufferStartAddress
+    tHandle.ulBufferEndAddress = aAttr.ulBufferEndAddress - self.I2C_HANDLE_SLOTS*self.I2C_SNAPSHOT_AREA_SIZE
+    tHandle.ulSnapshotAddress = tHandle.ulBufferEndAddress + uiHandleSlot*self.I2C_SNAPSHOT_AREA_SIZE
+    tHandle.sizSnapshot = self.I2C_SNAPSHOT_AREA_SIZE
+  else
+    tHandle.ulBufferAddress = aAttr.ulParameterStartAddress + 128 + self.I2C_HANDLE_SLOTS*self.I2C_HANDLE_SIZE
+    tHandle.ulBufferEndAddress = aAttr.ulParameterEndAddress
+  end
+
+  -- Combine all options.
+  local ucCore0, ucCore1 = self:__uint16_to_bytes(tCoreID)
+  local ucPSCL0, ucPSCL1 = self:__uint16_to_bytes(usPortcontrol_SCL)
+  local ucPSDA0, ucPSDA1 = self:__uint16_to_bytes(usPortcontrol_SDA)
+  local ucStretch0, ucStretch1 = self:__uint16_to_bytes(usClockStretchMs)
+  local strOptions = string.char(
+    ucCore0, ucCore1,
+    ucMMIO_SCL,
+    ucMMIO_SDA,
+    ucPSCL0, ucPSCL1,
+    ucPSDA0, ucPSDA1,
+    ucStretch0, ucStretch1
+  )
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  else
+    -- Run the command.
+    local aParameter = {
+      0xffffffff,    -- verbose
+      self.I2C_CMD_Open,
+      tHandle.ulHandleAddress
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    -- Append the options.
+    tester:stdWrite(tPlugin, aAttr.ulParameterStartAddress+0x18, strOptions)
+
+    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.error('Failed to open the device.')
+      error('Failed to open the device.')
+    end
+
+    self:resetSnapshots(tHandle)
+  end
+end
+
+
+
+-- Invalidate all snapshots of the "readdelta" commands. The next delta read
+-- of each snapshot returns the full data.
+function I2CNetx:resetSnapshots(tHandle)
+  if tHandle.sizSnapshot~=0 then
+    _G.tester:stdWrite(tHandle.plugin, tHandle.ulSnapshotAddress, string.rep(string.char(0), tHandle.sizSnapshot))
+  end
+  tHandle.atSnapshots = {}
+end
+
+
+
+-- Decode the result of a "readdelta" command in the result data of a
+-- sequence. The result starts at position uiPos in strResult. The host
+-- keeps its own copy of each snapshot in the handle.
+-- Returns the current data of the device, a flag if it changed since the
+-- last read and the position after the result.
+function I2CNetx:decodeReadDelta(tHandle, uiSnapshot, sizData, strResult, uiPos)
+  local tLog = self.tLog
+  local strData
+  local fChanged = false
+
+  local strPrevious = tHandle.atSnapshots[uiSnapshot]
+  local ucType = string.byte(strResult, uiPos)
+  uiPos = uiPos + 1
+  if ucType==self.I2C_READ_DELTA_Full then
+    strData = string.sub(strResult, uiPos, uiPos+sizData-1)
+    uiPos = uiPos + sizData
+    fChanged = (strData~=strPrevious)
+  elseif strPrevious==nil then
+    -- This happens if the snapshots were not reset after the handle was
+    -- created.
+    tLog.error('The delta read for snapshot 0x%x has no previous data. Call resetSnapshots first.', uiSnapshot)
+  elseif ucType==self.I2C_READ_DELTA_Unchanged then
+    strData = strPrevious
+  elseif ucType==self.I2C_READ_DELTA_Changed then
+    local sizBitmap = math.ceil(sizData / 8)
+    local uiChanged = uiPos + sizBitmap
+    local astrData = {}
+    for uiCnt=0,sizData-1 do
+      local ucBitmap = string.byte(strResult, uiPos + math.floor(uiCnt/8))
+      if math.floor(ucBitmap / 2^(uiCnt%8)) % 2 == 1 then
+        table.insert(astrData, string.sub(strResult, uiChanged, uiChanged))
+        uiChanged = uiChanged + 1
+      else
+        table.insert(astrData, string.sub(strPrevious, uiCnt+1, uiCnt+1))
+      end
+    end
+    strData = table.concat(astrData)
+    uiPos = uiChanged
+    fChanged = true
+  else
+    tLog.error('Invalid type of the delta read result: %s', tostring(ucType))
+  end
+
+  if strData~=nil then
+    tHandle.atSnapshots[uiSnapshot] = strData
+  end
+
+  return strData, fChanged, uiPos
+end
+
+
+
+-- Read the limits and features of the firmware on the netX.
+-- The result is also stored in the handle. It has these fields:
+--   fifo_depth:         the number of entries in the master FIFO
+--   transfer_size_max:  the maximum number of bytes in one hardware transfer
+--   ackpoll_max:        the maximum ACK poll value of a command
+--   speed_mask:         bit n is set if speed n is supported
+--   parameter_start:    the start address of the parameter area
+--   parameter_size:     the size of the parameter area in bytes
+--   handle_size:        the size of an I2C handle in bytes
+--   buffer_start:       the start address of the transfer arena
+--   buffer_size:        the size of the transfer arena in bytes
+--   features:           a list with the names of all features
+--   feature_mask:       the raw feature bitmap
+-- Returns nil on error.
+function I2CNetx:getCapabilities(tHandle)
+  local tLog = self.tLog
+  local tester = _G.tester
+  local tCapabilities
+
+  local aAttr = tHandle.attr
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  else
+    local aParameter = {
+      0xffffffff,    -- verbose
+      self.I2C_CMD_GetCapabilities,
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.error('Failed to get the capabilities.')
+    else
+      local atFeatures = {}
+      local ulFeatures = aParameter[10]
+      for ulBit, strName in pairs(self.atFeatureNames) do
+        if math.floor(ulFeatures / ulBit) % 2 == 1 then
+          table.insert(atFeatures, strName)
+        end
+      end
+      table.sort(atFeatures)
+
+      tCapabilities = {
+        fifo_depth = aParameter[3],
+        transfer_size_max = aParameter[4],
+        ackpoll_max = aParameter[5],
+        speed_mask = aParameter[6],
+        parameter_start = aParameter[7],
+        parameter_size = aParameter[8],
+        handle_size = aParameter[9],
+        buffer_start = aParameter[11],
+        buffer_size = aParameter[12],
+        features = atFeatures,
+        feature_mask = ulFeatures
+      }
+      tHandle.capabilities = tCapabilities
+    end
+  end
+
+  return tCapabilities
+end
+
+
+
+-- Get the number of bytes for the TX, RX and packed data of one sequence.
+-- This is the space from the buffer of the handle to the end of the
+-- transfer arena or the start of the first capture ring. The handles of
+-- one netX share the buffer, so the rings of all handles are excluded.
+-- Use this to split large jobs into several sequences.
+function I2CNetx:getSequenceBufferSize(tHandle)
+  local ulBufferEnd = self:__get_capture_limit(tHandle, nil)
+
+  return ulBufferEnd - tHandle.ulBufferAddress
+end
+
+
+
+-- Get the end of the free buffer below all capture rings of the netX.
+-- The ring of the handle tSkipHandle is not considered.
+function I2CNetx:__get_capture_limit(tHandle, tSkipHandle)
+  local ulBufferEnd = tHandle.ulBufferEndAddress
+  local atRings = tHandle.attr.atCaptureRings
+  if atRings~=nil then
+    for ulHandleAddress, tRing in pairs(atRings) do
+      if tSkipHandle==nil or ulHandleAddress~=tSkipHandle.ulHandleAddress then
+        if tRing.address>=tHandle.ulBufferAddress and tRing.address<ulBufferEnd then
+          ulBufferEnd = tRing.address
+        end
+      end
+    end
+  end
+
+  return ulBufferEnd
+end
+
+
+
+-- Get the size of the slot area for a sequence. This is the value from the
+-- layout of parseI2cMacro. Without a layout the slot area ends after the
+-- last slot which is used in the sequence.
+function I2CNetx:__get_slot_area_size(strSequence, tLayout)
+  local sizSlotArea = 0
+
+  if tLayout~=nil then
+    sizSlotArea = tLayout.slot_area
+  else
+    -- parseI2cMacro limits the slot area to 65535 bytes.
+    local tAnalysis = self:analyzeSequence(strSequence, {
+      slot_area = 0xffff
+    })
+    if tAnalysis~=nil then
+      sizSlotArea = tAnalysis.slot_end
+    end
+  end
+
+  return sizSlotArea
+end
+
+
+
+-- Download a sequence and set the parameters to run it on the netX.
+-- Returns a job table for __run_sequence_finish or nil on error.
+function I2CNetx:__run_sequence_prepare(tHandle, strSequence, sizExpectedRxData, fPackResult, tResume, tLayout, ulVerbose)
+  local tLog = self.tLog
+  local tester = _G.tester
+  local tJob
+
+  local aAttr = tHandle.attr
+
+  local sizTxBuffer = string.len(strSequence)
+  local pucTxBuffer = tHandle.ulBufferAddress
+  local pucRxBuffer = tHandle.ulBufferAddress + sizTxBuffer
+
+  -- The packed data follows the RX buffer. It is only useful if it is
+  -- smaller than the raw data.
+  local pucPackedBuffer = 0
+  local sizPackedBuffer = 0
+  if fPackResult==true then
+    pucPackedBuffer = pucRxBuffer + sizExpectedRxData
+    sizPackedBuffer = sizExpectedRxData
+  end
+
+  local ulResumeOffset = 0
+  local ulResumeIndex = 0
+  if tResume~=nil then
+    ulResumeOffset = tResume.offset
+    ulResumeIndex = tResume.index
+  end
+
+  -- The offset table follows the packed data. It has one entry for each
+  -- command of the sequence.
+  local sizSlotArea = self:__get_slot_area_size(strSequence, tLayout)
+  local pucOffsetTable = 0
+  local ulOffsetEntriesMax = 0
+  local sizOffsetTable = 0
+  if tLayout~=nil then
+    pucOffsetTable = pucRxBuffer + sizExpectedRxData + sizPackedBuffer
+    pucOffsetTable = pucOffsetTable + ((4 - (pucOffsetTable % 4)) % 4)
+    ulOffsetEntriesMax = tLayout.commands
+    sizOffsetTable = (pucOffsetTable - pucRxBuffer - sizExpectedRxData - sizPackedBuffer) + ulOffsetEntriesMax * self.I2C_RESULT_OFFSET_SIZE
+  end
+
+  -- Reject a sequence which does not fit into the buffer before anything is
+  -- downloaded. The netX would overwrite the capture ring or the stack.
+  local sizBuffer = self:getSequenceBufferSize(tHandle)
+  local sizRequired = sizTxBuffer + sizExpectedRxData + sizPackedBuffer + sizOffsetTable
+
+  local tPlugin = tHandle.plugin
   if tPlugin==nil then
     tLog.error('The handle has no "plugin" set.')
+  elseif sizRequired>sizBuffer then
+    tLog.error('The sequence needs %d bytes for TX, RX, packed data and offsets, but the buffer has only %d bytes.', sizRequired, sizBuffer)
   else
     -- Download the sequence data.
     tester:stdWrite(tPlugin, pucTxBuffer, strSequence)
 
-    -- Run the command.
     local aParameter = {
-      0xffffffff,    -- verbose
+      ulVerbose,
       self.I2C_CMD_RunSequence,
       tHandle.ulHandleAddress,
       pucTxBuffer,
       sizTxBuffer,
       pucRxBuffer,
       sizExpectedRxData,
+      'OUTPUT',
+      pucPackedBuffer,
+      sizPackedBuffer,
+      'OUTPUT',
+      ulResumeOffset,
+      ulResumeIndex,
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      'OUTPUT',
+      tHandle.ulSnapshotAddress,
+      tHandle.sizSnapshot,
+      sizSlotArea,
+      pucOffsetTable,
+      ulOffsetEntriesMax,
       'OUTPUT'
     }
     tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
-    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
-    if ulValue~=0 then
-      tLog.error('Failed to run the sequence.')
-    else
-      -- Get the size of the result data from the output parameter.
-      local sizResultData = aParameter[7]
-      tLog.debug('The netX reports %d bytes of result data.', sizResultData)
 
+    tJob = {
+      plugin = tPlugin,
+      attr = aAttr,
+      parameter = aParameter,
+      rx_buffer = pucRxBuffer,
+      packed_buffer = pucPackedBuffer,
+      offset_table = pucOffsetTable,
+      resume_index = ulResumeIndex,
+      layout = tLayout
+    }
+  end
+
+  return tJob
+end
+
+
+
+-- Collect the result of a sequence. ulValue is the result of the netX.
+function I2CNetx:__run_sequence_finish(tJob, ulValue)
+  local tLog = self.tLog
+  local tester = _G.tester
+  local tResult
+  local tError
+  local atCommandResults
+
+  local tPlugin = tJob.plugin
+  local aParameter = tJob.parameter
+
+  -- The tester reads the output parameters only on success, but the error
+  -- record is also needed for a failed sequence.
+  if ulValue~=0 then
+    tester:mbin_get_parameter(tPlugin, tJob.attr, aParameter)
+  end
+
+  -- Get the size of the result data from the output parameter.
+  local sizResultData = aParameter[8]
+  local sizPackedData = aParameter[11]
+  if ulValue~=0 then
+    tError = {
+      class = self.atSeqErrorNames[aParameter[14]] or tostring(aParameter[14]),
+      offset = aParameter[15],
+      index = aParameter[16],
+      bytes = aParameter[17],
+      data = tester:stdRead(tPlugin, tJob.rx_buffer, sizResultData)
+    }
+    tLog.error('Failed to run the sequence: command %d at offset %d failed with %s after %d bytes.', tError.index, tError.offset, tError.class, tError.bytes)
+  else
+    tLog.debug('The netX reports %d bytes of result data.', sizResultData)
+
+    if sizPackedData~=0 then
+      -- Read and unpack the packed result data.
+      tLog.debug('The result data is packed to %d bytes.', sizPackedData)
+      local strPackedData = tester:stdRead(tPlugin, tJob.packed_buffer, sizPackedData)
+      tResult = self:__rle_decompress(strPackedData)
+    else
       -- Read the result data.
-      local strResultData = tester:stdRead(tPlugin, pucRxBuffer, sizResultData)
+      local strResultData = tester:stdRead(tPlugin, tJob.rx_buffer, sizResultData)
       tResult = strResultData
     end
+
+    -- Split the result data with the offset table.
+    local tLayout = tJob.layout
+    if tLayout~=nil then
+      local ulEntries = math.min(aParameter[23], tLayout.commands)
+      atCommandResults = {}
+      if ulEntries>0 then
+        local strOffsets = tester:stdRead(tPlugin, tJob.offset_table, ulEntries * self.I2C_RESULT_OFFSET_SIZE)
+        for uiEntry=1,ulEntries do
+          local uiPos = (uiEntry - 1) * self.I2C_RESULT_OFFSET_SIZE + 1
+          local ulOffset = self:__bytes_to_uint32(strOffsets, uiPos)
+          local ulSize = self:__bytes_to_uint32(strOffsets, uiPos + 4)
+          local strData = string.sub(tResult, ulOffset + 1, ulOffset + ulSize)
+          -- The first entry is the first executed command. This is not the
+          -- first command of the sequence if it was resumed.
+          local uiCommand = tJob.resume_index + uiEntry
+          atCommandResults[uiCommand] = strData
+          local strName = tLayout.names[uiCommand]
+          if strName~=nil then
+            atCommandResults[strName] = strData
+          end
+        end
+      end
+    end
   end
 
-  return tResult
+  return tResult, tError, atCommandResults
+end
+
+
+
+-- Run a sequence on the netX.
+-- On success the result data is returned. On failure the function returns
+-- nil and an error record with these fields:
+--   class:       the name of the error class, e.g. "NakAddress"
+--   offset:      the offset of the failed command in the sequence
+--   index:       the index of the failed command in the sequence
+--   bytes:       the number of bytes transferred by the failed command. For
+--                a write to several addresses this includes the data of all
+--                devices before the failed one.
+--   data:        the result data of all commands before the failed one
+-- Pass the error record as "tResume" to continue the sequence at the failed
+-- command. The result data then starts with this command.
+-- Pass the layout from parseI2cMacro as "tLayout" to get the data of each
+-- command as a third return value. It is a table with the data of each
+-- executed command by the index of the command in the sequence, and the data
+-- of each slot by its name.
+-- The slot area is at the start of the result data, followed by the data of
+-- the other reads. Without a layout its size is taken from the slots which
+-- are used in the sequence. This is the size from parseI2cMacro unless the
+-- sequence was changed after parsing.
+function I2CNetx:run_sequence(tHandle, strSequence, sizExpectedRxData, fPackResult, tResume, tLayout)
+  local tester = _G.tester
+  local tResult
+  local tError
+  local atCommandResults
+
+  local tJob = self:__run_sequence_prepare(tHandle, strSequence, sizExpectedRxData, fPackResult, tResume, tLayout, 0xffffffff)
+  if tJob~=nil then
+    ulValue = tester:mbin_execute(tJob.plugin, tJob.attr, tJob.parameter)
+    tResult, tError, atCommandResults = self:__run_sequence_finish(tJob, ulValue)
+  end
+
+  return tResult, tError, atCommandResults
 end
 
 
+
+-- Split a sequence into parts which fit into the buffer of the handle.
+-- The parts end only after a command which leaves the bus free. The ACK
+-- poll policy of the netX is reset for each part, so the last
+-- "ackpollpolicy" command before a part is repeated at its start.
+-- The analysis limits the ACK poll values to the maximum from
+-- getCapabilities. The FIFO depth and the maximum transfer size need no
+-- split, as the driver on the netX splits long transfers itself.
+-- Sequences with slots can not be split, as each part would need its own
+-- slot area. They are rejected with an error.
+-- Returns a list of parts or nil on error. Each part has these fields:
+--   sequence:   the commands of the part
+--   rx_size:    the expected size of the received data
+--   offset:     the offset of the first command in the original sequence
+--   index:      the index of the first command in the original sequence
+--   prefix:     the number of repeated commands at the start of the part
+--   prefix_size: the size of the repeated commands in bytes
+--   prefix_offset: the offset of the repeated command in the original
+--                sequence
+--   prefix_index: the index of the repeated command in the original sequence
+function I2CNetx:splitSequence(tHandle, strSequence, fPackResult)
+  local tLog = self.tLog
+  local atParts
+
+  local tCapabilities = tHandle.capabilities or self:getCapabilities(tHandle)
+  if tCapabilities~=nil then
+    -- Allow all slots in the analysis to find them.
+    local tAnalysis = self:analyzeSequence(strSequence, {
+      ackpoll_max = tCapabilities.ackpoll_max,
+      slot_area = 0xffff
+    })
+    if tAnalysis~=nil and tAnalysis.slot_end~=0 then
+      tLog.error('The sequence reads to slots. A sequence with slots can not be split.')
+    elseif tAnalysis~=nil then
+      -- The packed data needs as much space as the received data.
+      local uiRxFactor = 1
+      if fPackResult==true then
+        uiRxFactor = 2
+      end
+      local sizBuffer = self:getSequenceBufferSize(tHandle)
+
+      atParts = {}
+      local strPrefix = ''
+      local ulPrefixOffset = 0
+      local uiPrefixIndex = 0
+      local uiPartStart = 1
+      local uiLastSplit
+      local sizTx = 0
+      local sizRx = 0
+      local atCommands = tAnalysis.command_list
+
+      local function addPart(uiFirst, uiLast)
+        local tFirst = atCommands[uiFirst]
+        local tLast = atCommands[uiLast]
+        local sizPrefix = 0
+        if strPrefix~='' then
+          sizPrefix = 1
+        end
+        local sizPartRx = 0
+        for uiCnt=uiFirst,uiLast do
+          sizPartRx = sizPartRx + atCommands[uiCnt].rx_size
+        end
+        table.insert(atParts, {
+          sequence = strPrefix .. string.sub(strSequence, tFirst.offset + 1, tLast.offset + tLast.size),
+          rx_size = sizPartRx,
+          offset = tFirst.offset,
+          index = uiFirst - 1,
+          prefix = sizPrefix,
+          prefix_size = string.len(strPrefix),
+          prefix_offset = ulPrefixOffset,
+          prefix_index = uiPrefixIndex
+        })
+      end
+
+      local uiCnt = 1
+      while uiCnt<=#atCommands do
+        local tCommand = atCommands[uiCnt]
+        sizTx = sizTx + tCommand.size
+        sizRx = sizRx + tCommand.rx_size
+        if (string.len(strPrefix) + sizTx + uiRxFactor*sizRx)>sizBuffer then
+          if uiLastSplit==nil then
+            tLog.error('The commands from index %d to %d do not fit into the buffer of %d bytes.', uiPartStart-1, uiCnt-1, sizBuffer)
+            atParts = nil
+            break
+          end
+          addPart(uiPartStart, uiLastSplit)
+
+          -- Remember the last ACK poll policy for the next part.
+          for uiPolicy=uiPartStart,uiLastSplit do
+            local tPolicy = atCommands[uiPolicy]
+            if string.byte(strSequence, tPolicy.offset+1)==self.I2C_SEQ_COMMAND_AckPollPolicy then
+              strPrefix = string.sub(strSequence, tPolicy.offset + 1, tPolicy.offset + tPolicy.size)
+              ulPrefixOffset = tPolicy.offset
+              uiPrefixIndex = uiPolicy - 1
+            end
+          end
+
+          -- Continue with the first command after the split.
+          uiPartStart = uiLastSplit + 1
+          uiLastSplit = nil
+          uiCnt = uiPartStart
+          sizTx = 0
+          sizRx = 0
+        else
+          if tCommand.bus_free==true then
+            uiLastSplit = uiCnt
+          end
+          uiCnt = uiCnt + 1
+        end
+      end
+      if atParts~=nil and uiPartStart<=#atCommands then
+        addPart(uiPartStart, #atCommands)
+      end
+    end
+  end
+
+  return atParts
+end
+
+
+
+-- Run a sequence which might not fit into the buffer of the handle. It is
+-- split with splitSequence and the parts run one after the other.
+-- The result data of all parts is returned in one string. On failure the
+-- function returns nil and an error record like run_sequence. The offset
+-- and the index refer to the original sequence and the data has the
+-- results of all commands before the failed one. An error in the repeated
+-- "ackpollpolicy" command at the start of a part is reported for the
+-- original command.
+function I2CNetx:run_sequence_split(tHandle, strSequence, fPackResult)
+  local tResult
+  local tError
+
+  local atParts = self:splitSequence(tHandle, strSequence, fPackResult)
+  if atParts~=nil then
+    local astrResults = {}
+    for _, tPart in ipairs(atParts) do
+      local strResult, tPartError = self:run_sequence(tHandle, tPart.sequence, tPart.rx_size, fPackResult)
+      if strResult==nil then
+        tError = {
+          class = 'InvalidParameter',
+          offset = tPart.offset,
+          index = tPart.index,
+          bytes = 0,
+          data = table.concat(astrResults)
+        }
+        if tPartError~=nil then
+          tError.class = tPartError.class
+          if tPartError.index<tPart.prefix then
+            tError.index = tPart.prefix_index
+            tError.offset = tPart.prefix_offset
+          else
+            tError.index = tPart.index + tPartError.index - tPart.prefix
+            tError.offset = tPart.offset + tPartError.offset - tPart.prefix_size
+          end
+          tError.bytes = tPartError.bytes
+          tError.data = tError.data .. tPartError.data
+        end
+        break
+      end
+      table.insert(astrResults, strResult)
+    end
+    if tError==nil then
+      tResult = table.concat(astrResults)
+    end
+  end
+
+  return tResult, tError
+end
+
+
+
+-- Start a sequence on the netX without waiting for the result.
+-- This returns a coroutine which yields until the netX has finished. Then it
+-- returns the same values as run_sequence. Use wait_all to run the
+-- coroutines of several netX in parallel.
+-- The netX is started with the "call_no_answer" function of the plugin and
+-- the result word of the parameter block is polled. The sequence runs with
+-- the verbose output off, as nobody reads the messages of the netX.
+-- A plugin without "call_no_answer" runs the sequence blocking when the
+-- coroutine is resumed for the first time.
+-- If the netX does not answer within ulTimeoutMs, the coroutine returns nil
+-- and an error record with the class "HostTimeout". The netX is still busy
+-- then and must be reset. The default for ulTimeoutMs comes from
+-- __get_sequence_timeout_ms.
+function I2CNetx:run_sequence_async(tHandle, strSequence, sizExpectedRxData, fPackResult, tResume, tLayout, ulTimeoutMs)
+  local tLog = self.tLog
+  local tester = _G.tester
+
+  return coroutine.create(function()
+    local tResult
+    local tError
+    local atCommandResults
+
+    local tJob = self:__run_sequence_prepare(tHandle, strSequence, sizExpectedRxData, fPackResult, tResume, tLayout, 0)
+    if tJob~=nil then
+      local tPlugin = tJob.plugin
+      local aAttr = tJob.attr
+      local ulValue
+
+      -- Only a plugin without the function runs the sequence blocking.
+      -- All other errors of the plugin are passed on.
+      local fHasCall, fnCallNoAnswer = pcall(function() return tPlugin.call_no_answer end)
+      if fHasCall~=true or fnCallNoAnswer==nil then
+        tLog.debug('The plugin can not start the netX without waiting. Running the sequence blocking.')
+        ulValue = tester:mbin_execute(tPlugin, aAttr, tJob.parameter)
+      else
+        -- Start the netX. The callback continues the call for all messages.
+        tPlugin:call_no_answer(aAttr.ulExecAddress, aAttr.ulParameterStartAddress, function() return true end, 0)
+
+        -- Poll the result word. It is 0xffffffff until the netX returns.
+        -- A plugin might fail to read while the netX is busy.
+        ulTimeoutMs = ulTimeoutMs or self:__get_sequence_timeout_ms(tHandle, strSequence, tLayout)
+        local ulDeadlineMs = self:__get_time_ms() + self:__round_timeout_ms(ulTimeoutMs)
+        local fTimeout = false
+        repeat
+          coroutine.yield()
+          local fOk, ulResult = pcall(tPlugin.read_data32, tPlugin, aAttr.ulParameterStartAddress)
+          if fOk==true and ulResult~=0xffffffff then
+            ulValue = ulResult
+          elseif self:__get_time_ms()>ulDeadlineMs then
+            fTimeout = true
+          end
+        until ulValue~=nil or fTimeout==true
+
+        if fTimeout==true then
+          tError = {
+            class = 'HostTimeout',
+            offset = 0,
+            index = 0,
+            bytes = 0,
+            data = ''
+          }
+          tLog.error('The netX did not finish the sequence within %d ms. Reset the netX before the next command.', ulTimeoutMs)
+        elseif ulValue==0 then
+          tester:mbin_get_parameter(tPlugin, aAttr, tJob.parameter)
+        end
+      end
+
+      if tError==nil then
+        tResult, tError, atCommandResults = self:__run_sequence_finish(tJob, ulValue)
+      end
+    end
+
+    return tResult, tError, atCommandResults
+  end)
+end
+
+
+
+-- Get the time in milliseconds for the deadline of run_sequence_async.
+-- LuaSocket provides a clock with milliseconds. The fallback is os.time,
+-- which only counts seconds, see __round_timeout_ms.
+function I2CNetx:__get_time_ms()
+  local tSocket = self.socket
+  if tSocket~=nil then
+    return math.floor(tSocket.gettime() * 1000)
+  end
+
+  return os.time() * 1000
+end
+
+
+
+-- Adapt a timeout to the resolution of __get_time_ms. Without LuaSocket
+-- the timeout is rounded up to whole seconds, so a deadline never passes
+-- too early. It can pass up to one second late then.
+function I2CNetx:__round_timeout_ms(ulTimeoutMs)
+  if self.socket==nil then
+    ulTimeoutMs = math.ceil(ulTimeoutMs / 1000) * 1000
+  end
+
+  return ulTimeoutMs
+end
+
+
+
+-- Sleep for ulMs milliseconds. LuaSocket sleeps without load. The fallback
+-- waits for the CPU time with os.clock. It keeps the CPU busy, but still
+-- limits the rate of the polls.
+function I2CNetx:__sleep_ms(ulMs)
+  local tSocket = self.socket
+  if tSocket~=nil then
+    tSocket.sleep(ulMs / 1000)
+  else
+    local tEnd = os.clock() + ulMs / 1000
+    repeat
+    until os.clock()>=tEnd
+  end
+end
+
+
+
+-- Get the time which the netX needs at most for a sequence. This is the
+-- estimate of analyzeSequence at the lowest bus speed with the maximum ACK
+-- polling and all delays, plus the clock stretch allowance of the handle
+-- for each command like the timeouts on the netX, plus
+-- I2C_ASYNC_TIMEOUT_MARGIN_MS for the start and the polling.
+function I2CNetx:__get_sequence_timeout_ms(tHandle, strSequence, tLayout)
+  local ulTimeoutMs = self.I2C_ASYNC_TIMEOUT_MARGIN_MS
+
+  local tAnalysis = self:analyzeSequence(strSequence, {
+    speed = 50,
+    slot_area = self:__get_slot_area_size(strSequence, tLayout)
+  })
+  if tAnalysis~=nil then
+    local usClockStretchMs = tHandle.usClockStretchMs or 25
+    ulTimeoutMs = ulTimeoutMs + math.ceil(tAnalysis.time_max_us / 1000) + tAnalysis.commands * usClockStretchMs
+  end
+
+  return ulTimeoutMs
+end
+
+
+
+-- Resume all coroutines from run_sequence_async until they are finished.
+-- Returns a list with the results in the same order as atCoroutines. Each
+-- entry has the fields "result", "error" and "commands" with the return
+-- values of run_sequence.
+-- The function sleeps I2C_ASYNC_POLL_INTERVAL_MS between 2 rounds.
+function I2CNetx:wait_all(atCoroutines)
+  local atResults = {}
+  local sizPending = #atCoroutines
+  local fFirstRound = true
+
+  while sizPending~=0 do
+    if fFirstRound~=true then
+      self:__sleep_ms(self.I2C_ASYNC_POLL_INTERVAL_MS)
+    end
+    fFirstRound = false
+    sizPending = 0
+    for uiIndex, tCoroutine in ipairs(atCoroutines) do
+      if coroutine.status(tCoroutine)=='suspended' then
+        local fOk, tResult, tError, atCommandResults = coroutine.resume(tCoroutine)
+        if fOk~=true then
+          error(tResult)
+        end
+        if coroutine.status(tCoroutine)=='dead' then
+          atResults[uiIndex] = {
+            result = tResult,
+            error = tError,
+            commands = atCommandResults
+          }
+        else
+          sizPending = sizPending + 1
+        end
+      end
+    end
+  end
+
+  return atResults
+end
+
+
+
+-- Precompiled sequence files keep the result of parseI2cMacro, so a test
+-- does not have to parse the same macro in every run. A file has this
+-- layout, all values are little endian:
+--   4 bytes  magic "I2CS"
+--   2 bytes  format version
+--   1 byte   number of IDs, followed by the IDs of the sequence format
+--   4 bytes  expected size of the received data
+--   4 bytes  number of commands in the sequence
+--   4 bytes  size of the slot area
+--   2 bytes  number of slot names, followed by the slot names. Each slot
+--            name has the index of its command (4 bytes), the length of the
+--            name (1 byte) and the name.
+--   4 bytes  size of the sequence, followed by the sequence
+--   4 bytes  Adler-32 checksum of all previous bytes
+-- The IDs come from the netX binary. These are the commands, the conditions,
+-- the read destinations, the SMBus protocols and the flags. A file is only
+-- loaded if its IDs match the IDs of this module.
+function I2CNetx:__sequence_file_ids()
+  local atSmbusProtocols = self.atSmbusProtocols
+  local atRmwOptions = self.atRmwOptions
+
+  return string.char(
+    self.I2C_SEQ_COMMAND_Read,
+    self.I2C_SEQ_COMMAND_Write,
+    self.I2C_SEQ_COMMAND_Delay,
+    self.I2C_SEQ_COMMAND_WriteRle,
+    self.I2C_SEQ_COMMAND_AckPollPolicy,
+    self.I2C_SEQ_COMMAND_WriteMulti,
+    self.I2C_SEQ_COMMAND_Smbus,
+    self.I2C_SEQ_COMMAND_Rmw,
+    self.I2C_SEQ_COMMAND_ReadExt,
+    self.I2C_SEQ_COMMAND_WriteExt,
+    self.I2C_SEQ_COMMAND_ReadDelta,
+    self.I2C_SEQ_COMMAND_ReadTo,
+    self.I2C_SEQ_COMMAND_MuxSelect,
+    self.I2C_SEQ_CONDITION_None,
+    self.I2C_SEQ_CONDITION_Start,
+    self.I2C_SEQ_CONDITION_Stop,
+    self.I2C_SEQ_CONDITION_Continue,
+    self.I2C_READ_DESTINATION_Append,
+    self.I2C_READ_DESTINATION_Discard,
+    self.I2C_READ_DESTINATION_Slot,
+    atSmbusProtocols.read_byte.id,
+    atSmbusProtocols.write_byte.id,
+    atSmbusProtocols.read_word.id,
+    atSmbusProtocols.write_word.id,
+    atSmbusProtocols.block_read.id,
+    atSmbusProtocols.block_write.id,
+    atSmbusProtocols.process_call.id,
+    self.I2C_SMBUS_FLAGS_Pec,
+    atRmwOptions.reg16,
+    atRmwOptions.data16,
+    atRmwOptions.lsb,
+    atRmwOptions.verify,
+    self.I2C_MUX_SELECT_FLAGS_Force
+  )
+end
+
+
+
+-- Convert the result of parseI2cMacro to the contents of a precompiled
+-- sequence file. The layout is optional.
+function I2CNetx:compileSequence(strSequence, sizExpectedRxData, tLayout)
+  local tLog = self.tLog
+
+  local uiCommands = 0
+  local sizSlotArea = 0
+  local atNames = {}
+  if tLayout~=nil then
+    uiCommands = tLayout.commands
+    sizSlotArea = tLayout.slot_area
+    atNames = tLayout.names
+  end
+
+  -- Sort the slot names by the command index to get the same file for the
+  -- same macro.
+  local auiIndices = {}
+  for uiIndex in pairs(atNames) do
+    table.insert(auiIndices, uiIndex)
+  end
+  table.sort(auiIndices)
+  if #auiIndices>0xffff then
+    tLog.error('Too many slot names: %d', #auiIndices)
+    error('Too many slot names.')
+  end
+
+  local strIds = self:__sequence_file_ids()
+  local astrFile = {
+    self.I2C_SEQUENCE_FILE_MAGIC,
+    string.char(self:__uint16_to_bytes(self.I2C_SEQUENCE_FILE_VERSION)),
+    string.char(string.len(strIds)),
+    strIds,
+    string.char(self:__uint32_to_bytes(sizExpectedRxData)),
+    string.char(self:__uint32_to_bytes(uiCommands)),
+    string.char(self:__uint32_to_bytes(sizSlotArea)),
+    string.char(self:__uint16_to_bytes(#auiIndices))
+  }
+  for _, uiIndex in ipairs(auiIndices) do
+    local strName = atNames[uiIndex]
+    if string.len(strName)>0xff then
+      tLog.error('The slot name "%s" is too long.', strName)
+      error('Slot name too long.')
+    end
+    table.insert(astrFile, string.char(self:__uint32_to_bytes(uiIndex)))
+    table.insert(astrFile, string.char(string.len(strName)))
+    table.insert(astrFile, strName)
+  end
+  table.insert(astrFile, string.char(self:__uint32_to_bytes(string.len(strSequence))))
+  table.insert(astrFile, strSequence)
+
+  local strFile = table.concat(astrFile)
+
+  return strFile .. string.char(self:__uint32_to_bytes(self:__adler32(strFile)))
+end
+
+
+
+-- Convert the contents of a precompiled sequence file back to the values of
+-- parseI2cMacro. Returns nil and an error message if the file is invalid.
+function I2CNetx:decompileSequence(strFile)
+  local strSequence
+  local sizExpectedRxData
+  local tLayout
+  local strError
+
+  local sizFile = string.len(strFile)
+  local uiPos = 1
+
+  -- Get the next sizData bytes or nil if the file is too short.
+  local function get(sizData)
+    local strData
+    if uiPos+sizData-1<=sizFile then
+      strData = string.sub(strFile, uiPos, uiPos+sizData-1)
+      uiPos = uiPos + sizData
+    end
+    return strData
+  end
+  local function get_uint16()
+    local strData = get(2)
+    if strData~=nil then
+      local ucB0, ucB1 = string.byte(strData, 1, 2)
+      return ucB0 + 0x0100*ucB1
+    end
+  end
+  local function get_uint32()
+    local strData = get(4)
+    if strData~=nil then
+      return self:__bytes_to_uint32(strData, 1)
+    end
+  end
+
+  local strIds = self:__sequence_file_ids()
+  if sizFile<8 then
+    strError = 'The file is too short.'
+  elseif get(4)~=self.I2C_SEQUENCE_FILE_MAGIC then
+    strError = 'The file has no sequence header.'
+  elseif get_uint16()~=self.I2C_SEQUENCE_FILE_VERSION then
+    strError = 'The format version of the file is not supported.'
+  else
+    local ulChecksum = self:__bytes_to_uint32(strFile, sizFile-3)
+    if self:__adler32(string.sub(strFile, 1, sizFile-4))~=ulChecksum then
+      strError = 'The checksum of the file does not match.'
+    else
+      -- Do not read the checksum as data.
+      sizFile = sizFile - 4
+
+      local sizIds = string.byte(get(1) or '\255')
+      if get(sizIds)~=strIds then
+        strError = 'The IDs of the file do not match the netX binary. Compile the file again.'
+      else
+        sizExpectedRxData = get_uint32()
+        local uiCommands = get_uint32()
+        local sizSlotArea = get_uint32()
+        local sizNames = get_uint16()
+        local atNames = {}
+        if sizNames~=nil then
+          for uiCnt=1,sizNames do
+            local uiIndex = get_uint32()
+            local strLength = get(1)
+            if uiIndex==nil or strLength==nil then
+              break
+            end
+            atNames[uiIndex] = get(string.byte(strLength))
+          end
+        end
+        local sizSequence = get_uint32()
+        if sizSequence~=nil then
+          strSequence = get(sizSequence)
+        end
+        if strSequence==nil or uiPos~=sizFile+1 then
+          strSequence = nil
+          sizExpectedRxData = nil
+          strError = 'The file is truncated or has extra data.'
+        elseif uiCommands~=0 then
+          tLayout = {
+            commands = uiCommands,
+            slot_area = sizSlotArea,
+            names = atNames
+          }
+        end
+      end
+    end
+  end
+
+  if strSequence==nil then
+    return nil, strError
+  end
+
+  return strSequence, sizExpectedRxData, tLayout
+end
+
+
+
+-- Write the result of parseI2cMacro to a precompiled sequence file.
+function I2CNetx:saveSequence(strFileName, strSequence, sizExpectedRxData, tLayout)
+  local tLog = self.tLog
+  local fResult = false
+
+  local strFile = self:compileSequence(strSequence, sizExpectedRxData, tLayout)
+  local tFile, strError = io.open(strFileName, 'wb')
+  if tFile==nil then
+    tLog.error('Failed to create the file "%s": %s', strFileName, tostring(strError))
+  else
+    tFile:write(strFile)
+    tFile:close()
+    fResult = true
+  end
+
+  return fResult
+end
+
+
+
+-- Read a precompiled sequence file. Returns the same values as
+-- parseI2cMacro or nil if the file could not be read.
+function I2CNetx:loadSequence(strFileName)
+  local tLog = self.tLog
+  local strSequence
+  local sizExpectedRxData
+  local tLayout
+
+  local tFile, strError = io.open(strFileName, 'rb')
+  if tFile==nil then
+    tLog.error('Failed to open the file "%s": %s', strFileName, tostring(strError))
+  else
+    local strFile = tFile:read('*a')
+    tFile:close()
+
+    strSequence, sizExpectedRxData, tLayout = self:decompileSequence(strFile)
+    if strSequence==nil then
+      tLog.error('Failed to load the sequence "%s": %s', strFileName, sizExpectedRxData)
+      sizExpectedRxData = nil
+    end
+  end
+
+  return strSequence, sizExpectedRxData, tLayout
+end
+
+
+
+-- Run a precompiled sequence file. This returns the same values as
+-- run_sequence or nil if the file could not be read.
+function I2CNetx:run_sequence_file(tHandle, strFileName, fPackResult, tResume)
+  local tResult
+  local tError
+  local atCommandResults
+
+  local strSequence, sizExpectedRxData, tLayout = self:loadSequence(strFileName)
+  if strSequence~=nil then
+    tResult, tError, atCommandResults = self:run_sequence(tHandle, strSequence, sizExpectedRxData, fPackResult, tResume, tLayout)
+  end
+
+  return tResult, tError, atCommandResults
+end
+
+
+
+-- Probe all addresses from ucFirstAddress to ucLastAddress on the netX.
+-- Returns a list of all addresses which acknowledged and the raw 16 byte
+-- presence bitmap.
+function I2CNetx:scan(tHandle, ucAckPoll, ucFirstAddress, ucLastAddress)
+  ucAckPoll = ucAckPoll or 0
+  ucFirstAddress = ucFirstAddress or 0x08
+  ucLastAddress = ucLastAddress or 0x77
+  local tLog = self.tLog
+  local tester = _G.tester
+  local atResult
+  local strBitmap
+
+  local aAttr = tHandle.attr
+  local pucBitmap = tHandle.ulBufferAddress
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  else
+    local aParameter = {
+      0xffffffff,    -- verbose
+      self.I2C_CMD_Scan,
+      tHandle.ulHandleAddress,
+      ucAckPoll,
+      ucFirstAddress,
+      ucLastAddress,
+      pucBitmap,
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.error('Failed to scan the bus.')
+    else
+      tLog.debug('Found %d devices.', aParameter[8])
+      strBitmap = tester:stdRead(tPlugin, pucBitmap, 16)
+
+      -- Convert the bitmap to a list of addresses.
+      atResult = {}
+      for uiAddress=ucFirstAddress,ucLastAddress do
+        local ucData = string.byte(strBitmap, math.floor(uiAddress/8) + 1)
+        local ucBit = math.floor(ucData / 2^(uiAddress%8)) % 2
+        if ucBit==1 then
+          table.insert(atResult, uiAddress)
+        end
+      end
+    end
+  end
+
+  return atResult, strBitmap
+end
+
+
+
+-- Measure the throughput between 2 cores which are wired back to back.
+-- tHandle is the master and tSlaveHandle the slave. Both must be opened on
+-- the same netX with different handle slots.
+-- ulSpeedMask selects the bus speeds with one bit for each I2CSPEED value.
+-- The result is a list with one entry for each selected speed. All times
+-- are in microseconds. The master is set to 100kbit/s at the end.
+-- Each entry also has the average time per byte in nanoseconds and the
+-- jitter, which is the difference between the slowest and the fastest
+-- transfer.
+function I2CNetx:benchmark(tHandle, tSlaveHandle, ucSlaveAddress, ulSpeedMask, sizTransfer, ulTransfers)
+  ucSlaveAddress = ucSlaveAddress or 0x50
+  ulSpeedMask = ulSpeedMask or 0xff
+  sizTransfer = sizTransfer or 64
+  ulTransfers = ulTransfers or 16
+  local tLog = self.tLog
+  local tester = _G.tester
+  local atResults
+
+  local aAttr = tHandle.attr
+
+  -- Place the results and the work buffer in the RX/TX buffer.
+  local pucResults = tHandle.ulBufferAddress
+  local pucWorkBuffer = pucResults + 8*self.I2C_BENCHMARK_RESULT_SIZE
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  else
+    local aParameter = {
+      0xffffffff,    -- verbose
+      self.I2C_CMD_Benchmark,
+      tHandle.ulHandleAddress,
+      tSlaveHandle.ulHandleAddress,
+      ucSlaveAddress,
+      ulSpeedMask,
+      sizTransfer,
+      ulTransfers,
+      pucWorkBuffer,
+      pucResults,
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.error('Failed to run the benchmark.')
+    else
+      local ulResults = aParameter[11]
+      local strResults = tester:stdRead(tPlugin, pucResults, ulResults*self.I2C_BENCHMARK_RESULT_SIZE)
+      atResults = {}
+      for uiResult=0,ulResults-1 do
+        local uiOffset = uiResult*self.I2C_BENCHMARK_RESULT_SIZE + 1
+        local tResult = {
+          speed = self:__bytes_to_uint32(strResults, uiOffset),
+          bytes = self:__bytes_to_uint32(strResults, uiOffset+4),
+          write_total_us = self:__bytes_to_uint32(strResults, uiOffset+8),
+          write_min_us = self:__bytes_to_uint32(strResults, uiOffset+12),
+          write_max_us = self:__bytes_to_uint32(strResults, uiOffset+16),
+          read_total_us = self:__bytes_to_uint32(strResults, uiOffset+20),
+          read_min_us = self:__bytes_to_uint32(strResults, uiOffset+24),
+          read_max_us = self:__bytes_to_uint32(strResults, uiOffset+28),
+          errors = self:__bytes_to_uint32(strResults, uiOffset+32)
+        }
+        if tResult.bytes~=0 then
+          tResult.write_per_byte_ns = math.floor(1000*tResult.write_total_us / tResult.bytes)
+          tResult.read_per_byte_ns = math.floor(1000*tResult.read_total_us / tResult.bytes)
+          tResult.write_jitter_us = tResult.write_max_us - tResult.write_min_us
+          tResult.read_jitter_us = tResult.read_max_us - tResult.read_min_us
+        end
+        tLog.info('Speed %d: %d bytes, write %d us (%d-%d us per transfer), read %d us (%d-%d us per transfer), %d errors.',
+          tResult.speed, tResult.bytes,
+          tResult.write_total_us, tResult.write_min_us, tResult.write_max_us,
+          tResult.read_total_us, tResult.read_min_us, tResult.read_max_us,
+          tResult.errors
+        )
+        table.insert(atResults, tResult)
+      end
+    end
+  end
+
+  return atResults
+end
+
+
+
+-- Compare 2 benchmark results, e.g. from the binary without the TCMs as
+-- atReference and the default binary as atResults. Both must have been run
+-- with the same parameters.
+-- Logs the time per byte and the jitter for all speeds in both results.
+function I2CNetx:compareBenchmarks(atReference, atResults)
+  local tLog = self.tLog
+
+  local atReferenceBySpeed = {}
+  for _, tReference in ipairs(atReference) do
+    atReferenceBySpeed[tReference.speed] = tReference
+  end
+
+  for _, tResult in ipairs(atResults) do
+    local tReference = atReferenceBySpeed[tResult.speed]
+    if tReference==nil or tReference.bytes==0 or tResult.bytes==0 then
+      tLog.info('Speed %d: no reference.', tResult.speed)
+    else
+      tLog.info('Speed %d: write %d -> %d ns per byte, jitter %d -> %d us; read %d -> %d ns per byte, jitter %d -> %d us.',
+        tResult.speed,
+        tReference.write_per_byte_ns, tResult.write_per_byte_ns,
+        tReference.write_jitter_us, tResult.write_jitter_us,
+        tReference.read_per_byte_ns, tResult.read_per_byte_ns,
+        tReference.read_jitter_us, tResult.read_jitter_us
+      )
+    end
+  end
+end
+
+
+
+-- Run a sequence every ulPeriodMs milliseconds on the netX and collect the
+-- received data in a ring buffer. Each run can receive up to sizSample
+-- bytes. The sequence and the ring are placed in the RX/TX buffer. The ring
+-- gets all space after the sequence unless sizRing is set.
+-- The sampler runs until samplerStop is called. Use samplerRead to drain
+-- the ring while it is running.
+-- A plugin without "call_no_answer" can not drain the ring while the netX
+-- is busy. The sampler is blocking then and needs ulSamplesMax.
+-- Returns a sampler object or nil on error.
+function I2CNetx:samplerStart(tHandle, strSequence, sizSample, ulPeriodMs, sizRing, ulSamplesMax)
+  ulSamplesMax = ulSamplesMax or 0
+  local tLog = self.tLog
+  local tester = _G.tester
+  local tSampler
+
+  local aAttr = tHandle.attr
+
+  -- The ring must be 32 bit aligned.
+  local sizSequence = string.len(strSequence)
+  local pucSequence = tHandle.ulBufferAddress
+  local pucRing = pucSequence + 4*math.ceil(sizSequence/4)
+  local sizAvailable = self:getSequenceBufferSize(tHandle) - (pucRing - pucSequence)
+  sizRing = sizRing or sizAvailable
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  elseif sizRing>sizAvailable then
+    tLog.error('The sampler ring needs %d bytes, but only %d bytes are left after the sequence.', sizRing, sizAvailable)
+  else
+    tester:stdWrite(tPlugin, pucSequence, strSequence)
+
+    local aParameter = {
+      0,             -- verbose
+      self.I2C_CMD_Sample,
+      tHandle.ulHandleAddress,
+      pucSequence,
+      sizSequence,
+      sizSample,
+      ulPeriodMs,
+      ulSamplesMax,
+      pucRing,
+      sizRing,
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+
+    -- samplerStop waits for the run of the sequence which is active when
+    -- the stop request arrives.
+    tSampler = {
+      plugin = tPlugin,
+      attr = aAttr,
+      parameter = aParameter,
+      ring = pucRing,
+      timeout_ms = self:__get_sequence_timeout_ms(tHandle, strSequence, sizSample),
+      running = true
+    }
+
+    local fStarted = pcall(function()
+      tPlugin:call_no_answer(aAttr.ulExecAddress, aAttr.ulParameterStartAddress, function() return true end, 0)
+    end)
+    if fStarted~=true then
+      if ulSamplesMax==0 then
+        tLog.error('The plugin can not start the netX without waiting. The sampler needs a maximum number of samples.')
+        tSampler = nil
+      else
+        tLog.debug('The plugin can not start the netX without waiting. Running the sampler blocking.')
+        ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+        if ulValue~=0 then
+          tLog.error('Failed to run the sampler.')
+          tSampler = nil
+        else
+          tSampler.running = false
+        end
+      end
+    end
+  end
+
+  return tSampler
+end
+
+
+
+-- Read the header of a ring on the netX. The ring fields are at the start of
+-- the header, see i2c_ring.h. sizHeader is the size of the complete header.
+-- Returns the header as a string and a table with the ring fields.
+function I2CNetx:__ring_read_header(tPlugin, ulRingAddress, sizHeader)
+  local strHeader = _G.tester:stdRead(tPlugin, ulRingAddress, sizHeader)
+  local tRing = {
+    max_records = self:__bytes_to_uint32(strHeader, 1),
+    record_size = self:__bytes_to_uint32(strHeader, 5),
+    write_index = self:__bytes_to_uint32(strHeader, 9),
+    read_index = self:__bytes_to_uint32(strHeader, 13)
+  }
+
+  return strHeader, tRing
+end
+
+
+
+-- Read sizRecords records of a ring starting at the index ulFirst. This is
+-- one transfer, or 2 if the records wrap around.
+-- Returns the records as one string.
+function I2CNetx:__ring_read_records(tPlugin, ulRingAddress, sizHeader, tRing, ulFirst, sizRecords)
+  local tester = _G.tester
+  local pucRecords = ulRingAddress + sizHeader
+  local sizRecord = tRing.record_size
+  local strRecords = ''
+
+  if sizRecords>0 then
+    local sizFirst = math.min(sizRecords, tRing.max_records - ulFirst)
+    strRecords = tester:stdRead(tPlugin, pucRecords + ulFirst*sizRecord, sizFirst*sizRecord)
+    if sizRecords>sizFirst then
+      strRecords = strRecords .. tester:stdRead(tPlugin, pucRecords, (sizRecords-sizFirst)*sizRecord)
+    end
+  end
+
+  return strRecords
+end
+
+
+
+-- Read all new samples from the ring and pass the space back to the netX.
+-- Returns a list of samples with the fields "time_ms", "error" and "data",
+-- and a table with the counters "samples", "overflows" and "errors" of the
+-- netX. An overflow is a sample which was dropped because the ring was
+-- full.
+-- The plugin might fail to read while the netX is busy. Then nothing is
+-- passed back to the netX and the function returns nil. Try again later.
+function I2CNetx:samplerRead(tSampler)
+  local tLog = self.tLog
+  local tPlugin = tSampler.plugin
+  local pucRing = tSampler.ring
+  local sizHeader = self.I2C_SAMPLER_HEADER_SIZE
+  local atSamples
+  local tCounters
+
+  local fOk, strError = pcall(function()
+    local strHeader, tRing = self:__ring_read_header(tPlugin, pucRing, sizHeader)
+    local tNewCounters = {
+      samples = self:__bytes_to_uint32(strHeader, 21),
+      overflows = self:__bytes_to_uint32(strHeader, 25),
+      errors = self:__bytes_to_uint32(strHeader, 29)
+    }
+
+    local sizRecords = (tRing.write_index - tRing.read_index) % tRing.max_records
+    local strRecords = self:__ring_read_records(tPlugin, pucRing, sizHeader, tRing, tRing.read_index, sizRecords)
+
+    -- Pass the records back to the netX.
+    if sizRecords~=0 then
+      tPlugin:write_data32(pucRing + 12, tRing.write_index)
+    end
+
+    local atNewSamples = {}
+    local sizRecord = tRing.record_size
+    for uiOffset=1,string.len(strRecords),sizRecord do
+      local ulTimestampMs = self:__bytes_to_uint32(strRecords, uiOffset)
+      local ucErr0, ucErr1, ucSize0, ucSize1 = string.byte(strRecords, uiOffset+4, uiOffset+7)
+      local uiError = ucErr0 + 0x100*ucErr1
+      local sizData = ucSize0 + 0x100*ucSize1
+      local uiData = uiOffset + self.I2C_SAMPLER_RECORD_SIZE
+      table.insert(atNewSamples, {
+        time_ms = ulTimestampMs,
+        error = self.atSeqErrorNames[uiError] or tostring(uiError),
+        data = string.sub(strRecords, uiData, uiData+sizData-1)
+      })
+    end
+
+    atSamples = atNewSamples
+    tCounters = tNewCounters
+  end)
+  if fOk~=true then
+    tLog.debug('Failed to read the sampler ring: %s', tostring(strError))
+  end
+
+  return atSamples, tCounters
+end
+
+
+
+-- Stop the sampler and read the remaining samples.
+-- Returns the same values as samplerRead. If the netX does not stop until
+-- the deadline, the function returns nil and the netX must be reset.
+function I2CNetx:samplerStop(tSampler)
+  local tLog = self.tLog
+  local tPlugin = tSampler.plugin
+  local fStopped = true
+
+  if tSampler.running==true then
+    -- Request the stop and wait until the netX returns. The result word is
+    -- 0xffffffff until then. The plugin might fail to access the netX while
+    -- it is busy.
+    local ulTimeoutMs = tSampler.timeout_ms
+    local ulDeadlineMs = self:__get_time_ms() + ulTimeoutMs
+    local fRequested = false
+    local ulResult
+    repeat
+      if fRequested~=true then
+        fRequested = pcall(tPlugin.write_data32, tPlugin, tSampler.ring + 16, 1)
+      end
+      if fRequested==true then
+        local fOk, ulData = pcall(tPlugin.read_data32, tPlugin, tSampler.attr.ulParameterStartAddress)
+        if fOk==true and ulData~=0xffffffff then
+          ulResult = ulData
+        end
+      end
+      if ulResult==nil then
+        if self:__get_time_ms()>ulDeadlineMs then
+          break
+        end
+        self:__sleep_ms(self.I2C_ASYNC_POLL_INTERVAL_MS)
+      end
+    until ulResult~=nil
+    tSampler.running = false
+    if ulResult==nil then
+      tLog.error('The netX did not stop the sampler within %d ms. Reset the netX before the next command.', ulTimeoutMs)
+      fStopped = false
+    elseif ulResult~=0 then
+      tLog.error('The sampler failed.')
+    end
+  end
+
+  local atSamples
+  local tCounters
+  if fStopped==true then
+    atSamples, tCounters = self:samplerRead(tSampler)
+    if tCounters==nil then
+      tLog.error('Failed to read the sampler ring.')
+    elseif tCounters.overflows~=0 then
+      tLog.warning('The sampler ring overflowed. %d samples were dropped.', tCounters.overflows)
+    end
+  end
+
+  return atSamples, tCounters
+end
+
+
+
+-- Log all bus events of the handle to a ring buffer on the netX.
+-- The ring has sizRing bytes at ulRingAddress. It must be inside the RX/TX
+-- buffer and must not overlap the ring of another handle. The default is
+-- the end of the free buffer below the rings of the other handles.
+-- getSequenceBufferSize excludes the ring. It stays reserved for
+-- captureRead until the capture of the handle is started again.
+-- Returns the number of records in the ring or nil on error.
+function I2CNetx:captureStart(tHandle, sizRing, ulRingAddress)
+  sizRing = sizRing or 1024
+  local tLog = self.tLog
+  local tester = _G.tester
+  local ulMaxRecords
+
+  local aAttr = tHandle.attr
+  local atRings = aAttr.atCaptureRings
+  if atRings==nil then
+    atRings = {}
+    aAttr.atCaptureRings = atRings
+  end
+
+  -- The ring must be in front of the rings of the other handles.
+  local ulRingEnd = self:__get_capture_limit(tHandle, tHandle)
+  if ulRingAddress==nil then
+    ulRingAddress = ulRingEnd - sizRing
+    ulRingAddress = ulRingAddress - (ulRingAddress % 4)
+  end
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  elseif sizRing<(self.I2C_CAPTURE_HEADER_SIZE+self.I2C_CAPTURE_RECORD_SIZE) then
+    tLog.error('The capture ring needs at least %d bytes.', self.I2C_CAPTURE_HEADER_SIZE+self.I2C_CAPTURE_RECORD_SIZE)
+  elseif (ulRingAddress % 4)~=0 or ulRingAddress<tHandle.ulBufferAddress or (ulRingAddress+sizRing)>ulRingEnd then
+    tLog.error('The capture ring [0x%08x, 0x%08x[ is not in the free buffer [0x%08x, 0x%08x[.', ulRingAddress, ulRingAddress+sizRing, tHandle.ulBufferAddress, ulRingEnd)
+  else
+    local aParameter = {
+      0xffffffff,    -- verbose
+      self.I2C_CMD_Capture,
+      tHandle.ulHandleAddress,
+      ulRingAddress,
+      sizRing,
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.error('Failed to start the capture.')
+    else
+      ulMaxRecords = aParameter[6]
+      tHandle.ulCaptureAddress = ulRingAddress
+      atRings[tHandle.ulHandleAddress] = {
+        address = ulRingAddress,
+        size = sizRing
+      }
+      tLog.debug('The capture ring has %d records.', ulMaxRecords)
+    end
+  end
+
+  return ulMaxRecords
+end
+
+
+
+-- Stop logging the bus events. The ring keeps its contents and can still be
+-- read with captureRead.
+function I2CNetx:captureStop(tHandle)
+  local tLog = self.tLog
+  local tester = _G.tester
+
+  local aAttr = tHandle.attr
+
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  else
+    local aParameter = {
+      0xffffffff,    -- verbose
+      self.I2C_CMD_Capture,
+      tHandle.ulHandleAddress,
+      0,
+      0,
+      'OUTPUT'
+    }
+    tester:mbin_set_parameter(tPlugin, aAttr, aParameter)
+    ulValue = tester:mbin_execute(tPlugin, aAttr, aParameter)
+    if ulValue~=0 then
+      tLog.error('Failed to stop the capture.')
+    end
+  end
+end
+
+
+
+-- Read the capture ring of the handle.
+-- Returns a list of records ordered from the oldest to the newest one and
+-- the number of overwritten records. Each record has these fields:
+--   time_ns:  the time since the first record in nanoseconds
+--   event:    the name of the event, e.g. "DataWrite"
+--   data:     the data byte of the event
+-- The timestamps come from a 32 bit cycle counter. A gap of more than one
+-- counter overflow between 2 events is not detected.
+function I2CNetx:captureRead(tHandle)
+  local tLog = self.tLog
+  local atRecords
+  local ulLost
+
+  local ulRingAddress = tHandle.ulCaptureAddress
+  local tPlugin = tHandle.plugin
+  if tPlugin==nil then
+    tLog.error('The handle has no "plugin" set.')
+  elseif ulRingAddress==nil then
+    tLog.error('The capture was not started.')
+  else
+    local sizHeader = self.I2C_CAPTURE_HEADER_SIZE
+    local strHeader, tRing = self:__ring_read_header(tPlugin, ulRingAddress, sizHeader)
+    local ulMaxRecords = tRing.max_records
+    local ulRecordsTotal = self:__bytes_to_uint32(strHeader, 17)
+    local ulClocksPerUs = self:__bytes_to_uint32(strHeader, 21)
+
+    -- Get the index of the oldest record and the number of valid records.
+    local uiFirst = 0
+    local sizRecords = ulRecordsTotal
+    ulLost = 0
+    if ulRecordsTotal>ulMaxRecords then
+      uiFirst = tRing.write_index
+      sizRecords = ulMaxRecords
+      ulLost = ulRecordsTotal - ulMaxRecords
+      tLog.warning('The capture ring overflowed. %d records were lost.', ulLost)
+    end
+
+    local strRecords = self:__ring_read_records(tPlugin, ulRingAddress, sizHeader, tRing, uiFirst, sizRecords)
+
+    atRecords = {}
+    local ulLastTimestamp
+    local ulTimeClocks = 0
+    for uiCnt=0,sizRecords-1 do
+      local uiOffset = uiCnt * tRing.record_size + 1
+      local ulTimestamp = self:__bytes_to_uint32(strRecords, uiOffset)
+      local ucEvent, ucData = string.byte(strRecords, uiOffset+4, uiOffset+5)
+
+      -- Accumulate the differences to handle the overflow of the counter.
+      if ulLastTimestamp~=nil then
+        ulTimeClocks = ulTimeClocks + ((ulTimestamp - ulLastTimestamp) % 0x100000000)
+      end
+      ulLastTimestamp = ulTimestamp
+
+      table.insert(atRecords, {
+        time_ns = math.floor(ulTimeClocks * 1000 / ulClocksPerUs),
+        event = self.atCaptureEventNames[ucEvent] or tostring(ucEvent),
+        data = ucData
+      })
+    end
+  end
+
+  return atRecords, ulLost
+end
+
+
+
+-- Convert captured records to a VCD file with the signals SCL and SDA. This
+-- can be imported into logic analyser software and decoded as I2C.
+-- The records only have the time when the CPU handled an event, so the
+-- waveform is synthesized with the bus speed ulSpeedKbps. Each event starts
+-- at its timestamp or, if the previous event is not finished yet, right
+-- after it.
+function I2CNetx:captureExportVcd(atRecords, strFileName, ulSpeedKbps)
+  ulSpeedKbps = ulSpeedKbps or 100
+  local tLog = self.tLog
+
+  local ulHalfBitNs = math.floor(500000 / ulSpeedKbps)
+  local astrVcd = {
+    '$timescale 1ns $end',
+    '$scope module i2c $end',
+    '$var wire 1 c SCL $end',
+    '$var wire 1 d SDA $end',
+    '$upscope $end',
+    '$enddefinitions $end',
+    '#0',
+    '1c',
+    '1d'
+  }
+  local ulTime = 0
+  local ucScl = 1
+  local ucSda = 1
+
+  local function setLines(ucNewScl, ucNewSda)
+    if ucNewScl~=ucScl or ucNewSda~=ucSda then
+      table.insert(astrVcd, string.format('#%d', ulTime))
+      if ucNewScl~=ucScl then
+        table.insert(astrVcd, string.format('%dc', ucNewScl))
+        ucScl = ucNewScl
+      end
+      if ucNewSda~=ucSda then
+        table.insert(astrVcd, string.format('%dd', ucNewSda))
+        ucSda = ucNewSda
+      end
+    end
+    ulTime = ulTime + ulHalfBitNs
+  end
+
+  local function sendBit(ucBit)
+    setLines(0, ucBit)
+    setLines(1, ucBit)
+    setLines(0, ucBit)
+  end
+
+  local function sendByte(ucData)
+    for iBit=7,0,-1 do
+      sendBit(math.floor(ucData / 2^iBit) % 2)
+    end
+  end
+
+  for uiCnt, tRecord in ipairs(atRecords) do
+    if tRecord.time_ns>ulTime then
+      ulTime = tRecord.time_ns
+    end
+
+    local strEvent = tRecord.event
+    if strEvent=='Start' then
+      -- Release the bus for a repeated start.
+      if ucScl==0 then
+        setLines(0, 1)
+        setLines(1, 1)
+      end
+      setLines(1, 0)
+      setLines(0, 0)
+      sendByte(tRecord.data)
+    elseif strEvent=='AddressAck' then
+      sendBit(0)
+    elseif strEvent=='AddressNak' then
+      sendBit(1)
+    elseif strEvent=='DataWrite' or strEvent=='DataRead' then
+      sendByte(tRecord.data)
+      -- The slave acknowledges written bytes unless a NAK follows. The
+      -- master acknowledges read bytes unless it is the last one before
+      -- a START or STOP.
+      local tNext = atRecords[uiCnt+1]
+      local strNext = (tNext~=nil) and tNext.event or 'Stop'
+      local ucAck = 0
+      if strEvent=='DataWrite' and strNext=='DataNak' then
+        ucAck = 1
+      elseif strEvent=='DataRead' and (strNext=='Start' or strNext=='Stop') then
+        ucAck = 1
+      end
+      sendBit(ucAck)
+    elseif strEvent=='Stop' then
+      setLines(0, 0)
+      setLines(1, 0)
+      setLines(1, 1)
+    elseif strEvent=='Timeout' then
+      -- The bus was recovered. It is idle now.
+      setLines(1, 1)
+    end
+  end
+  table.insert(astrVcd, string.format('#%d', ulTime))
+
+  local tFile, strError = io.open(strFileName, 'w')
+  if tFile==nil then
+    tLog.error('Failed to create the file "%s": %s', strFileName, tostring(strError))
+  else
+    tFile:write(table.concat(astrVcd, '\n'))
+    tFile:write('\n')
+    tFile:close()
+  end
+end
+
+
+
+-- A builder for sequences without the macro parser. Scripts which generate
+-- the commands in loops can use this instead of formatting a macro. Each
+-- command is encoded when it is complete, so the time grows linearly with
+-- the number of commands.
+-- Pass the topology of the handle as "tTopology" to switch the multiplexers
+-- automatically like parseI2cMacro does, see setTopology. Devices with an
+-- ambiguous address need a "select".
+-- The builder only knows the commands start, read, write, stop, delay and
+-- select. A read can discard its data, but it can not write to a slot, as
+-- the builder has no slot layout. Use parseI2cMacro for slots, ackpollpolicy,
+-- writemulti, smbus, rmw and readdelta.
+-- All functions except "finish" return the builder, e.g.
+--   local tBuilder = tI2C:newSequenceBuilder(tHandle.topology)
+--   tBuilder:start():write(0x50, {0x00, 0x10}):start():read(0x50, 16):stop()
+--   local strSequence, sizExpectedRxData = tBuilder:finish()
+local I2CSequenceBuilder = class()
+
+
+function I2CSequenceBuilder:_init(tI2C, tTopology)
+  self.tI2C = tI2C
+  self.tLog = tI2C.tLog
+  self.tTopology = tTopology
+
+  -- These are the encoded commands.
+  self.astrRecords = {}
+  self.uiCommands = 0
+  self.sizExpectedRxData = 0
+
+  -- A "start" is added to the next read or write.
+  self.fStart = false
+  -- The last read or write waits here for a "stop".
+  self.tPending = nil
+  -- This is the last encoded command. The automatic multiplexer switch
+  -- needs it to find the end of a transaction.
+  self.tLast = nil
+end
+
+
+
+function I2CSequenceBuilder:__encode(tCmd)
+  self.sizExpectedRxData = self.sizExpectedRxData + self.tI2C:__encodeCommand(tCmd, self.astrRecords, nil)
+  self.uiCommands = self.uiCommands + 1
+  self.tLast = tCmd
+end
+
+
+
+function I2CSequenceBuilder:__flush()
+  local tCmd = self.tPending
+  if tCmd~=nil then
+    self.tPending = nil
+    self:__encode(tCmd)
+  end
+end
+
+
+
+function I2CSequenceBuilder:__add_transfer(tCmd, ucAddress, ucRetries)
+  local tLog = self.tLog
+
+  if type(ucAddress)~='number' or ucAddress<0 or ucAddress>0x7f then
+    tLog.error('Invalid address: %s', tostring(ucAddress))
+    error('Invalid address.')
+  end
+  ucRetries = ucRetries or self.tI2C.ucDefaultRetries
+  if type(ucRetries)~='number' or ucRetries<0 or ucRetries>0xff then
+    tLog.error('Invalid retries: %s', tostring(ucRetries))
+    error('Invalid retries.')
+  end
+
+  self:__flush()
+  tCmd.conditions = {}
+  tCmd.address = ucAddress
+  tCmd.retries = ucRetries
+  if self.fStart==true then
+    tCmd.conditions['start'] = true
+    self.fStart = false
+
+    -- Switch the multiplexers before a new transaction.
+    local atCmdMux = {}
+    if self.tLast~=nil then
+      atCmdMux[1] = self.tLast
+    end
+    local uiFirst = #atCmdMux + 1
+    self.tI2C:__auto_mux_select(atCmdMux, self.tTopology, ucAddress)
+    for uiCnt=uiFirst,#atCmdMux do
+      self:__encode(atCmdMux[uiCnt])
+    end
+  end
+  self.tPending = tCmd
+
+  return self
+end
+
+
+
+function I2CSequenceBuilder:start()
+  local tLog = self.tLog
+
+  if self.fStart==true then
+    tLog.error('A "start" command follows another "start" command. This is not allowed.')
+    error('Invalid position of start command.')
+  end
+  self.fStart = true
+
+  return self
+end
+
+
+
+-- Write data to a device. The data is a string or a table of byte values.
+function I2CSequenceBuilder:write(ucAddress, tData, ucRetries)
+  local tLog = self.tLog
+
+  local strData = tData
+  if type(tData)=='table' then
+    local astrData = {}
+    for uiCnt, ucData in ipairs(tData) do
+      if type(ucData)~='number' or ucData<0 or ucData>0xff or ucData~=math.floor(ucData) then
+        tLog.error('Invalid data byte at position %d: %s', uiCnt, tostring(ucData))
+        error('Invalid data.')
+      end
+      astrData[uiCnt] = string.char(ucData)
+    end
+    strData = table.concat(astrData)
+  elseif type(tData)~='string' then
+    tLog.error('Invalid data: %s', tostring(tData))
+    error('Invalid data.')
+  end
+
+  return self:__add_transfer({ cmd='write', data=strData }, ucAddress, ucRetries)
+end
+
+
+
+-- Read data from a device. Set strDestination to "discard" to drop the data
+-- on the netX. This is limited to 65535 bytes like in a macro.
+function I2CSequenceBuilder:read(ucAddress, sizData, ucRetries, strDestination)
+  local tLog = self.tLog
+
+  if type(sizData)~='number' or sizData<1 or sizData>0xffffffff or sizData~=math.floor(sizData) then
+    tLog.error('Invalid length: %s', tostring(sizData))
+    error('Invalid length.')
+  end
+  local tCmd = { cmd='read', length=sizData }
+  if strDestination=='discard' then
+    if sizData>0xffff then
+      tLog.error('A read with a destination is limited to 65535 bytes.')
+      error('Too much data.')
+    end
+    tCmd.discard = true
+  elseif strDestination~=nil then
+    tLog.error('The builder does not support the read destination "%s". Use parseI2cMacro for reads to slots.', tostring(strDestination))
+    error('Invalid destination.')
+  end
+
+  return self:__add_transfer(tCmd, ucAddress, ucRetries)
+end
+
+
+
+function I2CSequenceBuilder:stop()
+  local tLog = self.tLog
+
+  local tCmd = self.tPending
+  if tCmd==nil then
+    tLog.error('Found a stop command without a previous read or write command.')
+    error('Invalid position of stop command.')
+  end
+  tCmd.conditions['stop'] = true
+  self:__flush()
+
+  return self
+end
+
+
+
+function I2CSequenceBuilder:delay(ulDelayMs)
+  local tLog = self.tLog
+
+  if self.fStart==true then
+    tLog.error('A "delay" command can not follow a "start" command.')
+    error('Invalid position of start command.')
+  end
+  if type(ulDelayMs)~='number' or ulDelayMs<0 or ulDelayMs>0xffffffff or ulDelayMs~=math.floor(ulDelayMs) then
+    tLog.error('Invalid delay: %s', tostring(ulDelayMs))
+    error('Invalid delay.')
+  end
+  self:__flush()
+  self:__encode({ cmd='delay', delay=ulDelayMs })
+
+  return self
+end
+
+
+
+-- Switch the multiplexers to a device of the topology. This is a complete
+-- transaction like the "select" command of a macro.
+function I2CSequenceBuilder:select(strDevice, fForce)
+  local tLog = self.tLog
+
+  if self.fStart==true then
+    tLog.error('A "select" command can not follow a "start" command.')
+    error('Invalid position of start command.')
+  end
+  local tDevice
+  if self.tTopology~=nil then
+    tDevice = self.tTopology.devices[strDevice]
+  end
+  if tDevice==nil then
+    tLog.error('The device "%s" is not in the topology.', tostring(strDevice))
+    error('Unknown device.')
+  end
+  self:__flush()
+  local atCmdMux = {}
+  self.tI2C:__add_mux_select(atCmdMux, self.tTopology, tDevice, fForce==true)
+  for _, tCmd in ipairs(atCmdMux) do
+    self:__encode(tCmd)
+  end
+
+  return self
+end
+
+
+
+-- Get the sequence. This returns the same values as parseI2cMacro.
+function I2CSequenceBuilder:finish()
+  local tLog = self.tLog
+
+  if self.fStart==true then
+    tLog.error('The sequence ends with a "start" command.')
+    error('Invalid position of start command.')
+  end
+  self:__flush()
+
+  local tLayout = {
+    commands = self.uiCommands,
+    slot_area = 0,
+    names = {}
+  }
+
+  return table.concat(self.astrRecords), self.sizExpectedRxData, tLayout
+end
+
+
+
+-- Create a new builder for a sequence. Pass the topology of the handle to
+-- switch the multiplexers automatically.
+function I2CNetx:newSequenceBuilder(tTopology)
+  return I2CSequenceBuilder(self, tTopology)
+end
+
+
+
 return I2CNetx
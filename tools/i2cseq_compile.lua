@@ -0,0 +1,75 @@
+-- Compile an I2C macro to a precompiled sequence file.
+-- This runs at build time without a netX. The command IDs are taken from
+-- the generated Lua module, so the module must be built first.
+--
+-- Usage: lua i2cseq_compile.lua MODULE_FOLDER MACRO_FILE SEQUENCE_FILE [TOPOLOGY_FILE]
+--
+-- The optional topology file is a Lua script which returns the device list
+-- for "setTopology". Without it the macro can not use "select" and the
+-- multiplexers are not switched automatically.
+--
+-- The interpreter needs the "lpeglabel" and "penlight" modules.
+
+local strModuleFolder, strMacroFile, strSequenceFile, strTopologyFile = ...
+if strModuleFolder==nil or strMacroFile==nil or strSequenceFile==nil then
+  io.stderr:write('Usage: lua i2cseq_compile.lua MODULE_FOLDER MACRO_FILE SEQUENCE_FILE [TOPOLOGY_FILE]\n')
+  os.exit(1)
+end
+
+-- Print errors and warnings only.
+local atLevels = {
+  error = true,
+  warning = true
+}
+local tLog = setmetatable({}, {
+  __index = function(_, strLevel)
+    return function(strFormat, ...)
+      if atLevels[strLevel]==true then
+        io.stderr:write(string.format('[%s] ', strLevel) .. string.format(strFormat, ...) .. '\n')
+      end
+    end
+  end
+})
+
+-- The module connects to the netX with the romloader, which is not needed
+-- to compile the macro.
+package.loaded['romloader'] = {}
+package.path = strModuleFolder .. '/?.lua;' .. package.path
+local I2CNetx = require 'i2c_netx'
+local tI2C = I2CNetx(tLog)
+
+-- The topology is set for a dummy handle. Only the parser uses it.
+local tTopology
+local fTopologyOk = true
+if strTopologyFile~=nil then
+  local fOk, tError = pcall(function()
+    local atDevices = dofile(strTopologyFile)
+    local tHandle = {}
+    tI2C:setTopology(tHandle, atDevices)
+    tTopology = tHandle.topology
+  end)
+  if fOk~=true then
+    tLog.error('Failed to read the topology "%s": %s', strTopologyFile, tostring(tError))
+    fTopologyOk = false
+  end
+end
+
+local iResult = 1
+if fTopologyOk==true then
+  local tFile, strError = io.open(strMacroFile, 'r')
+  if tFile==nil then
+    tLog.error('Failed to open the file "%s": %s', strMacroFile, tostring(strError))
+  else
+    local strMacro = tFile:read('*a')
+    tFile:close()
+
+    local fOk, strSequence, sizExpectedRxData, tLayout = pcall(tI2C.parseI2cMacro, tI2C, strMacro, tTopology)
+    if fOk~=true then
+      tLog.error('Failed to compile "%s": %s', strMacroFile, tostring(strSequence))
+    elseif tI2C:saveSequence(strSequenceFile, strSequence, sizExpectedRxData, tLayout)==true then
+      iResult = 0
+    end
+  end
+end
+
+os.exit(iResult)
@@ -0,0 +1,150 @@
+#! /usr/bin/python3
+# -*- coding: utf-8 -*-
+# ----------------------------------------------------------------------- #
+#   Copyright (C) 2018 by Christoph Thelen                                #
+#   doc_bacardi@users.sourceforge.net                                     #
+#                                                                         #
+#   This program is free software; you can redistribute it and/or modify  #
+#   it under the terms of the GNU General Public License as published by  #
+#   the Free Software Foundation; either version 2 of the License, or     #
+#   (at your option) any later version.                                   #
+#                                                                         #
+#   This program is distributed in the hope that it will be useful,       #
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+#   GNU General Public License for more details.                          #
+#                                                                         #
+#   You should have received a copy of the GNU General Public License     #
+#   along with this program; if not, write to the                         #
+#   Free Software Foundation, Inc.,                                       #
+#   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             #
+# ----------------------------------------------------------------------- #
+
+# Compare the size of several builds of the same firmware.
+# The report lists the allocated sections, the functions which differ in
+# size and the number of direct and indirect calls in the disassembly. The
+# speed can not be measured at build time. It is compared on the netX with
+# the "benchmark" and "compareBenchmarks" functions of the Lua module and
+# the binary variants.
+#
+# Usage: size_report.py OUTPUT NAME ELF LISTING [NAME ELF LISTING ...]
+# The listing is the output of "objdump --disassemble" for the ELF file.
+
+import re
+import struct
+import sys
+
+
+def elf_get_sizes(strPath):
+    tFile = open(strPath, 'rb')
+    strElf = tFile.read()
+    tFile.close()
+
+    # Only 32 bit little endian files are supported.
+    if strElf[0:4]!=b'\x7fELF' or strElf[4:6]!=b'\x01\x01':
+        raise Exception('"%s" is no 32 bit little endian ELF file.' % strPath)
+    ulShOff, = struct.unpack_from('<I', strElf, 0x20)
+    usShEntSize, usShNum, usShStrNdx = struct.unpack_from('<HHH', strElf, 0x2e)
+
+    atSections = []
+    for uiCnt in range(usShNum):
+        atSections.append(struct.unpack_from('<IIIIIIIIII', strElf, ulShOff + uiCnt*usShEntSize))
+
+    def get_name(uiStrTab, ulOffset):
+        ulStart = atSections[uiStrTab][4] + ulOffset
+        ulEnd = strElf.index(b'\x00', ulStart)
+        return strElf[ulStart:ulEnd].decode('ascii')
+
+    # Get the size of all allocated sections.
+    atSectionSizes = {}
+    atSymbolSizes = {}
+    for tSection in atSections:
+        # SHF_ALLOC
+        if (tSection[2] & 2)!=0 and tSection[5]!=0:
+            atSectionSizes[get_name(usShStrNdx, tSection[0])] = tSection[5]
+        # SHT_SYMTAB
+        if tSection[1]==2:
+            for ulOffset in range(tSection[4], tSection[4] + tSection[5], tSection[9]):
+                ulName, ulValue, ulSize, ucInfo, ucOther, usShNdx = struct.unpack_from('<IIIBBH', strElf, ulOffset)
+                # STT_FUNC
+                if (ucInfo & 0x0f)==2 and ulSize!=0:
+                    atSymbolSizes[get_name(tSection[6], ulName)] = ulSize
+
+    return atSectionSizes, atSymbolSizes
+
+
+# Count the calls in a disassembly from objdump. A "bl" or "blx" with a
+# target address is a direct call, a "blx" with a register is an indirect
+# call through a function pointer or a literal pool for -mlong-calls.
+# Returns the counts for all code and for the ITCM.
+def disassembly_get_calls(strPath):
+    tReInstruction = re.compile(r'^\s*[0-9a-f]+:\s+(?:[0-9a-f]{2,8} ?)+\s+(\S+)\s*([^\s,]*)')
+    tReRegister = re.compile(r'^(r\d+|sb|sl|fp|ip|lr)$')
+
+    atCalls = {
+        'all': {'direct': 0, 'indirect': 0},
+        '.itcm_code': {'direct': 0, 'indirect': 0}
+    }
+    strSection = None
+    tFile = open(strPath, 'rt')
+    for strLine in tFile:
+        if strLine.startswith('Disassembly of section '):
+            strSection = strLine[23:].strip().rstrip(':')
+        else:
+            tMatch = tReInstruction.match(strLine)
+            if tMatch is not None and tMatch.group(1) in ('bl', 'blx'):
+                if tReRegister.match(tMatch.group(2)) is not None:
+                    strKind = 'indirect'
+                else:
+                    strKind = 'direct'
+                atCalls['all'][strKind] += 1
+                if strSection in atCalls:
+                    atCalls[strSection][strKind] += 1
+    tFile.close()
+
+    return atCalls
+
+
+def size_report(strOutput, astrNames, astrElfFiles, astrListings):
+    atSizes = [elf_get_sizes(strPath) for strPath in astrElfFiles]
+    atCalls = [disassembly_get_calls(strPath) for strPath in astrListings]
+
+    astrLines = []
+    astrLines.append('Size report, all values in bytes.')
+    astrLines.append('')
+    strHeader = '%-32s' % 'Section' + ''.join(['%12s' % strName for strName in astrNames])
+    astrLines.append(strHeader)
+    astrSections = sorted(set().union(*[tSizes[0].keys() for tSizes in atSizes]))
+    for strSection in astrSections:
+        astrLines.append('%-32s' % strSection + ''.join(['%12d' % tSizes[0].get(strSection, 0) for tSizes in atSizes]))
+    astrLines.append('%-32s' % 'total' + ''.join(['%12d' % sum(tSizes[0].values()) for tSizes in atSizes]))
+
+    astrLines.append('')
+    astrLines.append('%-48s' % 'Function' + ''.join(['%12s' % strName for strName in astrNames]))
+    astrSymbols = sorted(set().union(*[tSizes[1].keys() for tSizes in atSizes]))
+    for strSymbol in astrSymbols:
+        aulSizes = [tSizes[1].get(strSymbol, 0) for tSizes in atSizes]
+        if len(set(aulSizes))!=1:
+            astrLines.append('%-48s' % strSymbol + ''.join(['%12d' % ulSize for ulSize in aulSizes]))
+
+    astrLines.append('')
+    astrLines.append('%-48s' % 'Calls' + ''.join(['%12s' % strName for strName in astrNames]))
+    for strSection in ('.itcm_code', 'all'):
+        for strKind in ('direct', 'indirect'):
+            astrLines.append('%-48s' % ('%s, %s' % (strKind, strSection)) + ''.join(['%12d' % tCalls[strSection][strKind] for tCalls in atCalls]))
+
+    astrLines.append('')
+    astrLines.append('The speed is compared on the netX with the "benchmark" and')
+    astrLines.append('"compareBenchmarks" functions of the Lua module.')
+
+    tFile = open(strOutput, 'wt')
+    tFile.write('\n'.join(astrLines) + '\n')
+    tFile.close()
+
+
+if __name__=='__main__':
+    astrArgs = sys.argv[1:]
+    if len(astrArgs)<4 or (len(astrArgs) % 3)!=1:
+        sys.stderr.write('Usage: %s OUTPUT NAME ELF LISTING [NAME ELF LISTING ...]\n' % sys.argv[0])
+        sys.exit(1)
+    size_report(astrArgs[0], astrArgs[1::3], astrArgs[2::3], astrArgs[3::3])